@@ -0,0 +1,101 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstdint>
+#include <new>
+#include <sys/mman.h>
+#include "arena.h"
+
+namespace badgerdb {
+
+static std::size_t roundToHugePages(const std::size_t bytes)
+{
+	return (bytes + BufArena::HUGE_PAGE_SIZE - 1) / BufArena::HUGE_PAGE_SIZE * BufArena::HUGE_PAGE_SIZE;
+}
+
+BufArena::BufArena(const std::size_t bytes, const std::size_t maxBytes)
+	: base_(NULL), size_(0), reserved_(false)
+{
+	std::size_t wanted = roundToHugePages(bytes > 0 ? bytes : 1);
+	capacity_ = roundToHugePages(maxBytes > wanted ? maxBytes : wanted);
+
+	// reserve one huge page more than needed and trim the ends, so the arena starts on a huge page boundary
+	std::size_t mapped = capacity_ + HUGE_PAGE_SIZE;
+	char* start = (char*) mmap(NULL, mapped, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (start == MAP_FAILED && capacity_ > wanted)
+	{
+		capacity_ = wanted;
+		mapped = capacity_ + HUGE_PAGE_SIZE;
+		start = (char*) mmap(NULL, mapped, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	}
+	if (start == MAP_FAILED)
+		throw std::bad_alloc();
+
+	char* aligned = (char*) (((std::uintptr_t) start + HUGE_PAGE_SIZE - 1) & ~(std::uintptr_t) (HUGE_PAGE_SIZE - 1));
+	if (aligned > start)
+		munmap(start, aligned - start);
+	if (start + mapped > aligned + capacity_)
+		munmap(aligned + capacity_, start + mapped - (aligned + capacity_));
+	base_ = aligned;
+
+	try
+	{
+		reserved_ = commit(0, wanted);
+	}
+	catch (...)
+	{
+		munmap(base_, capacity_);
+		throw;
+	}
+	size_ = wanted;
+}
+
+BufArena::~BufArena()
+{
+	munmap(base_, capacity_);
+}
+
+void BufArena::resize(const std::size_t bytes)
+{
+	std::size_t wanted = roundToHugePages(bytes);
+	if (wanted > capacity_)
+		throw std::bad_alloc();
+
+	if (wanted > size_)
+		commit(size_, wanted);
+	else if (wanted < size_)
+		release(wanted, size_);
+	size_ = wanted;
+}
+
+bool BufArena::commit(const std::size_t from, const std::size_t to)
+{
+#ifdef MAP_HUGETLB
+	// reserved huge pages are often not configured at all
+	if (mmap(base_ + from, to - from, PROT_READ | PROT_WRITE,
+	         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0) != MAP_FAILED)
+		return true;
+#endif
+
+	if (mmap(base_ + from, to - from, PROT_READ | PROT_WRITE,
+	         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0) == MAP_FAILED)
+		throw std::bad_alloc();
+
+#ifdef MADV_HUGEPAGE
+	// only a hint, ignored where transparent huge pages are disabled
+	madvise(base_ + from, to - from, MADV_HUGEPAGE);
+#endif
+	return false;
+}
+
+void BufArena::release(const std::size_t from, const std::size_t to)
+{
+	// mapping fresh inaccessible memory over the range frees what backed it
+	mmap(base_ + from, to - from, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0);
+}
+
+}
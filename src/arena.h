@@ -0,0 +1,112 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace badgerdb {
+
+/**
+* @brief Memory backing the frames of the buffer pool.
+*
+* The arena reserves a range of address space aligned to 2 MB huge pages, of which a prefix is usable.  Explicitly
+* reserved huge pages back the usable part if the system has enough of them; otherwise it uses normal pages and the
+* kernel is asked to back it with transparent huge pages.  Nothing is touched when memory is made usable: the
+* kernel supplies zeroed memory the first time each page is written, so even a very large arena is set up
+* instantly.  Since the whole range is reserved up front, the arena grows and shrinks in place and pointers into
+* its usable part stay valid.
+*/
+class BufArena {
+
+ public:
+	/**
+   * Size and alignment of a huge page
+	 */
+  static const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+	/**
+   * Constructor of BufArena class
+	 *
+	 * @param bytes  	Size of the usable part of the arena
+	 * @param maxBytes  Size the arena may grow to.  If that much address space cannot be reserved, only bytes are.
+	 * @throws std::bad_alloc If the memory cannot be mapped
+	 */
+  BufArena(const std::size_t bytes, const std::size_t maxBytes);
+
+	/**
+   * Destructor of BufArena class, unmaps the memory
+	 */
+  ~BufArena();
+
+	/**
+   * Grows or shrinks the usable part of the arena.  Memory given up is returned to the system, and reads as
+	 * zeroes if it is made usable again.
+	 *
+	 * @param bytes  	New size of the usable part, at most capacity()
+	 * @throws std::bad_alloc If the memory cannot be mapped
+	 */
+  void resize(const std::size_t bytes);
+
+	/**
+   * Returns the start of the arena, aligned to HUGE_PAGE_SIZE
+	 */
+  void* base() const { return base_; }
+
+	/**
+   * Returns the size of the usable part of the arena in bytes, a multiple of HUGE_PAGE_SIZE
+	 */
+  std::size_t size() const { return size_; }
+
+	/**
+   * Returns the size of the address space reserved for the arena in bytes
+	 */
+  std::size_t capacity() const { return capacity_; }
+
+	/**
+   * Returns true if the arena was first made usable with reserved huge pages rather than transparent ones
+	 */
+  bool reservedHugePages() const { return reserved_; }
+
+ private:
+  BufArena(const BufArena&);
+  BufArena& operator=(const BufArena&);
+
+	/**
+   * Makes part of the reserved range usable
+	 *
+	 * @return  True if reserved huge pages were used
+	 */
+  bool commit(const std::size_t from, const std::size_t to);
+
+	/**
+   * Returns part of the usable range to the system, keeping it reserved
+	 */
+  void release(const std::size_t from, const std::size_t to);
+
+	/**
+   * Start of the reserved range
+	 */
+  char* base_;
+
+	/**
+   * Size of the usable part
+	 */
+  std::size_t size_;
+
+	/**
+   * Size of the reserved range
+	 */
+  std::size_t capacity_;
+
+	/**
+   * True if the first usable part uses reserved huge pages
+	 */
+  bool reserved_;
+};
+
+}
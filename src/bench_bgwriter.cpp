@@ -0,0 +1,163 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * badgerdb_bench_bgwriter: builds a B+ tree index over a relation of RECORDS records whose keys come in random order,
+ * in a pool of FRAMES frames too small for the index, without the background writer and then with it, and prints
+ * for each run the records indexed per second, the median and 99th percentile time readPage() took to bring
+ * in a missing page, and how many victims the reading threads had to write back themselves.  The inserts dirty
+ * leaves all over the tree, so without the writer most misses write a dirty victim before reading their page.
+ *
+ *   badgerdb_bench_bgwriter [-f FRAMES] [-n RECORDS]
+ *
+ * FRAMES defaults to 100 and RECORDS to 200000.  The writer runs first with its default settings, then writing up to
+ * FRAMES pages every millisecond, which keeps up with the inserts.  Latencies are nanoseconds.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "btree.h"
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/insufficient_space_exception.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const char* const RELATION_NAME = "benchBgWriter.db";
+
+void usage()
+{
+	std::cerr << "usage: badgerdb_bench_bgwriter [-f FRAMES] [-n RECORDS]\n";
+	std::exit(2);
+}
+
+long argument(int argc, char** argv, int& a)
+{
+	if (++a == argc)
+		usage();
+	const long value = std::atol(argv[a]);
+	if (value <= 0)
+		usage();
+	return value;
+}
+
+void removeFile(const std::string& name)
+{
+	try
+	{
+		File::remove(name);
+	}
+	catch (const FileNotFoundException &)
+	{
+	}
+}
+
+/**
+ * Writes the relation, with the keys 0 to records - 1 in random order.
+ */
+void createRelation(const std::uint32_t records)
+{
+	std::vector<int> keys(records);
+	for (std::uint32_t r = 0; r < records; r++)
+		keys[r] = (int) r;
+	std::minstd_rand rng(1);
+	std::shuffle(keys.begin(), keys.end(), rng);
+
+	PageFile file = PageFile::create(RELATION_NAME);
+	PageId pageNo;
+	Page page = file.allocatePage(pageNo);
+	uRECORD record;
+	std::memset(&record, 0, sizeof(record));
+	for (std::uint32_t r = 0; r < records; r++)
+	{
+		record.i = keys[r];
+		record.d = keys[r];
+		std::snprintf(record.s, sizeof(record.s), "%08d string record", keys[r]);
+		const std::string data(reinterpret_cast<const char*>(&record), sizeof(record));
+		try
+		{
+			page.insertRecord(data);
+		}
+		catch (const InsufficientSpaceException &)
+		{
+			file.writePage(pageNo, page);
+			page = file.allocatePage(pageNo);
+			page.insertRecord(data);
+		}
+	}
+	file.writePage(pageNo, page);
+}
+
+/**
+ * Builds the index in a new pool, with a writer writing up to pagesPerRound pages every intervalMs unless
+ * pagesPerRound is 0, and prints how fast it went and how long misses took.
+ */
+void build(const std::uint32_t frames, const std::uint32_t records, const char* writer,
+           const std::uint32_t pagesPerRound, const std::uint32_t intervalMs)
+{
+	BufMgr bufMgr(frames);
+	if (pagesPerRound > 0)
+		bufMgr.startBgWriter(0.25, pagesPerRound, intervalMs);
+
+	std::string indexName;
+	BufStats stats;
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	{
+		BTreeIndex index(RELATION_NAME, indexName, &bufMgr, offsetof(uRECORD, i), INTEGER);
+		stats = bufMgr.getBufStats();
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	bufMgr.stopBgWriter();
+
+	std::printf("%10s %12.0f %10llu %10llu %10llu %14llu\n", writer, records / seconds,
+	            (unsigned long long) stats.missLatency.percentile(50),
+	            (unsigned long long) stats.missLatency.percentile(99), (unsigned long long) stats.misses,
+	            (unsigned long long) stats.dirtyEvictions);
+	File::remove(indexName);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::uint32_t frames = 100;
+	std::uint32_t records = 200000;
+	for (int a = 1; a < argc; a++)
+	{
+		if (std::strcmp(argv[a], "-f") == 0)
+			frames = (std::uint32_t) argument(argc, argv, a);
+		else if (std::strcmp(argv[a], "-n") == 0)
+			records = (std::uint32_t) argument(argc, argv, a);
+		else
+			usage();
+	}
+
+	removeFile(RELATION_NAME);
+	// the index of an earlier run that crashed would be opened rather than built
+	removeFile(std::string(RELATION_NAME) + ".0");
+	createRelation(records);
+
+	std::cout << records << " records, " << frames << " frames\n";
+	std::printf("\n%10s %12s %10s %10s %10s %14s\n", "bgwriter", "records/s", "miss p50", "miss p99", "misses",
+	            "dirty victims");
+	build(frames, records, "off", 0, 0);
+	build(frames, records, "default", 64, 20);
+	build(frames, records, "eager", frames, 1);
+
+	File::remove(RELATION_NAME);
+	return 0;
+}
@@ -0,0 +1,145 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * badgerdb_bench_coldscan: times scans through readPage() of a file whose pages are not in the pool, so that every
+ * page is a miss, and prints the time per page along with the median and 99th percentile miss latency the pool
+ * records.  Lookups used to throw HashNotFoundException on a miss; the throw column is what constructing, throwing
+ * and catching one costs, which every page of such a scan paid on top, and the last column adds it back.
+ *
+ *   badgerdb_bench_coldscan [-p PAGES] [-f FRAMES] [-r ROUNDS]
+ *
+ * PAGES defaults to 8192, FRAMES to 1024 and ROUNDS to 5.  Readahead is off, and after the first round the pages
+ * come from the operating system's page cache, so the times are those of the miss path rather than of the disk.
+ * Each column is nanoseconds.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const char* const FILE_NAME = "benchColdScan.db";
+
+void usage()
+{
+	std::cerr << "usage: badgerdb_bench_coldscan [-p PAGES] [-f FRAMES] [-r ROUNDS]\n";
+	std::exit(2);
+}
+
+long argument(int argc, char** argv, int& a)
+{
+	if (++a == argc)
+		usage();
+	const long value = std::atol(argv[a]);
+	if (value <= 0)
+		usage();
+	return value;
+}
+
+double nanosPer(const std::chrono::steady_clock::time_point& start, const std::size_t count)
+{
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+/**
+ * Throws and catches the exception a lookup that missed used to throw, once for each page.
+ */
+double timeThrows(const File& file, const std::vector<PageId>& pageNos)
+{
+	std::uint64_t caught = 0;
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (std::size_t p = 0; p < pageNos.size(); p++)
+	{
+		try
+		{
+			throw HashNotFoundException(file.filename(), pageNos[p]);
+		}
+		catch (const HashNotFoundException &)
+		{
+			caught++;
+		}
+	}
+	return nanosPer(start, caught);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::uint32_t pages = 8192;
+	std::uint32_t frames = 1024;
+	int rounds = 5;
+	for (int a = 1; a < argc; a++)
+	{
+		if (std::strcmp(argv[a], "-p") == 0)
+			pages = (std::uint32_t) argument(argc, argv, a);
+		else if (std::strcmp(argv[a], "-f") == 0)
+			frames = (std::uint32_t) argument(argc, argv, a);
+		else if (std::strcmp(argv[a], "-r") == 0)
+			rounds = (int) argument(argc, argv, a);
+		else
+			usage();
+	}
+
+	try
+	{
+		File::remove(FILE_NAME);
+	}
+	catch (const FileNotFoundException &)
+	{
+	}
+
+	{
+		PageFile file = PageFile::create(FILE_NAME);
+		std::vector<PageId> pageNos(pages);
+		for (std::uint32_t p = 0; p < pages; p++)
+		{
+			Page page = file.allocatePage(pageNos[p]);
+			page.insertRecord("cold scan record");
+			file.writePage(pageNos[p], page);
+		}
+
+		std::cout << pages << " pages, " << frames << " frames\n";
+		std::printf("\n%6s %10s %10s %10s %10s %10s\n", "round", "per page", "miss p50", "miss p99", "throw",
+		            "with throw");
+		for (int round = 1; round <= rounds; round++)
+		{
+			// a new pool for every scan, so that none of the pages is in it
+			BufMgr bufMgr(frames);
+			bufMgr.setReadahead(0);
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (std::uint32_t p = 0; p < pages; p++)
+			{
+				Page* page;
+				bufMgr.readPage(&file, pageNos[p], page);
+				bufMgr.unPinPage(&file, pageNos[p], false);
+			}
+			const double perPage = nanosPer(start, pages);
+
+			const BufStats stats = bufMgr.getBufStats();
+			const double perThrow = timeThrows(file, pageNos);
+			std::printf("%6d %10.0f %10llu %10llu %10.0f %10.0f\n", round, perPage,
+			            (unsigned long long) stats.missLatency.percentile(50),
+			            (unsigned long long) stats.missLatency.percentile(99), perThrow, perPage + perThrow);
+		}
+	}
+
+	File::remove(FILE_NAME);
+	return 0;
+}
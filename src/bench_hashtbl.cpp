@@ -0,0 +1,308 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * badgerdb_bench_hashtbl: times insert, lookup and remove of the buffer pool page table against the chained table it
+ * replaced, for pools of the given sizes.  The pages of each pool come from two files, inserted in page order the way
+ * a scan loads them; they are then looked up and removed in random order, and pages that are not in the table are
+ * looked up as misses.
+ *
+ *   badgerdb_bench_hashtbl [FRAMES ...]
+ *
+ * Without FRAMES, pools of 1024, 65536 and 1048576 frames are timed.  Each column is nanoseconds per operation.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "bufHashTbl.h"
+#include "file.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/hash_already_present_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+#include "exceptions/hash_table_exception.h"
+
+using namespace badgerdb;
+
+namespace chained {
+
+/*
+ * The chained page table as it was before it was replaced, sized the way BufMgr sized it.  The only change is that
+ * the hash is taken as unsigned: the original cast the file pointer to int, which could index in front of the
+ * table.
+ */
+
+struct hashBucket {
+	File *file;
+	PageId pageNo;
+	FrameId frameNo;
+	hashBucket*   next;
+};
+
+class BufHashTbl
+{
+ private:
+  int HTSIZE;
+  hashBucket**  ht;
+
+  int	 hash(const File* file, const PageId pageNo)
+  {
+    unsigned tmp, value;
+    tmp = (long)file;  // cast of pointer to the file object to an integer
+    value = (tmp + pageNo) % HTSIZE;
+    return value;
+  }
+
+ public:
+	BufHashTbl(const int bufs)
+		: HTSIZE(((((int) (bufs * 1.2))*2)/2)+1)
+	{
+	  ht = new hashBucket* [HTSIZE];
+	  for(int i=0; i < HTSIZE; i++)
+	    ht[i] = NULL;
+	}
+
+  ~BufHashTbl()
+	{
+	  for(int i = 0; i < HTSIZE; i++) {
+	    hashBucket* tmpBuf = ht[i];
+	    while (ht[i]) {
+	      tmpBuf = ht[i];
+	      ht[i] = ht[i]->next;
+	      delete tmpBuf;
+	    }
+	  }
+	  delete [] ht;
+	}
+
+  void insert(const File* file, const PageId pageNo, const FrameId frameNo)
+	{
+	  int index = hash(file, pageNo);
+
+	  hashBucket* tmpBuc = ht[index];
+	  while (tmpBuc) {
+	    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+	  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
+	    tmpBuc = tmpBuc->next;
+	  }
+
+	  tmpBuc = new hashBucket;
+	  if (!tmpBuc)
+	  	throw HashTableException();
+
+	  tmpBuc->file = (File*) file;
+	  tmpBuc->pageNo = pageNo;
+	  tmpBuc->frameNo = frameNo;
+	  tmpBuc->next = ht[index];
+	  ht[index] = tmpBuc;
+	}
+
+  void lookup(const File* file, const PageId pageNo, FrameId &frameNo)
+	{
+	  int index = hash(file, pageNo);
+	  hashBucket* tmpBuc = ht[index];
+	  while (tmpBuc) {
+	    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+	    {
+	      frameNo = tmpBuc->frameNo; // return frameNo by reference
+	      return;
+	    }
+	    tmpBuc = tmpBuc->next;
+	  }
+
+	  throw HashNotFoundException(file->filename(), pageNo);
+	}
+
+  void remove(const File* file, const PageId pageNo)
+	{
+	  int index = hash(file, pageNo);
+	  hashBucket* tmpBuc = ht[index];
+	  hashBucket* prevBuc = NULL;
+
+	  while (tmpBuc)
+		{
+	    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+			{
+	      if(prevBuc)
+					prevBuc->next = tmpBuc->next;
+	      else
+					ht[index] = tmpBuc->next;
+
+	      delete tmpBuc;
+	      return;
+	    }
+			else
+			{
+	      prevBuc = tmpBuc;
+	      tmpBuc = tmpBuc->next;
+	    }
+	  }
+
+	  throw HashNotFoundException(file->filename(), pageNo);
+	}
+};
+
+}
+
+namespace {
+
+const char* const FILE_NAMES[2] = {"benchHashTbl.0", "benchHashTbl.1"};
+
+struct Key
+{
+	const File* file;
+	PageId pageNo;
+};
+
+/**
+ * Nanoseconds per operation of each kind, for one table.
+ */
+struct Timings
+{
+	double insert;
+	double hit;
+	double miss;
+	double remove;
+};
+
+double nanosPer(const std::chrono::steady_clock::time_point& start, const std::size_t count)
+{
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+/*
+ * A miss is a normal outcome of lookup() in the current table and an exception in the old one; the two are adapted
+ * to the same call here so that each is timed the way BufMgr uses it.
+ */
+bool lookup(BufHashTbl& table, const Key& key, FrameId& frameNo)
+{
+	return table.lookup(key.file, key.pageNo, frameNo);
+}
+
+bool lookup(chained::BufHashTbl& table, const Key& key, FrameId& frameNo)
+{
+	try
+	{
+		table.lookup(key.file, key.pageNo, frameNo);
+		return true;
+	}
+	catch (const HashNotFoundException &)
+	{
+		return false;
+	}
+}
+
+template <class Table>
+Timings timeTable(const std::uint32_t frames, const std::vector<Key>& loaded, const std::vector<Key>& shuffled,
+                   const std::vector<Key>& missing, const int rounds, std::uint64_t& found)
+{
+	Timings timings = {0, 0, 0, 0};
+	Table table(frames);
+	for (int round = 0; round < rounds; round++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (std::size_t k = 0; k < loaded.size(); k++)
+			table.insert(loaded[k].file, loaded[k].pageNo, (FrameId) k);
+		timings.insert += nanosPer(start, loaded.size()) / rounds;
+
+		FrameId frameNo;
+		start = std::chrono::steady_clock::now();
+		for (std::size_t k = 0; k < shuffled.size(); k++)
+			found += lookup(table, shuffled[k], frameNo) ? frameNo : 0;
+		timings.hit += nanosPer(start, shuffled.size()) / rounds;
+
+		start = std::chrono::steady_clock::now();
+		for (std::size_t k = 0; k < missing.size(); k++)
+			found += lookup(table, missing[k], frameNo) ? 1 : 0;
+		timings.miss += nanosPer(start, missing.size()) / rounds;
+
+		start = std::chrono::steady_clock::now();
+		for (std::size_t k = 0; k < shuffled.size(); k++)
+			table.remove(shuffled[k].file, shuffled[k].pageNo);
+		timings.remove += nanosPer(start, shuffled.size()) / rounds;
+	}
+	return timings;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::uint32_t> frames;
+	for (int a = 1; a < argc; a++)
+	{
+		const long size = std::atol(argv[a]);
+		if (size <= 0)
+		{
+			std::cerr << "usage: badgerdb_bench_hashtbl [FRAMES ...]\n";
+			return 2;
+		}
+		frames.push_back((std::uint32_t) size);
+	}
+	if (frames.empty())
+	{
+		frames.push_back(1024);
+		frames.push_back(65536);
+		frames.push_back(1048576);
+	}
+
+	for (int f = 0; f < 2; f++)
+	{
+		try
+		{
+			File::remove(FILE_NAMES[f]);
+		}
+		catch (const FileNotFoundException &)
+		{
+		}
+	}
+
+	{
+		PageFile file0 = PageFile::create(FILE_NAMES[0]);
+		PageFile file1 = PageFile::create(FILE_NAMES[1]);
+		const File* files[2] = {&file0, &file1};
+		std::minstd_rand rng(1);
+		std::uint64_t found = 0;
+
+		std::printf("%10s %8s %8s %8s %8s %8s %8s %8s %8s\n", "frames", "insert", "(old)", "hit", "(old)", "miss",
+		            "(old)", "remove", "(old)");
+		for (std::size_t n = 0; n < frames.size(); n++)
+		{
+			// half the pool from each file, in page order; as many pages again are never loaded
+			std::vector<Key> loaded;
+			std::vector<Key> missing;
+			for (std::uint32_t k = 0; k < frames[n]; k++)
+			{
+				Key key = {files[k % 2], 1 + k / 2};
+				loaded.push_back(key);
+				key.pageNo += (frames[n] + 1) / 2;
+				missing.push_back(key);
+			}
+			std::vector<Key> shuffled(loaded);
+			std::shuffle(shuffled.begin(), shuffled.end(), rng);
+			std::shuffle(missing.begin(), missing.end(), rng);
+
+			// about the same number of operations for every size
+			const int rounds = std::max(1, (int) (1000000 / frames[n]));
+			const Timings current = timeTable<BufHashTbl>(frames[n], loaded, shuffled, missing, rounds, found);
+			const Timings old = timeTable<chained::BufHashTbl>(frames[n], loaded, shuffled, missing, rounds, found);
+			std::printf("%10u %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f\n", frames[n], current.insert,
+			            old.insert, current.hit, old.hit, current.miss, old.miss, current.remove, old.remove);
+		}
+		// use what was looked up, so that the lookups are not optimized away
+		if (found == 0)
+			std::cout << "\n";
+	}
+
+	for (int f = 0; f < 2; f++)
+		File::remove(FILE_NAMES[f]);
+	return 0;
+}
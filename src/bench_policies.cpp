@@ -0,0 +1,194 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * badgerdb_bench_policies: replays a workload mixing sequential scans with point lookups under each replacement
+ * policy and prints the hit ratio of the whole workload, of the lookups alone, and how many accesses per second the
+ * pool served.  A scan file of SCAN pages is read from start to end PASSES times while, after every page of the scan,
+ * LOOKUPS random pages of a hot file of HOT pages are read.  The hot pages fit in the pool, the scan does not, so
+ * the lookups keep hitting only as long as the policy does not let the scan push the hot pages out.  The workload
+ * is then replayed with the scan read through a BufRing of RING frames, which should keep the hot pages in under
+ * any policy, and the same columns are printed for it.
+ *
+ *   badgerdb_bench_policies [-f FRAMES] [-s SCAN] [-h HOT] [-l LOOKUPS] [-n PASSES] [-r RING]
+ *
+ * FRAMES defaults to 1000, SCAN to 5000, HOT to 600, LOOKUPS to 1, PASSES to 4 and RING to BufRing::DEFAULT_SIZE.
+ * Readahead is off and every run sees the same random lookups, which start once the hot pages have each been read
+ * in.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "exceptions/file_not_found_exception.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const char* const SCAN_FILE_NAME = "benchPoliciesScan.db";
+const char* const HOT_FILE_NAME = "benchPoliciesHot.db";
+
+struct PolicyName
+{
+	const char* name;
+	ReplacementPolicyType type;
+};
+
+const PolicyName POLICIES[] = {
+	{"clock", CLOCK},
+	{"lru-k", LRU_K},
+	{"2q", TWO_Q},
+	{"arc", ARC}
+};
+
+const std::size_t NUM_POLICIES = sizeof(POLICIES) / sizeof(POLICIES[0]);
+
+void usage()
+{
+	std::cerr << "usage: badgerdb_bench_policies [-f FRAMES] [-s SCAN] [-h HOT] [-l LOOKUPS] [-n PASSES]"
+	             " [-r RING]\n";
+	std::exit(2);
+}
+
+long argument(int argc, char** argv, int& a)
+{
+	if (++a == argc)
+		usage();
+	const long value = std::atol(argv[a]);
+	if (value <= 0)
+		usage();
+	return value;
+}
+
+void removeFile(const char* name)
+{
+	try
+	{
+		File::remove(name);
+	}
+	catch (const FileNotFoundException &)
+	{
+	}
+}
+
+std::vector<PageId> fill(PageFile& file, const std::uint32_t pages)
+{
+	std::vector<PageId> pageNos(pages);
+	for (std::uint32_t p = 0; p < pages; p++)
+	{
+		Page page = file.allocatePage(pageNos[p]);
+		page.insertRecord("policy workload record");
+		file.writePage(pageNos[p], page);
+	}
+	return pageNos;
+}
+
+void readPage(BufMgr& bufMgr, File* file, const PageId pageNo, BufRing* ring = NULL)
+{
+	Page* page;
+	bufMgr.readPage(file, pageNo, page, ring);
+	bufMgr.unPinPage(file, pageNo, false);
+}
+
+/**
+ * Replays the workload on a new pool and prints its hit ratios and accesses per second, reading the scan through
+ * the ring if there is one.
+ */
+void replay(const ReplacementPolicyType policy, const std::uint32_t frames, PageFile& scanFile,
+            const std::vector<PageId>& scanPageNos, PageFile& hotFile, const std::vector<PageId>& hotPageNos,
+            const std::uint32_t lookups, const std::uint32_t passes, BufRing* ring)
+{
+	BufMgr bufMgr(frames, 1, policy);
+	bufMgr.setReadahead(0);
+	for (std::size_t h = 0; h < hotPageNos.size(); h++)
+		readPage(bufMgr, &hotFile, hotPageNos[h]);
+	bufMgr.clearBufStats();
+
+	std::minstd_rand rng(1);
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (std::uint32_t pass = 0; pass < passes; pass++)
+	{
+		for (std::size_t s = 0; s < scanPageNos.size(); s++)
+		{
+			readPage(bufMgr, &scanFile, scanPageNos[s], ring);
+			for (std::uint32_t l = 0; l < lookups; l++)
+				readPage(bufMgr, &hotFile, hotPageNos[rng() % hotPageNos.size()]);
+		}
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	BufStats stats = bufMgr.getBufStats();
+	std::printf(" %9.1f%% %9.1f%% %12.0f", 100 * stats.hitRatio(), 100 * stats.files[HOT_FILE_NAME].hitRatio(),
+	            stats.accesses / seconds);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::uint32_t frames = 1000;
+	std::uint32_t scanPages = 5000;
+	std::uint32_t hotPages = 600;
+	std::uint32_t lookups = 1;
+	std::uint32_t passes = 4;
+	std::uint32_t ringSize = BufRing::DEFAULT_SIZE;
+	for (int a = 1; a < argc; a++)
+	{
+		if (std::strcmp(argv[a], "-f") == 0)
+			frames = (std::uint32_t) argument(argc, argv, a);
+		else if (std::strcmp(argv[a], "-s") == 0)
+			scanPages = (std::uint32_t) argument(argc, argv, a);
+		else if (std::strcmp(argv[a], "-h") == 0)
+			hotPages = (std::uint32_t) argument(argc, argv, a);
+		else if (std::strcmp(argv[a], "-l") == 0)
+			lookups = (std::uint32_t) argument(argc, argv, a);
+		else if (std::strcmp(argv[a], "-n") == 0)
+			passes = (std::uint32_t) argument(argc, argv, a);
+		else if (std::strcmp(argv[a], "-r") == 0)
+			ringSize = (std::uint32_t) argument(argc, argv, a);
+		else
+			usage();
+	}
+
+	removeFile(SCAN_FILE_NAME);
+	removeFile(HOT_FILE_NAME);
+
+	{
+		PageFile scanFile = PageFile::create(SCAN_FILE_NAME);
+		PageFile hotFile = PageFile::create(HOT_FILE_NAME);
+		const std::vector<PageId> scanPageNos = fill(scanFile, scanPages);
+		const std::vector<PageId> hotPageNos = fill(hotFile, hotPages);
+
+		std::cout << frames << " frames, scans of " << scanPages << " pages, " << lookups << " lookup(s) per page on "
+		          << hotPages << " hot pages\n";
+		std::printf("\n%8s %34s %34s\n", "", "without a ring", "scan through a ring");
+		std::printf("%8s", "policy");
+		for (int run = 0; run < 2; run++)
+			std::printf(" %10s %10s %12s", "hit ratio", "hot hits", "accesses/s");
+		std::printf("\n");
+		for (std::size_t p = 0; p < NUM_POLICIES; p++)
+		{
+			std::printf("%8s", POLICIES[p].name);
+			replay(POLICIES[p].type, frames, scanFile, scanPageNos, hotFile, hotPageNos, lookups, passes, NULL);
+			BufRing ring(ringSize);
+			replay(POLICIES[p].type, frames, scanFile, scanPageNos, hotFile, hotPageNos, lookups, passes, &ring);
+			std::printf("\n");
+		}
+	}
+
+	File::remove(SCAN_FILE_NAME);
+	File::remove(HOT_FILE_NAME);
+	return 0;
+}
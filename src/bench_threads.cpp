@@ -0,0 +1,157 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * badgerdb_bench_threads: measures how buffer pool hits scale with the number of threads.  Every page of a scratch
+ * file is brought into the pool first, then 1, 2, 4, ... up to THREADS threads each pin and unpin random pages of
+ * it for SECONDS, and the hits per second of each run are printed along with the speedup over one thread.
+ *
+ *   badgerdb_bench_threads [-t THREADS] [-s SHARDS] [-p PAGES] [-d SECONDS]
+ *
+ * THREADS defaults to the number of hardware threads, SHARDS to 16, PAGES to 4096 and SECONDS to 1.  Running with
+ * -s 1 shows a pool with a single latch for comparison.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "exceptions/file_not_found_exception.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const char* const FILE_NAME = "benchThreads.db";
+
+void usage()
+{
+	std::cerr << "usage: badgerdb_bench_threads [-t THREADS] [-s SHARDS] [-p PAGES] [-d SECONDS]\n";
+	std::exit(2);
+}
+
+long argument(int argc, char** argv, int& a)
+{
+	if (++a == argc)
+		usage();
+	const long value = std::atol(argv[a]);
+	if (value <= 0)
+		usage();
+	return value;
+}
+
+/**
+ * Pins and unpins random pages of the file until told to stop, counting the pins.
+ */
+void hitPages(BufMgr* bufMgr, File* file, const std::vector<PageId>* pageNos, unsigned seed,
+              const std::atomic<bool>* stop, std::uint64_t* hits)
+{
+	std::minstd_rand rng(seed);
+	std::uint64_t count = 0;
+	while (!stop->load(std::memory_order_relaxed))
+	{
+		const PageId pageNo = (*pageNos)[rng() % pageNos->size()];
+		Page* page;
+		bufMgr->readPage(file, pageNo, page);
+		bufMgr->unPinPage(file, pageNo, false);
+		count++;
+	}
+	*hits = count;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::uint32_t maxThreads = std::thread::hardware_concurrency();
+	std::uint32_t shards = 16;
+	std::uint32_t pages = 4096;
+	long seconds = 1;
+	for (int a = 1; a < argc; a++)
+	{
+		if (std::strcmp(argv[a], "-t") == 0)
+			maxThreads = (std::uint32_t) argument(argc, argv, a);
+		else if (std::strcmp(argv[a], "-s") == 0)
+			shards = (std::uint32_t) argument(argc, argv, a);
+		else if (std::strcmp(argv[a], "-p") == 0)
+			pages = (std::uint32_t) argument(argc, argv, a);
+		else if (std::strcmp(argv[a], "-d") == 0)
+			seconds = argument(argc, argv, a);
+		else
+			usage();
+	}
+	if (maxThreads == 0)
+		maxThreads = 1;
+
+	try
+	{
+		File::remove(FILE_NAME);
+	}
+	catch (const FileNotFoundException &)
+	{
+	}
+
+	{
+		PageFile file = PageFile::create(FILE_NAME);
+		// room for every page, so that each pin after the first is a hit
+		BufMgr bufMgr(pages + pages / 4, shards);
+		std::vector<PageId> pageNos(pages);
+		for (std::uint32_t p = 0; p < pages; p++)
+		{
+			Page* page;
+			bufMgr.allocPage(&file, pageNos[p], page);
+			bufMgr.unPinPage(&file, pageNos[p], true);
+		}
+		bufMgr.flushFile(&file);
+		for (std::uint32_t p = 0; p < pages; p++)
+		{
+			Page* page;
+			bufMgr.readPage(&file, pageNos[p], page);
+			bufMgr.unPinPage(&file, pageNos[p], false);
+		}
+
+		std::cout << pages << " pages, " << shards << " shards, " << seconds << " s per run\n";
+		std::printf("\n%8s %14s %8s\n", "threads", "hits/s", "speedup");
+		double single = 0;
+		for (std::uint32_t threads = 1; ; threads = threads * 2 < maxThreads ? threads * 2 : maxThreads)
+		{
+			std::atomic<bool> stop(false);
+			std::vector<std::uint64_t> hits(threads, 0);
+			std::vector<std::thread> workers;
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (std::uint32_t t = 0; t < threads; t++)
+				workers.push_back(std::thread(hitPages, &bufMgr, &file, &pageNos, t + 1, &stop, &hits[t]));
+			std::this_thread::sleep_for(std::chrono::seconds(seconds));
+			stop.store(true);
+			for (std::uint32_t t = 0; t < threads; t++)
+				workers[t].join();
+			const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			std::uint64_t total = 0;
+			for (std::uint32_t t = 0; t < threads; t++)
+				total += hits[t];
+			const double rate = total / elapsed;
+			if (threads == 1)
+				single = rate;
+			std::printf("%8u %14.0f %8.2f\n", threads, rate, rate / single);
+			if (threads == maxThreads)
+				break;
+		}
+		bufMgr.flushFile(&file);
+	}
+
+	File::remove(FILE_NAME);
+	return 0;
+}
@@ -7,6 +7,7 @@
 
 #include "btree.h"
 #include "filescan.h"
+#include "page_guard.h"
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
@@ -17,6 +18,7 @@
 #include "exceptions/end_of_file_exception.h"
 #include "exceptions/test_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
+#include "exceptions/index_read_only_exception.h"
 #include <vector>
 
 
@@ -35,12 +37,16 @@ namespace badgerdb {
                            const Datatype attrType) {
         //Set Index Members
         bufMgr = bufMgrIn;
+        mappedFile = NULL;
         this->attrByteOffset = attrByteOffset;
         attributeType = attrType;
         nodeOccupancy = INTARRAYNONLEAFSIZE;
         leafOccupancy = INTARRAYLEAFSIZE;
         lowValDouble = 0;
         highValDouble = 0;
+        swizzling = false;
+        rootRef = Page::INVALID_NUMBER;
+        swizzledCount = 0;
 
         //Set Index File Name
         std::ostringstream idxStr;
@@ -52,13 +58,9 @@ namespace badgerdb {
             file = new BlobFile(outIndexName, false);
             headerPageNum = 1;
 
-            Page headerPage;
-            Page *headerPagePtr;
-
-            bufMgr->readPage(file, headerPageNum, headerPagePtr);
-            IndexMetaInfo *metaPtr = (IndexMetaInfo *) headerPagePtr;
+            ReadPageGuard headerGuard(bufMgr, file, headerPageNum);
+            const IndexMetaInfo *metaPtr = headerGuard.as<IndexMetaInfo>();
             rootPageNum = metaPtr->rootPageNo;
-            bufMgr->unPinPage(file, headerPageNum, false);
 
         } catch (FileNotFoundException e) {
             file = new BlobFile(outIndexName, true);
@@ -68,12 +70,11 @@ namespace badgerdb {
             PageId &metaRef = metaPageId;
 
             //Allocate Page from file
-            Page metaPage = file->allocatePage(metaRef);
-            Page *metaPtr = &metaPage;
+            file->allocatePage(metaRef);
 
             //Read Page into Buffer
-            bufMgr->readPage(file, metaPageId, metaPtr);
-            IndexMetaInfo *metaInfo = (IndexMetaInfo *) metaPtr;
+            WritePageGuard metaGuard(bufMgr, file, metaPageId);
+            IndexMetaInfo *metaInfo = metaGuard.as<IndexMetaInfo>();
 
 
             //Set Members
@@ -92,12 +93,11 @@ namespace badgerdb {
             PageId &rootRef = rootPageId;
 
             //Allocate Page for root node
-            Page rootPage = file->allocatePage(rootRef);
-            Page *rootPtr = &rootPage;
+            file->allocatePage(rootRef);
 
             //Read Page into Buffer
-            bufMgr->readPage(file, rootPageId, rootPtr);
-            LeafNodeInt *rootNode = (LeafNodeInt *) rootPtr;
+            WritePageGuard rootGuard(bufMgr, file, rootPageId);
+            LeafNodeInt *rootNode = rootGuard.as<LeafNodeInt>();
             for (int i = 0; i < INTARRAYLEAFSIZE - 1; i++) {
                 rootNode->keyArray[i] = -1;
             }
@@ -165,12 +165,11 @@ namespace badgerdb {
             //Create a Sibling Node
             PageId sibId;
             PageId &sibIdRef = sibId;
-            Page sibPage = file->allocatePage(sibIdRef);
+            file->allocatePage(sibIdRef);
 
             //Read Sibling Node into buffer
-            Page *sibPtr = &sibPage;
-            bufMgr->readPage(file, sibId, sibPtr);
-            LeafNodeInt *sibNodePtr = (LeafNodeInt *) sibPtr;
+            WritePageGuard sibGuard(bufMgr, file, sibId);
+            LeafNodeInt *sibNodePtr = sibGuard.as<LeafNodeInt>();
             for (int i = 0; i < INTARRAYLEAFSIZE - 1; i++) {
                 sibNodePtr->keyArray[i] = -1;
             }
@@ -188,12 +187,11 @@ namespace badgerdb {
             //Create new Root Node
             PageId newRootId;
             PageId &newRootRef = newRootId;
-            Page newRootPage = file->allocatePage(newRootRef);
-            Page *newRootPtr = &newRootPage;
+            file->allocatePage(newRootRef);
 
             //Read new Root Node into buffer
-            bufMgr->readPage(file, newRootId, newRootPtr);
-            NonLeafNodeInt *newRootNode = (NonLeafNodeInt *) newRootPtr;
+            WritePageGuard newRootGuard(bufMgr, file, newRootId);
+            NonLeafNodeInt *newRootNode = newRootGuard.as<NonLeafNodeInt>();
             for (int i = 0; i < INTARRAYNONLEAFSIZE; i++) {
                 newRootNode->keyArray[i] = -1;
             }
@@ -210,12 +208,12 @@ namespace badgerdb {
 
             //Update header page
             metaInfo->rootPageNo = newRootId;
-            bufMgr->unPinPage(file, headerPageNum, true);
+            metaGuard.release();
 
             ///Unpinning everything here since we shift our implementation
-            bufMgr->unPinPage(file, newRootId, true);
-            bufMgr->unPinPage(file, sibId, true);
-            bufMgr->unPinPage(file, rootPageId, true);
+            newRootGuard.release();
+            sibGuard.release();
+            rootGuard.release();
             bufMgr->flushFile(file);
 
             //Begin inserting entries and building the B+ tree
@@ -242,12 +240,56 @@ namespace badgerdb {
     }
 
 
+// -----------------------------------------------------------------------------
+// BTreeIndex::BTreeIndex -- Constructor for read-only replicas
+// -----------------------------------------------------------------------------
+
+    BTreeIndex::BTreeIndex(const std::string &relationName,
+                           std::string &outIndexName,
+                           const int attrByteOffset,
+                           const Datatype attrType,
+                           const AccessPattern pattern) {
+        //Set Index Members
+        file = NULL;
+        bufMgr = NULL;
+        this->attrByteOffset = attrByteOffset;
+        attributeType = attrType;
+        nodeOccupancy = INTARRAYNONLEAFSIZE;
+        leafOccupancy = INTARRAYLEAFSIZE;
+        lowValDouble = 0;
+        highValDouble = 0;
+        scanExecuting = false;
+        currentPageNum = 0;
+        currentPageData = NULL;
+        swizzling = false;
+        rootRef = Page::INVALID_NUMBER;
+        swizzledCount = 0;
+
+        //Set Index File Name
+        std::ostringstream idxStr;
+        idxStr << relationName << '.' << attrByteOffset;
+        outIndexName = idxStr.str();
+
+        //Map Index File, which must already have been built
+        mappedFile = new MappedBlobFile(outIndexName, pattern);
+        headerPageNum = 1;
+        const IndexMetaInfo *metaPtr = (const IndexMetaInfo *) mappedFile->page(headerPageNum);
+        rootPageNum = metaPtr->rootPageNo;
+    }
+
+
 // -----------------------------------------------------------------------------
 // BTreeIndex::~BTreeIndex -- destructor
 // -----------------------------------------------------------------------------
 
     BTreeIndex::~BTreeIndex() {
 
+        //Nothing is pinned in a mapped index
+        if (mappedFile != NULL) {
+            delete mappedFile;
+            return;
+        }
+
         ///Clean Up State Variables?
 
         //Unpin All Pages From the file
@@ -255,6 +297,10 @@ namespace badgerdb {
             bufMgr->unPinPage(file, currentPageNum, false);
         } catch (BadgerDbException e) {}
 
+        //Release the pins of swizzled references
+        unswizzleAll();
+        bufMgr->removePinHolder(this);
+
         //Flush The File
         bufMgr->flushFile(file);
 
@@ -268,13 +314,16 @@ namespace badgerdb {
 // -----------------------------------------------------------------------------
 
     const void BTreeIndex::insertEntry(const void *key, const RecordId rid) {
+        if (mappedFile != NULL) {
+            throw IndexReadOnlyException(mappedFile->filename());
+        }
+
         PageId currPageId = rootPageNum;
-        Page *currPage;
         int newKey = *(int *) key;
 
         //Start At Root Node
-        bufMgr->readPage(file, currPageId, currPage);
-        NonLeafNodeInt *currNode = (NonLeafNodeInt *) currPage;
+        ReadPageGuard currGuard(bufMgr, file, currPageId);
+        const NonLeafNodeInt *currNode = currGuard.as<NonLeafNodeInt>();
 
         //Array for keeping track of which nodes have been visited
         int treeHeight = currNode->level + 1;
@@ -307,19 +356,22 @@ namespace badgerdb {
                 }
             }
 
+            //Child may be swizzled
+            nextNode = pageNumberOf(nextNode);
+
             //If this node is at level 1, then it's child is a leaf
             if (currNode->level == 1) {
                 leafParentFound = true;
             }
 
             //unpin the current page
-            bufMgr->unPinPage(file, currPageId, false);
+            currGuard.release();
 
             if (!leafParentFound) {
                 //Move the pointer to the next node
                 currPageId = nextNode;
-                bufMgr->readPage(file, currPageId, currPage);
-                currNode = (NonLeafNodeInt *) currPage;
+                currGuard = ReadPageGuard(bufMgr, file, currPageId);
+                currNode = currGuard.as<NonLeafNodeInt>();
 
                 //Add this node to the list of nodes scanned
                 nodesScanned[currNode->level] = currPageId;
@@ -327,10 +379,9 @@ namespace badgerdb {
         }
 
         //Next Node is the leaf node
-        PageId leafId = nextNode;
         currPageId = nextNode;
-        bufMgr->readPage(file, currPageId, currPage);
-        LeafNodeInt *leafNode = (LeafNodeInt *) currPage;
+        WritePageGuard leafGuard(bufMgr, file, currPageId);
+        LeafNodeInt *leafNode = leafGuard.as<LeafNodeInt>();
         nodesScanned[0] = currPageId;
 
         int insertAt = -1;
@@ -353,19 +404,17 @@ namespace badgerdb {
             }
             leafNode->keyArray[insertAt] = newKey;
             leafNode->ridArray[insertAt] = rid;
-            bufMgr->unPinPage(file, currPageId, true);
             return;
         }
 
         //Leaf Node is full, splits required
         PageId sibId;
         PageId &sibRef = sibId;
-        Page sibPage = file->allocatePage(sibRef);
+        file->allocatePage(sibRef);
 
         //Read Sibling Page into buffer
-        Page *sibPagePtr = &sibPage;
-        bufMgr->readPage(file, sibId, sibPagePtr);
-        LeafNodeInt *sibPtr = (LeafNodeInt *) sibPagePtr;
+        WritePageGuard sibGuard(bufMgr, file, sibId);
+        LeafNodeInt *sibPtr = sibGuard.as<LeafNodeInt>();
         for (int i = 0; i < INTARRAYLEAFSIZE; i++) {
             sibPtr->keyArray[i] = -1;
         }
@@ -421,35 +470,35 @@ namespace badgerdb {
         //Update Right Sibling Pointers
         sibPtr->rightSibPageNo = leafNode->rightSibPageNo;
         leafNode->rightSibPageNo = sibId;
-        bufMgr->unPinPage(file, leafId, true);
+        leafGuard.release();
 
         //Grab Key to be pushed up then unpin pages
         int upKey = sibPtr->keyArray[0];
-        bufMgr->unPinPage(file, sibId, true);
+        sibGuard.release();
+
+        //Parents are about to change, put page numbers back in them first
+        unswizzleAll();
 
         for (int i = 1; i <= treeHeight; i++) {
             if(i == treeHeight){
                 //Nothing else to scan, make a new root
                 PageId newRootId;
                 PageId &newRootRef = newRootId;
-                Page newRootPage = file->allocatePage(newRootRef);
-                Page *newRootPagePtr = &newRootPage;
-                bufMgr->readPage(file, newRootId, newRootPagePtr);
-                NonLeafNodeInt *rootPtr = (NonLeafNodeInt*) newRootPagePtr;
+                file->allocatePage(newRootRef);
+                WritePageGuard newRootGuard(bufMgr, file, newRootId);
+                NonLeafNodeInt *rootPtr = newRootGuard.as<NonLeafNodeInt>();
 
                 rootPtr->level = treeHeight;
                 rootPtr->keyArray[0] = upKey;
                 rootPtr->pageNoArray[0] = currPageId;
                 rootPtr->pageNoArray[1] = sibId;
 
-                bufMgr->unPinPage(file, newRootId, true);
-
-                Page *header;
-                bufMgr->readPage(file, headerPageNum, header);
+                newRootGuard.release();
 
-                IndexMetaInfo *headerPtr = (IndexMetaInfo*) header;
+                WritePageGuard headerGuard(bufMgr, file, headerPageNum);
+                IndexMetaInfo *headerPtr = headerGuard.as<IndexMetaInfo>();
                 headerPtr->rootPageNo = newRootId;
-                bufMgr->unPinPage(file, headerPageNum, true);
+                headerGuard.release();
 
                 rootPageNum = newRootId;
                 break;
@@ -457,44 +506,43 @@ namespace badgerdb {
             //Read in Node Parent
             currPageId = nodesScanned[i];
 
-            bufMgr->readPage(file, currPageId, currPage);
-            currNode = (NonLeafNodeInt *) currPage;
+            WritePageGuard parentGuard(bufMgr, file, currPageId);
+            NonLeafNodeInt *parentNode = parentGuard.as<NonLeafNodeInt>();
 
 
             //Find where the new key should be put
             for (int i = 0; i < INTARRAYNONLEAFSIZE; i++) {
-                if (currNode->keyArray[i] == -1) {
+                if (parentNode->keyArray[i] == -1) {
                     insertAt = i;
                     break;
                 }
-                if (currNode->keyArray[i] > newKey) {
+                if (parentNode->keyArray[i] > newKey) {
                     insertAt = i;
                     break;
                 }
             }
 
             //Check If There is Room in this node
-            if (currNode->keyArray[INTARRAYNONLEAFSIZE - 1] == -1) {
+            if (parentNode->keyArray[INTARRAYNONLEAFSIZE - 1] == -1) {
                 //Move Values over
                 for (int i = INTARRAYNONLEAFSIZE - 1; i > insertAt; i--) {
-                    currNode->keyArray[i] = currNode->keyArray[i - 1];
-                    currNode->pageNoArray[i + 1] = currNode->pageNoArray[i];
+                    parentNode->keyArray[i] = parentNode->keyArray[i - 1];
+                    parentNode->pageNoArray[i + 1] = parentNode->pageNoArray[i];
                 }
 
                 //Insert Key
-                currNode->keyArray[insertAt] = upKey;
-                currNode->pageNoArray[insertAt + 1] = sibId;
+                parentNode->keyArray[insertAt] = upKey;
+                parentNode->pageNoArray[insertAt + 1] = sibId;
 
                 //Unpin The Page and done.
-                bufMgr->unPinPage(file, currPageId, true);
+                parentGuard.release();
                 break;
             } else {
                 PageId upSibId;
                 PageId &upSibRef = upSibId;
-                Page upSibPage = file->allocatePage(upSibRef);
-                Page *upSibPagePtr = &upSibPage;
-                bufMgr->readPage(file, upSibId, upSibPagePtr);
-                NonLeafNodeInt *upSibPtr = (NonLeafNodeInt *) upSibPagePtr;
+                file->allocatePage(upSibRef);
+                WritePageGuard upSibGuard(bufMgr, file, upSibId);
+                NonLeafNodeInt *upSibPtr = upSibGuard.as<NonLeafNodeInt>();
                 for (int i = 0; i < INTARRAYNONLEAFSIZE; i++) {
                     upSibPtr->keyArray[i] = -1;
                 }
@@ -505,36 +553,36 @@ namespace badgerdb {
                         if (i == insertAt) {
                             upSibPtr->pageNoArray[0] = sibId;
                         } else {
-                            upSibPtr->pageNoArray[0] = currNode->pageNoArray[i + 1];
+                            upSibPtr->pageNoArray[0] = parentNode->pageNoArray[i + 1];
                         }
                     }
                     if (i == insertAt) {
                         upSibPtr->keyArray[i] = upKey;
                         upSibPtr->pageNoArray[i + 1] = sibId;
                     } else {
-                        upSibPtr->keyArray[i - INTARRAYNONLEAFSIZE / 2] = currNode->keyArray[i];
-                        upSibPtr->pageNoArray[i - (INTARRAYNONLEAFSIZE / 2) + 1] = currNode->pageNoArray[i + 1];
+                        upSibPtr->keyArray[i - INTARRAYNONLEAFSIZE / 2] = parentNode->keyArray[i];
+                        upSibPtr->pageNoArray[i - (INTARRAYNONLEAFSIZE / 2) + 1] = parentNode->pageNoArray[i + 1];
                     }
-                    currNode->keyArray[i] = -1;
+                    parentNode->keyArray[i] = -1;
                 }
 
                 if (insertAt < INTARRAYNONLEAFSIZE / 2) {
                     //Move Values over
                     for (int i = INTARRAYNONLEAFSIZE - 1; i > insertAt; i--) {
-                        currNode->keyArray[i] = currNode->keyArray[i - 1];
-                        currNode->pageNoArray[i + 1] = currNode->pageNoArray[i];
+                        parentNode->keyArray[i] = parentNode->keyArray[i - 1];
+                        parentNode->pageNoArray[i + 1] = parentNode->pageNoArray[i];
                     }
 
                     //Insert Key
-                    currNode->keyArray[insertAt] = upKey;
-                    currNode->pageNoArray[insertAt + 1] = sibId;
+                    parentNode->keyArray[insertAt] = upKey;
+                    parentNode->pageNoArray[insertAt + 1] = sibId;
                 }
 
 
                 sibId = upSibId;
                 upKey = upSibPtr->pageNoArray[0];
-                bufMgr->unPinPage(file, upSibId, true);
-                bufMgr->unPinPage(file, currPageId, true);
+                upSibGuard.release();
+                parentGuard.release();
 
 
                 continue;
@@ -576,70 +624,266 @@ namespace badgerdb {
         }
 
         //Find our starting leaf node
-        //Start at root node
+        //Loop Down through NonLeafNodes to Leaves, starting at root node
         Page *currPagePtr;
+        PageId nextNode = findLeaf(lowValInt);
+
+        //Read in the leaf node, in place if the index is mapped, straight from its frame if it is swizzled
+        if (mappedFile != NULL) {
+            currentPageData = mappedFile->page(nextNode);
+        } else if (nextNode & SWIZZLED) {
+            bufMgr->pinFrame(nextNode & ~SWIZZLED, currPagePtr);
+            nextNode = bufMgr->framePageNo(nextNode & ~SWIZZLED);
+            currentPageData = currPagePtr;
+        } else {
+            bufMgr->readPage(file, nextNode, currPagePtr);
+            currentPageData = currPagePtr;
+        }
+        const LeafNodeInt *leafPtr = (const LeafNodeInt *) currentPageData;
+
+        currentPageNum = nextNode;
+
+        //Find the starting entry in the leaf node
+        for (int i = 0; i < INTARRAYLEAFSIZE; i++) {
+            if (lowValInt == leafPtr->keyArray[i]) {
+                if (lowOp == GTE) {
+                    nextEntry = i;
+                } else if (lowOp == GT) {
+                    nextEntry = i + 1;
+                }
+            }
+        }
+        ///Don't Unpin the leaf node since we're not done reading it
+        return;
+
 
-        bufMgr->readPage(file, rootPageNum, currPagePtr);
-        NonLeafNodeInt *nonLeafPtr = (NonLeafNodeInt *) currPagePtr;
+    }
 
-        //Update Member Functions
-        currentPageNum = rootPageNum;
-        currentPageData = currPagePtr;
+// -----------------------------------------------------------------------------
+// BTreeIndex::findLeaf
+// -----------------------------------------------------------------------------
 
-        PageId nextNode;
+    PageId BTreeIndex::findLeaf(const int key) {
+        //Mapped nodes are read in place, and never change
+        if (mappedFile != NULL) {
+            PageId currNo = rootPageNum;
+            while (true) {
+                const NonLeafNodeInt *node = (const NonLeafNodeInt *) mappedFile->page(currNo);
+                const PageId nextNode = node->pageNoArray[childSlot(node, key)];
+                if (node->level == 1) {
+                    return nextNode;
+                }
+                currNo = nextNode;
+            }
+        }
+
+        //Keep the frames read optimistically from being given back to the system meanwhile
+        EpochGuard epoch(bufMgr->getEpochManager());
+
+        //Swizzled descents start at the pinned root
+        if (swizzling && rootRef == Page::INVALID_NUMBER) {
+            Page *rootPtr;
+            bufMgr->readPage(file, rootPageNum, rootPtr);
+            rootRef = bufMgr->frameRef(rootPtr).frameNo | SWIZZLED;
+        }
+        const PageId startRef = swizzling ? rootRef : rootPageNum;
+
+        PageId currRef = startRef;
+        while (true) {
+            PageId nextNode;
+            int slot;
+            int level;
+            if (!readNode(currRef, key, nextNode, slot, level)) {
+                //Node changed under us, start over from the root
+                currRef = startRef;
+                continue;
+            }
+
+            if (swizzling && !(nextNode & SWIZZLED)) {
+                nextNode = swizzleChild(currRef, slot, nextNode);
+            }
+
+            //If this node is at level 1, then it's child is a leaf
+            if (level == 1) {
+                return nextNode;
+            }
+            currRef = nextNode;
+        }
+    }
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::childSlot
+// -----------------------------------------------------------------------------
+
+    int BTreeIndex::childSlot(const NonLeafNodeInt *node, const int key) {
         for (int i = 0; i < INTARRAYNONLEAFSIZE; i++) {
-            if (nonLeafPtr->keyArray[i] == -1) {
+            if (node->keyArray[i] == -1) {
                 //Greater than every key in node that is not full
-                nextNode = nonLeafPtr->pageNoArray[i];
-                break;
+                return i;
             }
-            if (lowValInt < nonLeafPtr->keyArray[i]) {
+            if (key < node->keyArray[i]) {
                 //Greater than every key in node up to ith key
-                nextNode = nonLeafPtr->pageNoArray[i];
-                break;
+                return i;
+            }
+        }
+        //Greater than every key in node that is full
+        return INTARRAYNONLEAFSIZE;
+    }
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::readNode
+// -----------------------------------------------------------------------------
+
+    bool BTreeIndex::readNode(const PageId ref, const int key, PageId &child, int &slot, int &level) {
+        //A swizzled node is pinned, so its frame is known; otherwise try the frame it was last seen in
+        FrameRef frame;
+        const Page *page = NULL;
+        if (ref & SWIZZLED) {
+            frame = bufMgr->frameRef(bufMgr->bufPool + (ref & ~SWIZZLED));
+            page = bufMgr->readOptimistic(frame);
+            if (page == NULL) {
+                return false;
             }
-            if (i == INTARRAYNONLEAFSIZE - 1) {
-                //Greater than every key in node that is full
-                nextNode = nonLeafPtr->pageNoArray[INTARRAYNONLEAFSIZE];
+        } else {
+            std::unordered_map<PageId, FrameRef>::iterator hint = nodeFrames.find(ref);
+            if (hint != nodeFrames.end()) {
+                frame = hint->second;
+                page = bufMgr->readOptimistic(frame);
             }
         }
-        ///Unpin Root because we're done reading it
-        bufMgr->unPinPage(file, rootPageNum, false);
 
-        //If root was level one, then we've found a leaf
-        bool leafNodeFound = false;
-        if (nonLeafPtr->level == 1) {
-            leafNodeFound = true;
+        //Frame unknown or changed, read the node through the buffer pool and remember its frame
+        ReadPageGuard guard;
+        if (page == NULL) {
+            guard = ReadPageGuard(bufMgr, file, ref);
+            page = guard.getPage();
+            nodeFrames[ref] = guard.frameRef();
         }
 
-        //Loop Down through NonLeafNodes to Leaves
-        while (!leafNodeFound) {
-            ///TODO IMPLEMENT THIS
-            std::cout << "Here" << std::endl;
-            leafNodeFound = true;
+        const NonLeafNodeInt *node = (const NonLeafNodeInt *) page;
+        slot = childSlot(node, key);
+        child = node->pageNoArray[slot];
+        level = node->level;
+
+        if (!guard.isValid() && !bufMgr->validateOptimistic(frame)) {
+            if (!(ref & SWIZZLED)) {
+                nodeFrames.erase(ref);
+            }
+            return false;
         }
+        return true;
+    }
 
-        //Read in the leaf node
-        bufMgr->readPage(file, nextNode, currPagePtr);
-        LeafNodeInt *leafPtr = (LeafNodeInt *) currPagePtr;
+// -----------------------------------------------------------------------------
+// BTreeIndex::pageNumberOf
+// -----------------------------------------------------------------------------
 
-        currentPageNum = nextNode;
-        currentPageData = currPagePtr;
+    PageId BTreeIndex::pageNumberOf(const PageId ref) {
+        if (ref & SWIZZLED) {
+            return bufMgr->framePageNo(ref & ~SWIZZLED);
+        }
+        return ref;
+    }
 
-        //Find the starting entry in the leaf node
-        for (int i = 0; i < INTARRAYLEAFSIZE; i++) {
-            if (lowValInt == leafPtr->keyArray[i]) {
-                if (lowOp == GTE) {
-                    nextEntry = i;
-                } else if (lowOp == GT) {
-                    nextEntry = i + 1;
-                }
+// -----------------------------------------------------------------------------
+// BTreeIndex::swizzleChild
+// -----------------------------------------------------------------------------
+
+    PageId BTreeIndex::swizzleChild(const PageId parentRef, const int slot, const PageId childNo) {
+        if (swizzledCount >= bufMgr->getNumBufs() / 4) {
+            return childNo;
+        }
+
+        //The reference must still be there once the parent is latched
+        WritePageGuard parentGuard(bufMgr, file, pageNumberOf(parentRef));
+        NonLeafNodeInt *parentNode = parentGuard.as<NonLeafNodeInt>();
+        if (parentNode->pageNoArray[slot] != childNo) {
+            return childNo;
+        }
+
+        //The pin taken here belongs to the swizzled reference
+        Page *childPtr;
+        bufMgr->readPage(file, childNo, childPtr);
+        PageId childRef = bufMgr->frameRef(childPtr).frameNo | SWIZZLED;
+        parentNode->pageNoArray[slot] = childRef;
+        swizzledCount++;
+        return childRef;
+    }
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::unswizzleAll
+// -----------------------------------------------------------------------------
+
+    void BTreeIndex::unswizzleAll() {
+        if (rootRef == Page::INVALID_NUMBER) {
+            return;
+        }
+
+        PageId rootNo = pageNumberOf(rootRef);
+        unswizzleNode(rootNo);
+        bufMgr->unPinPage(file, rootNo, false);
+        rootRef = Page::INVALID_NUMBER;
+    }
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::unswizzleNode
+// -----------------------------------------------------------------------------
+
+    void BTreeIndex::unswizzleNode(const PageId pageNo) {
+        WritePageGuard nodeGuard(bufMgr, file, pageNo);
+        NonLeafNodeInt *node = nodeGuard.as<NonLeafNodeInt>();
+
+        for (int i = 0; i <= INTARRAYNONLEAFSIZE && swizzledCount > 0; i++) {
+            if (!(node->pageNoArray[i] & SWIZZLED)) {
+                continue;
+            }
+
+            //Children that are not leaves may have swizzled references of their own
+            PageId childNo = pageNumberOf(node->pageNoArray[i]);
+            if (node->level != 1) {
+                unswizzleNode(childNo);
             }
+            node->pageNoArray[i] = childNo;
+            bufMgr->unPinPage(file, childNo, false);
+            swizzledCount--;
         }
-        ///Don't Unpin the leaf node since we're not done reading it
-        return;
+    }
 
+// -----------------------------------------------------------------------------
+// BTreeIndex::setSwizzling
+// -----------------------------------------------------------------------------
 
+    void BTreeIndex::setSwizzling(const bool enabled) {
+        //Mapped nodes have no frames to swizzle references to
+        if (mappedFile != NULL) {
+            return;
+        }
+        if (enabled) {
+            bufMgr->addPinHolder(this);
+        } else {
+            unswizzleAll();
+            bufMgr->removePinHolder(this);
+        }
+        swizzling = enabled;
+    }
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::releasePins
+// -----------------------------------------------------------------------------
+
+    void BTreeIndex::releasePins() {
+        unswizzleAll();
+    }
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::warmUp
+// -----------------------------------------------------------------------------
+
+    std::uint32_t BTreeIndex::warmUp(const std::string &snapshotPath) {
+        if (mappedFile != NULL) {
+            return 0;
+        }
+        return bufMgr->loadSnapshot(snapshotPath, std::vector<File *>(1, file));
     }
 
 // -----------------------------------------------------------------------------
@@ -647,7 +891,7 @@ namespace badgerdb {
 // -----------------------------------------------------------------------------
 
     const void BTreeIndex::scanNext(RecordId &outRid) {
-        LeafNodeInt *leafPtr = (LeafNodeInt *) currentPageData;
+        const LeafNodeInt *leafPtr = (const LeafNodeInt *) currentPageData;
 
         //Is next entry outside scan range
         if (highOp == LT && leafPtr->keyArray[nextEntry] >= highValInt) {
@@ -668,15 +912,34 @@ namespace badgerdb {
             Page *nextPage;
             PageId nextPageId = leafPtr->rightSibPageNo;
 
+            //Mapped leaves are read in place, with the following one paged in meanwhile
+            if (mappedFile != NULL) {
+                nextEntry = 0;
+                currentPageNum = nextPageId;
+                currentPageData = mappedFile->page(nextPageId);
+
+                PageId followingPageId = ((const LeafNodeInt *) currentPageData)->rightSibPageNo;
+                if (followingPageId != Page::INVALID_NUMBER) {
+                    mappedFile->willNeed(followingPageId, 1);
+                }
+                return;
+            }
+
             ///Unpin page first, to ensure room
             bufMgr->unPinPage(file, currentPageNum, false);
-            bufMgr->readPage(file, nextPageId, nextPage);
+            bufMgr->readPage(file, nextPageId, nextPage, &scanRing);
 
             //Update Object members
             nextEntry = 0;
             currentPageNum = nextPageId;
             currentPageData = nextPage;
 
+            //Have the following leaf read in while this one is scanned
+            PageId followingPageId = ((LeafNodeInt *) nextPage)->rightSibPageNo;
+            if (followingPageId != Page::INVALID_NUMBER) {
+                bufMgr->prefetchPages(file, followingPageId, 1);
+            }
+
             return;
         }
 
@@ -695,7 +958,9 @@ namespace badgerdb {
         }
 
         //Current Page should be the only page pinned for the purpose of the scan
-        bufMgr->unPinPage(file, currentPageNum, false);
+        if (mappedFile == NULL) {
+            bufMgr->unPinPage(file, currentPageNum, false);
+        }
 
         //Reset variables
         scanExecuting = false;
@@ -719,16 +984,14 @@ namespace badgerdb {
     }
 
     const std::string BTreeIndex::getRelName() {
-        Page header;
-        Page *headerPtr = &header;
-        std::string relationName;
-
-        bufMgr->readPage(file, headerPageNum, headerPtr);
-        IndexMetaInfo *ptr = (IndexMetaInfo *) headerPtr;
-        relationName = ptr->relationName;
+        if (mappedFile != NULL) {
+            const IndexMetaInfo *ptr = (const IndexMetaInfo *) mappedFile->page(headerPageNum);
+            return std::string(ptr->relationName);
+        }
 
-        bufMgr->unPinPage(file, headerPageNum, false);
+        ReadPageGuard headerGuard(bufMgr, file, headerPageNum);
+        const IndexMetaInfo *ptr = headerGuard.as<IndexMetaInfo>();
 
-        return relationName;
+        return std::string(ptr->relationName);
     }
 }
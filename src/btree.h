@@ -11,6 +11,7 @@
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <unordered_map>
 
 #include "types.h"
 #include "page.h"
@@ -190,7 +191,7 @@ struct LeafNodeInt{
  * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
  * relation. This index supports only one scan at a time.
 */
-class BTreeIndex {
+class BTreeIndex : public PinHolder {
 
  private:
 
@@ -204,6 +205,11 @@ class BTreeIndex {
    */
 	BufMgr	*bufMgr;
 
+  /**
+   * Index file mapped into memory when the index is opened read-only, in which case file and bufMgr are NULL.
+   */
+	MappedBlobFile	*mappedFile;
+
   /**
    * Page number of meta page.
    */
@@ -255,7 +261,12 @@ class BTreeIndex {
   /**
    * Current Page being scanned.
    */
-	Page		*currentPageData;
+	const Page	*currentPageData;
+
+  /**
+   * Frames recycled for the leaves read by the scan, so that a long scan does not flush the buffer pool.
+   */
+	BufRing	scanRing;
 
   /**
    * Low INTEGER value for scan.
@@ -297,6 +308,92 @@ class BTreeIndex {
    */
 	Operator	highOp;
 
+  /**
+   * Frames the non-leaf nodes were last read from, so that descents can read them again without pinning them.
+   */
+	std::unordered_map<PageId, FrameRef>	nodeFrames;
+
+	// MEMBERS SPECIFIC TO SWIZZLING
+
+  /**
+   * Bit set in a child reference of a non-leaf node that holds the number of the frame the child is in, instead
+   * of its page number.  Page numbers of index files stay below it.
+   */
+	static const PageId SWIZZLED = 0x80000000;
+
+  /**
+   * True if child references are swizzled by descents.
+   */
+	bool		swizzling;
+
+  /**
+   * Swizzled reference to the root, which is kept pinned while the tree below it has swizzled references;
+   * Page::INVALID_NUMBER if it is not pinned.
+   */
+	PageId	rootRef;
+
+  /**
+   * Number of swizzled child references, each holding a pin on its child.
+   */
+	std::uint32_t	swizzledCount;
+
+  /**
+   * Descends the non-leaf levels of the tree to the leaf the given key belongs in.  Nodes are read optimistically
+   * from the frames they were last seen in; a node whose frame has changed is read through the buffer manager
+   * instead, and if a node changes while it is being read the descent starts over from the root.
+   *
+   * @param key     Key to look for
+   * @return Page number of the leaf
+   */
+	PageId findLeaf(const int key);
+
+  /**
+   * Returns the index of the reference to the child of a non-leaf node the given key belongs in.
+   */
+	static int childSlot(const NonLeafNodeInt *node, const int key);
+
+  /**
+   * Reads a non-leaf node, optimistically if its frame is known and unchanged, and finds the child the given
+   * key belongs in.
+   *
+   * @param ref     Page number of the node, or its swizzled reference
+   * @param key     Key to look for
+   * @param child   Reference to the child, possibly swizzled, returned via this variable
+   * @param slot    Index of the reference to the child in the node, returned via this variable
+   * @param level   Level of the node, returned via this variable
+   * @return False if the node changed while it was read optimistically, in which case nothing is returned
+   */
+	bool readNode(const PageId ref, const int key, PageId &child, int &slot, int &level);
+
+  /**
+   * Returns the page number a child reference stands for.  The caller must hold a pin or latch on the node the
+   * reference was read from, or validate what it read.
+   */
+	PageId pageNumberOf(const PageId ref);
+
+  /**
+   * Replaces a reference to a child by the number of the frame the child is in, pinning the child for as long
+   * as the reference stays swizzled.  Nothing is swizzled once a quarter of the buffer pool is pinned that way.
+   *
+   * @param parentRef Page number of the node holding the reference, or its swizzled reference
+   * @param slot      Index of the reference in the node
+   * @param childNo   Page number of the child
+   * @return The swizzled reference, or childNo if the reference was left alone
+   */
+	PageId swizzleChild(const PageId parentRef, const int slot, const PageId childNo);
+
+  /**
+   * Puts page numbers back in place of all swizzled references and releases their pins, and the root's.
+   * Must be done before non-leaf nodes are changed, so that a swizzled reference never moves to another node,
+   * and before the index file is flushed.
+   */
+	void unswizzleAll();
+
+  /**
+   * Puts page numbers back in place of the swizzled references of a node and of the nodes below it.
+   */
+	void unswizzleNode(const PageId pageNo);
+
 	
  public:
 
@@ -314,6 +411,23 @@ class BTreeIndex {
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
 						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+
+  /**
+   * BTreeIndex Constructor for read-only replicas.
+	 * Maps the existing index file into memory, so that lookups and scans go through its nodes in place, without
+	 * the buffer manager.  The index cannot be changed: insertEntry() throws, and the file must not be changed
+	 * by anyone else while the index is open.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param attrByteOffset			Offset of attribute, over which index is built, in the record
+   * @param attrType						Datatype of attribute over which index is built
+   * @param pattern							How the nodes will be accessed: ACCESS_RANDOM for lookups, ACCESS_SEQUENTIAL for
+   *                          scans over most of the index
+   * @throws  FileNotFoundException     If the index file does not exist.
+   */
+	BTreeIndex(const std::string & relationName, std::string & outIndexName,
+						const int attrByteOffset,	const Datatype attrType, const AccessPattern pattern = ACCESS_RANDOM);
 	
 
   /**
@@ -333,6 +447,7 @@ class BTreeIndex {
 	 * Make sure to unpin pages as soon as you can.
    * @param key			Key to insert, pointer to integer/double/char string
    * @param rid			Record ID of a record whose entry is getting inserted into the index.
+	 * @throws  IndexReadOnlyException If the index was opened read-only.
 	**/
 	const void insertEntry(const void* key, const RecordId rid);
 
@@ -365,6 +480,33 @@ class BTreeIndex {
 	const void scanNext(RecordId& outRid);  // returned record id
 
 
+  /**
+	 * Turns swizzling of child references on or off.  When it is on, descents replace the references of non-leaf
+	 * nodes to the children they pass through by the frames those children are in, so that later descents go
+	 * straight from frame to frame without looking pages up.  Swizzled children stay pinned until swizzling is
+	 * turned off, the tree is split or the index is closed, or the buffer pool asks for them back through
+	 * releasePins() when it shrinks or is destroyed.  It is off by default, and has no effect on an index opened
+	 * read-only.
+	 *
+	 * @param enabled True to swizzle child references
+	**/
+	void setSwizzling(const bool enabled);
+
+  /**
+	 * Puts page numbers back in place of all swizzled references and releases their pins.  Called by the buffer
+	 * manager while swizzling is on; later descents swizzle references again.
+	**/
+	void releasePins();
+
+  /**
+	 * Reads the pages of the index listed in a buffer pool snapshot back into the buffer pool, so that the index
+	 * does not start cold.  See BufMgr::saveSnapshot() and BufMgr::loadSnapshot().
+	 *
+	 * @param snapshotPath Name of the snapshot file
+	 * @return Number of pages read, 0 if there is no snapshot or the index was opened read-only
+	**/
+	std::uint32_t warmUp(const std::string & snapshotPath);
+
   /**
 	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
 	 * @throws ScanNotInitializedException If no scan has been initialized.
@@ -15,100 +15,98 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+std::uint32_t BufHashTbl::hash(const File* file, const PageId pageNo) const
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  // combine the whole file pointer with the page number and run it through a
+  // 64-bit finalizer, so that neighbouring pages land in unrelated slots
+  std::uint64_t key = (std::uint64_t) file ^ ((std::uint64_t) pageNo << 32 | pageNo);
+  key ^= key >> 33;
+  key *= 0xFF51AFD7ED558CCDULL;
+  key ^= key >> 33;
+  key *= 0xC4CEB9FE1A85EC53ULL;
+  key ^= key >> 33;
+  return (std::uint32_t) key & mask;
+}
+
+std::uint32_t BufHashTbl::probe(const File* file, const PageId pageNo) const
+{
+  std::uint32_t index = hash(file, pageNo);
+  while (ht[index].file != NULL &&
+         (ht[index].file != file || ht[index].pageNo != pageNo))
+    index = (index + 1) & mask;
+  return index;
 }
 
 BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
+	: numEntries(0)
 {
-  // allocate an array of pointers to hashBuckets
-  ht = new hashBucket* [htSize];
-  for(int i=0; i < HTSIZE; i++)
-    ht[i] = NULL;
+  // keep the table at most half full
+  HTSIZE = 2;
+  while (HTSIZE < 2 * (std::uint32_t) htSize)
+    HTSIZE <<= 1;
+  mask = HTSIZE - 1;
+
+  ht = new hashSlot[HTSIZE];
+  for(std::uint32_t i = 0; i < HTSIZE; i++)
+    ht[i].file = NULL;
 }
 
 BufHashTbl::~BufHashTbl()
 {
-  for(int i = 0; i < HTSIZE; i++) {
-    hashBucket* tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
-      delete tmpBuf;
-    }
-  }
   delete [] ht;
 }
 
 void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
 {
-  int index = hash(file, pageNo);
-
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
-  }
-
-  tmpBuc = new hashBucket;
-  if (!tmpBuc)
+  // one slot always stays empty so that probe runs terminate
+  if (numEntries + 1 >= HTSIZE)
   	throw HashTableException();
 
-  tmpBuc->file = (File*) file;
-  tmpBuc->pageNo = pageNo;
-  tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+  std::uint32_t index = probe(file, pageNo);
+  if (ht[index].file != NULL)
+  	throw HashAlreadyPresentException(ht[index].file->filename(), ht[index].pageNo, ht[index].frameNo);
+
+  ht[index].file = file;
+  ht[index].pageNo = pageNo;
+  ht[index].frameNo = frameNo;
+  numEntries++;
 }
 
-void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+bool BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) const
 {
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-    {
-      frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
-    }
-    tmpBuc = tmpBuc->next;
-  }
+  std::uint32_t index = probe(file, pageNo);
+  if (ht[index].file == NULL)
+    return false;
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  frameNo = ht[index].frameNo; // return frameNo by reference
+  return true;
 }
 
 void BufHashTbl::remove(const File* file, const PageId pageNo) {
 
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  hashBucket* prevBuc = NULL;
-
-  while (tmpBuc)
-	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-		{
-      if(prevBuc) 
-				prevBuc->next = tmpBuc->next;
-      else
-				ht[index] = tmpBuc->next;
-
-      delete tmpBuc;
-      return;
-    }
-		else
-		{
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
+  std::uint32_t hole = probe(file, pageNo);
+  if (ht[hole].file == NULL)
+    throw HashNotFoundException(file->filename(), pageNo);
+
+  // backward shift deletion: move later entries of the probe run into the
+  // hole unless that would move them in front of their home slot
+  std::uint32_t index = hole;
+  while (true)
+  {
+    index = (index + 1) & mask;
+    if (ht[index].file == NULL)
+      break;
+
+    std::uint32_t home = hash(ht[index].file, ht[index].pageNo);
+    if (((index - home) & mask) >= ((index - hole) & mask))
+    {
+      ht[hole] = ht[index];
+      hole = index;
     }
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  ht[hole].file = NULL;
+  numEntries--;
 }
 
 }
@@ -14,11 +14,11 @@ namespace badgerdb {
 /**
 * @brief Declarations for buffer pool hash table
 */
-struct hashBucket {
+struct hashSlot {
 	/**
-	 * pointer a file object (more on this below)
+	 * pointer a file object (more on this below); NULL if the slot is empty
 	 */
-	File *file;
+	const File *file;
 
 	/**
 	 * page number within a file
@@ -29,30 +29,42 @@ struct hashBucket {
 	 * frame number of page in the buffer pool
 	 */
 	FrameId frameNo;
-
-	/**
-	 * Next node in the hash table
-	 */
-	hashBucket*   next;
 };
 
 
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
+* The table uses open addressing with linear probing over a flat, power of two sized array of
+* slots, so entries are never allocated individually and a lookup usually touches a single
+* cache line.  Removal shifts the following entries of the probe run back instead of leaving
+* tombstones.  The table never holds more entries than there are frames in the buffer pool,
+* so it is sized once, to at most half full, and never grows.
+*
 * @warning This class is not threadsafe.
 */
 class BufHashTbl
 {
  private:
 	/**
-	 *	Size of Hash Table
+	 *	Number of slots in the hash table, a power of two
+	 */
+  std::uint32_t HTSIZE;
+
+	/**
+	 *	HTSIZE - 1, used to wrap slot indexes
 	 */
-  int HTSIZE;
+  std::uint32_t mask;
+
+	/**
+	 *	Number of entries currently in the table
+	 */
+  std::uint32_t numEntries;
+
 	/**
 	 * Actual Hash table object
 	 */
-  hashBucket**  ht;
+  hashSlot*  ht;
 
 	/**
 	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
@@ -61,11 +73,22 @@ class BufHashTbl
 	 * @param pageNo  Page number in the file
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  std::uint32_t hash(const File* file, const PageId pageNo) const;
+
+	/**
+	 * returns the index of the slot holding (file, pageNo), or of the empty slot ending its probe run
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			Slot index.
+	 */
+  std::uint32_t probe(const File* file, const PageId pageNo) const;
 
  public:
 	/**
    * Constructor of BufHashTbl class
+	 *
+	 * @param htSize 	Number of entries the table must be able to hold
 	 */
 	BufHashTbl(const int htSize);  // constructor
 
@@ -81,20 +104,22 @@ class BufHashTbl
 	 * @param pageNo 	Page number in the file
 	 * @param frameNo Frame number assigned to that page of the file
    * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
-   * @throws  HashTableException (optional) if could not create a new bucket as running of memory
+   * @throws  HashTableException if the table is full
 	 */
   void insert(const File* file, const PageId pageNo, const FrameId frameNo);
 
 	/**
    * Check if (file, pageNo) is currently in the buffer pool (ie. in
-   * the hash table).
+   * the hash table).  A page not being in the table is a normal outcome
+   * (a buffer miss), so it is reported through the return value rather
+   * than an exception.
 	 *
 	 * @param file  	File object
 	 * @param pageNo	Page number in the file
-	 * @param frameNo Frame number reference
-   * @throws HashNotFoundException if the page entry is not found in the hash table 
+	 * @param frameNo Frame number reference, set only if the page is found
+	 * @return  			True if the page entry is in the hash table
 	 */
-  void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
+  bool lookup(const File* file, const PageId pageNo, FrameId &frameNo) const;
 
 	/**
    * Delete entry (file,pageNo) from hash table.
@@ -5,148 +5,504 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <map>
 #include <memory>
+#include <type_traits>
 #include <iostream>
+#include <sstream>
 #include "buffer.h"
+#include "page_guard.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/hash_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include <new>
 
 namespace badgerdb { 
 
+const FrameId BufDesc::NO_FRAME;
+
+// frames in the arena are never constructed, only assigned whole pages
+static_assert(std::is_trivially_copyable<Page>::value && sizeof(Page) == Page::SIZE,
+              "buffer pool frames must be plain Page::SIZE byte blocks");
+
+/**
+* Returns the nanoseconds elapsed since a point in time
+*/
+static std::uint64_t nanosSince(const std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
-	bufDescTable = new BufDesc[bufs];
+BufMgr::BufMgr(std::uint32_t bufs, std::uint32_t shardCount, ReplacementPolicyType policy, std::uint32_t maxBufs)
+	: numBufs(bufs), retiredVersion(0), ringGeneration(0), tracer(NULL), sampler(NULL), frameWaitMs(0), bgWriterStop(false), bgCleanRatio(0),
+	  bgPagesPerRound(0), bgRoundInterval(0), raStop(false), raCurrentFile(NULL), raWindow(0), ioStop(false) {
+	// every shard needs at least one frame
+	numShards = shardCount == 0 ? 1 : shardCount;
+	if (numShards > bufs)
+		numShards = bufs;
+
+	if (maxBufs == 0)
+		maxBufs = bufs > DEFAULT_MAX_BUFS ? bufs : DEFAULT_MAX_BUFS;
+
+	// descriptors and frames live in arenas with room to grow in place, frames
+	// are mapped, not initialized, so that even a huge pool is set up at once
+	descArena = new BufArena((std::size_t) bufs * sizeof(BufDesc), (std::size_t) maxBufs * sizeof(BufDesc));
+	poolArena = new BufArena((std::size_t) bufs * sizeof(Page), (std::size_t) maxBufs * sizeof(Page));
+	bufDescTable = static_cast<BufDesc*>(descArena->base());
+	bufPool = static_cast<Page*>(poolArena->base());
 
   for (FrameId i = 0; i < bufs; i++) 
   {
+  	new (&bufDescTable[i]) BufDesc();
   	bufDescTable[i].frameNo = i;
   	bufDescTable[i].valid = false;
   }
 
-  bufPool = new Page[bufs];
+	shards = new BufShard[numShards];
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		BufShard & shard = shards[s];
+		shard.shardNo = s;
+		shard.numFrames = shardFrames(s, bufs);
+		rebuildHashTable(shard);  // allocate the buffer hash table
 
-  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+		shard.policy = ReplacementPolicy::create(policy, s, numShards, shard.numFrames);
+	}
 
-  clockHand = bufs - 1;
+	setReadahead(8);
 }
 
 
 BufMgr::~BufMgr() {
-  //Flush out all unwritten pages
-  for (std::uint32_t i = 0; i < numBufs; i++) 
+  // swizzled references and the like must not reach disk
+  releaseHeldPins();
+
+  stopAsyncIO();
+  stopBgWriter();
+  stopReadahead();
+  stopTrace();
+  stopMrcSampling();
+
+  //Flush out all unwritten pages, walking the resident frames of each file
+  std::vector<FrameId> dirtyFrames;
+  for (std::uint32_t s = 0; s < numShards; s++)
+  {
+		BufShard::FileFrameMap & fileFrames = shards[s].fileFrames;
+		for (BufShard::FileFrameMap::iterator it = fileFrames.begin(); it != fileFrames.end(); ++it)
+		{
+			for (FrameId i = it->second; i != BufDesc::NO_FRAME; i = bufDescTable[i].fileNext)
+			{
+				BufDesc* tmpbuf = &bufDescTable[i];
+				if (tmpbuf->valid == true && tmpbuf->dirty == true)
+					dirtyFrames.push_back(i);
+			}
+		}
+  }
+
+  // in runs of consecutive pages, then page by page whatever could not be written that way
+  std::vector<bool> failed;
+  writeFrames(dirtyFrames, failed);
+  for (std::size_t n = 0; n < dirtyFrames.size(); n++)
   {
-  	BufDesc* tmpbuf = &bufDescTable[i];
-  	if (tmpbuf->valid == true && tmpbuf->dirty == true)
+		if (!failed[n])
+			continue;
+		// a destructor cannot throw, so a page that cannot be written either way is reported and lost
+		try
 		{
-			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-  	}
+			bufDescTable[dirtyFrames[n]].file->writePage(bufDescTable[dirtyFrames[n]].pageNo, bufPool[dirtyFrames[n]]);
+		}
+		catch (const BadgerDbException & e)
+		{
+			std::cerr << "Lost page " << bufDescTable[dirtyFrames[n]].pageNo << " of " << bufDescTable[dirtyFrames[n]].file->filename()
+			          << ": " << e.message() << "\n";
+		}
   }
 
-  delete [] bufDescTable;
-  delete [] bufPool;
+  delete [] shards;
+  delete descArena;
+  delete poolArena;
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+BufShard & BufMgr::shardOf(const File* file, const PageId pageNo)
 {
-  // perform first part of clock algorithm to search for 
-  // open buffer frame
-  // Assumes non-concurrent access to buffer manager
-  std::uint32_t numScanned = 0;
-  bool found = 0;
+	if (numShards == 1)
+		return shards[0];
 
-  while (numScanned < 2*numBufs)	//Need to scn twice
-  {
-    // advance the clock
-    advanceClock();
-    numScanned++;
+	// mix the file pointer and page number so that consecutive pages of a file
+	// are spread over all the shards
+	std::uint64_t key = (std::uint64_t) file ^ ((std::uint64_t) pageNo * 0x9E3779B97F4A7C15ULL);
+	key ^= key >> 33;
+	key *= 0xFF51AFD7ED558CCDULL;
+	key ^= key >> 33;
+	return shards[key % numShards];
+}
+
+void BufMgr::waitForIO(BufShard & shard, std::unique_lock<std::mutex> & lock, const FrameId frameNo)
+{
+	while (bufDescTable[frameNo].cleaning || bufDescTable[frameNo].loading)
+		shard.ioDone.wait(lock);
+}
+
+void BufMgr::rebuildHashTable(BufShard & shard)
+{
+	int htsize = ((((int) (shard.numFrames * 1.2))*2)/2)+1;
+	BufHashTbl* hashTable = new BufHashTbl (htsize);
+
+	// enter the pages the shard holds, found through the lists of each file's frames
+	for (BufShard::FileFrameMap::iterator it = shard.fileFrames.begin(); it != shard.fileFrames.end(); ++it)
+	{
+		for (FrameId i = it->second; i != BufDesc::NO_FRAME; i = bufDescTable[i].fileNext)
+			hashTable->insert(bufDescTable[i].file, bufDescTable[i].pageNo, i);
+	}
+
+	delete shard.hashTable;
+	shard.hashTable = hashTable;
+}
+
+void BufMgr::releaseFrame(BufShard & shard, const FrameId frameNo)
+{
+	if (shardIndex(frameNo) < shard.numFrames)
+	{
+		shard.policy->frameFreed(shardIndex(frameNo));
+		if (shard.frameWaiters > 0)
+			shard.ioDone.notify_all();
+	}
+	else
+		shard.ioDone.notify_all();
+}
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
+void BufMgr::mapPage(BufShard & shard, const FrameId frameNo)
+{
+	BufDesc & desc = bufDescTable[frameNo];
+	shard.hashTable->insert(desc.file, desc.pageNo, frameNo);
+
+	// push the frame on its file's list
+	FrameId & head = shard.fileFrames.insert(std::make_pair((const File*) desc.file, BufDesc::NO_FRAME)).first->second;
+	desc.filePrev = BufDesc::NO_FRAME;
+	desc.fileNext = head;
+	if (head != BufDesc::NO_FRAME)
+		bufDescTable[head].filePrev = frameNo;
+	head = frameNo;
+}
+
+void BufMgr::unmapPage(BufShard & shard, const FrameId frameNo)
+{
+	BufDesc & desc = bufDescTable[frameNo];
+	shard.hashTable->remove(desc.file, desc.pageNo);
+
+	if (desc.fileNext != BufDesc::NO_FRAME)
+		bufDescTable[desc.fileNext].filePrev = desc.filePrev;
+	if (desc.filePrev != BufDesc::NO_FRAME)
+		bufDescTable[desc.filePrev].fileNext = desc.fileNext;
+	else if (desc.fileNext != BufDesc::NO_FRAME)
+		shard.fileFrames[desc.file] = desc.fileNext;
+	else
+		shard.fileFrames.erase(desc.file);
+	desc.filePrev = desc.fileNext = BufDesc::NO_FRAME;
+
+	// whatever the frame holds next, optimistic readers of this page must not take it for the page
+	desc.latch.bumpVersion();
+}
+
+void BufMgr::allocBuf(BufShard & shard, std::unique_lock<std::mutex> & lock, const File* file, const PageId pageNo,
+                      FrameId & frame) 
+{
+  if (!tryAllocBuf(shard, lock, file, pageNo, frame))
+    throw BufferExceededException();
+}
+
+bool BufMgr::tryAllocBuf(BufShard & shard, std::unique_lock<std::mutex> & lock, const File* file,
+                         const PageId pageNo, FrameId & frame) 
+{
+  // ask the shard's replacement policy for an empty frame or a victim
+  // Caller holds the shard latch, only frames of this shard are considered
+  std::uint32_t i;
+  FrameId candidate;
+  while (true)
+  {
+    if (!shard.policy->pickVictim(bufDescTable, file, pageNo, i))
     {
-      break;
+      shard.bufStats.sweepLength.record(shard.policy->lastExamined());
+      return false;
     }
+    candidate = shardFrame(shard, i);
+    shard.bufStats.sweepLength.record(shard.policy->lastExamined());
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
+    BufDesc & desc = bufDescTable[candidate];
+    if (!desc.valid || !desc.dirty)
+      break;
+
+    // flush the changes first, without the latch; readers of the page wait for the write as for a read, and
+    // the page stays in the pool if the write fails
+    desc.loading = true;
+    desc.pinCnt++;
+    lock.unlock();
+    try
     {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
-      {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
-        break;
-      }
+      desc.file->writePage(desc.pageNo, bufPool[candidate]);
     }
-    else
+    catch (...)
     {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
+      lock.lock();
+      desc.loading = false;
+      desc.pinCnt--;
+      if (shardIndex(candidate) < shard.numFrames)
+        shard.policy->victimKept(i, desc.file, desc.pageNo);
+      shard.ioDone.notify_all();
+      throw;
     }
+    lock.lock();
+    desc.loading = false;
+    desc.pinCnt--;
+    desc.dirty = false;
+    shard.ioDone.notify_all();
+    tally(shard, desc.file, &BufCounters::dirtyEvictions);
+    tally(shard, desc.file, &BufCounters::diskwrites);
+
+    // a shrink meanwhile may have given the frame up, it then only needs emptying
+    if (shardIndex(candidate) < shard.numFrames)
+      break;
+    unmapPage(shard, candidate);
+    tally(shard, desc.file, &BufCounters::evictions);
+    desc.Clear();
   }
-  
-  // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
-  {
-    throw BufferExceededException();
-  }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+
+  if (bufDescTable[candidate].valid)
   {
-    bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    // remove previous entry from hash table
+    unmapPage(shard, candidate);
+    tally(shard, bufDescTable[candidate].file, &BufCounters::evictions);
   }
 
 	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+  bufDescTable[candidate].Clear();
 
   // return new frame number
-  frame = clockHand;
-} // end allocBuf
+  frame = candidate;
+  return true;
+} // end tryAllocBuf
+
+bool BufMgr::waitForFrame(BufShard & shard, std::unique_lock<std::mutex> & lock, const File* file,
+                          std::chrono::steady_clock::time_point & deadline)
+{
+	const std::uint32_t timeoutMs = frameWaitMs;
+	if (timeoutMs == 0)
+		return false;
+
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (deadline == std::chrono::steady_clock::time_point())
+	{
+		deadline = now + std::chrono::milliseconds(timeoutMs);
+		tally(shard, file, &BufCounters::frameWaits);
+	}
+	else if (now >= deadline)
+		return false;
+
+	// unpinning a frame signals ioDone while anybody waits here
+	shard.frameWaiters++;
+	shard.ioDone.wait_until(lock, deadline);
+	shard.frameWaiters--;
+	return true;
+}
 
 	
-void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+std::deque<RingSlot> & BufMgr::ringSlots(BufRing & ring, const BufShard & shard)
+{
+	// frames recorded before the pool last shrank may be gone
+	if (ring.generation != ringGeneration)
+	{
+		ring.slots.clear();
+		ring.generation = ringGeneration;
+	}
+	if (ring.slots.size() != numShards)
+		ring.slots.resize(numShards);
+	return ring.slots[shard.shardNo];
+}
+
+std::uint32_t BufMgr::ringCapacity(const BufRing & ring) const
+{
+	std::uint32_t size = ring.size < numBufs / 8 ? ring.size : numBufs / 8;
+	return size > numShards ? size / numShards : 1;
+}
+
+bool BufMgr::evictRingFrame(BufShard & shard, const RingSlot & slot)
+{
+	// a frame given up by resize has no descriptor to look at anymore
+	if (shardIndex(slot.frameNo) >= shard.numFrames)
+		return false;
+
+	BufDesc & desc = bufDescTable[slot.frameNo];
+	if (!desc.valid || desc.file != slot.file || desc.pageNo != slot.pageNo ||
+	    desc.pinCnt > 0 || desc.cleaning || desc.loading)
+		return false;
+
+	if (desc.dirty)
+	{
+		desc.file->writePage(desc.pageNo, bufPool[slot.frameNo]);
+		tally(shard, desc.file, &BufCounters::dirtyEvictions);
+		tally(shard, desc.file, &BufCounters::diskwrites);
+	}
+	tally(shard, desc.file, &BufCounters::evictions);
+	unmapPage(shard, slot.frameNo);
+	desc.Clear();
+	return true;
+}
+
+bool BufMgr::recycleRingFrame(BufShard & shard, BufRing & ring, FrameId & frame)
 {
-  // check to see if it is already in the buffer pool
+	std::deque<RingSlot> & slots = ringSlots(ring, shard);
+	if (slots.size() < ringCapacity(ring))
+		return false;
+
+	RingSlot oldest = slots.front();
+	slots.pop_front();
+	if (!evictRingFrame(shard, oldest))
+		return false;
+
+	shard.policy->frameReused(shardIndex(oldest.frameNo));
+	frame = oldest.frameNo;
+	return true;
+}
+
+void BufMgr::addToRing(BufShard & shard, BufRing & ring, const FrameId frameNo)
+{
+	std::deque<RingSlot> & slots = ringSlots(ring, shard);
+	RingSlot slot = {frameNo, bufDescTable[frameNo].file, bufDescTable[frameNo].pageNo};
+	slots.push_back(slot);
+
+	if (slots.size() > ringCapacity(ring))
+	{
+		// the caller has the new page pinned already; if the oldest page cannot be written out, it stays
+		// in the pool and in the ring, to be tried again when the next page is added
+		try
+		{
+			if (evictRingFrame(shard, slots.front()))
+				releaseFrame(shard, slots.front().frameNo);
+		}
+		catch (...)
+		{
+			return;
+		}
+		slots.pop_front();
+	}
+}
+
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page, BufRing* ring)
+{
+  BufShard & shard = shardOf(file, pageNo);
+  std::unique_lock<std::mutex> lock(shard.latch);
+
+  // check to see if it is already in the buffer pool, waiting for the page if it is being read ahead
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
   FrameId frameNo = 0;
-	try
+  tally(shard, file, &BufCounters::accesses);
+  recordAccess(shard, TRACE_READ, file, pageNo);
+  const std::chrono::steady_clock::time_point missStart = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point deadline;
+  bool found;
+  bool waited = false;
+  while (true)
+  {
+    while ((found = shard.hashTable->lookup(file, pageNo, frameNo)) && bufDescTable[frameNo].loading)
+    {
+      waited = true;
+      shard.ioDone.wait(lock);
+    }
+    if (found)
+      break;
+
+    // alloc a new frame, reusing the oldest frame of the scan's ring if it can; if every frame is pinned, wait
+    // for one to be unpinned, then look for the page again since it may have been read in meanwhile
+    if (ring != NULL && recycleRingFrame(shard, *ring, frameNo))
+      break;
+    if (tryAllocBuf(shard, lock, file, pageNo, frameNo))
+    {
+      // so may it while a dirty victim was written out
+      FrameId loadedFrameNo;
+      if (!shard.hashTable->lookup(file, pageNo, loadedFrameNo))
+        break;
+      releaseFrame(shard, frameNo);
+      continue;
+    }
+    if (!waitForFrame(shard, lock, file, deadline))
+      throw BufferExceededException();
+  }
+  if (waited)
+    tally(shard, file, &BufCounters::pinWaits);
+
+  // misses and first uses of pages read ahead drive sequential readahead
+  bool sequential = !found;
+	if (found)
 	{
-  	hashTable->lookup(file, pageNo, frameNo);
+    tally(shard, file, &BufCounters::hits);
 
     // set the referenced bit
     bufDescTable[frameNo].refbit = true;
     bufDescTable[frameNo].pinCnt++;
+    if (shardIndex(frameNo) < shard.numFrames)
+      shard.policy->pageAccessed(shardIndex(frameNo));
     page = &bufPool[frameNo];
+
+    sequential = bufDescTable[frameNo].prefetched;
+    bufDescTable[frameNo].prefetched = false;
+
+    // a page read ahead for a scan is the scan's to recycle
+    if (ring != NULL && sequential)
+      addToRing(shard, *ring, frameNo);
   }
-  catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
+  else //not in the buffer pool, must allocate a new page
   {
-    // alloc a new frame
-    allocBuf(frameNo);
+    tally(shard, file, &BufCounters::misses);
 
-    // read the page into the new frame
-    bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
+    // publish the frame before reading, pinned for the caller; readers of the page wait for the read
+    BufDesc & desc = bufDescTable[frameNo];
+    desc.Set(file, pageNo);
+    desc.loading = true;
+    shard.policy->pageLoaded(shardIndex(frameNo), file, pageNo);
+    mapPage(shard, frameNo);
+    tally(shard, file, &BufCounters::diskreads);
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
+    // read the page into the new frame without the latch, giving the frame back if that fails
+    lock.unlock();
+    try
+    {
+      file->readPageInto(pageNo, bufPool[frameNo]);
+    }
+    catch (...)
+    {
+      lock.lock();
+      unmapPage(shard, frameNo);
+      releaseFrame(shard, frameNo);
+      desc.Clear();
+      shard.ioDone.notify_all();
+      throw;
+    }
+    lock.lock();
+    desc.loading = false;
+    shard.ioDone.notify_all();
     page = &bufPool[frameNo];
+    shard.bufStats.missLatency.record(nanosSince(missStart));
+
+    if (ring != NULL)
+      addToRing(shard, *ring, frameNo);
+  }
 
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+  if (sequential)
+  {
+    lock.unlock();
+    noteSequential(file, pageNo);
   }
 }
 
@@ -154,9 +510,13 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 void BufMgr::unPinPage(File* file, const PageId pageNo, 
 			     const bool dirty) 
 {
-  // lookup in hashtable
+  BufShard & shard = shardOf(file, pageNo);
+  std::lock_guard<std::mutex> guard(shard.latch);
+
+  // lookup in hashtable, the page has to be in the pool to be pinned
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  if (!shard.hashTable->lookup(file, pageNo, frameNo))
+  	throw HashNotFoundException(file->filename(), pageNo);
 
   if (dirty == true) bufDescTable[frameNo].dirty = dirty;
 
@@ -166,44 +526,380 @@ void BufMgr::unPinPage(File* file, const PageId pageNo,
   	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
   }
   else bufDescTable[frameNo].pinCnt--;
+
+  // a shrinking pool waits for the pages left in frames it gives up to be unpinned, as do threads needing a frame
+  if (bufDescTable[frameNo].pinCnt == 0 && (shardIndex(frameNo) >= shard.numFrames || shard.frameWaiters > 0))
+  	shard.ioDone.notify_all();
+}
+
+void BufMgr::groupBatch(const File* file, const PageId* pageNos, const std::uint32_t count,
+                        std::vector<BatchRequest> & requests, std::vector<std::uint32_t> & shardStarts)
+{
+	requests.resize(count);
+	shardStarts.assign(numShards + 1, 0);
+	if (numShards == 1)
+	{
+		for (std::uint32_t i = 0; i < count; i++)
+		{
+			requests[i].pageNo = pageNos[i];
+			requests[i].index = i;
+		}
+		shardStarts[1] = count;
+		return;
+	}
+
+	// count the pages of each shard, then place every page behind those of the shards before its own
+	std::vector<std::uint32_t> shardNos(count);
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		shardNos[i] = shardOf(file, pageNos[i]).shardNo;
+		shardStarts[shardNos[i] + 1]++;
+	}
+	for (std::uint32_t s = 1; s <= numShards; s++)
+		shardStarts[s] += shardStarts[s - 1];
+
+	std::vector<std::uint32_t> next(shardStarts.begin(), shardStarts.end() - 1);
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		BatchRequest & request = requests[next[shardNos[i]]++];
+		request.pageNo = pageNos[i];
+		request.index = i;
+	}
+}
+
+void BufMgr::readPages(File* file, const PageId* pageNos, const std::uint32_t count, Page** pages)
+{
+	std::vector<BatchRequest> requests;
+	std::vector<std::uint32_t> shardStarts;
+	groupBatch(file, pageNos, count, requests, shardStarts);
+
+	// shards are visited in order, requests[0, done) have been looked at; the pages of held are pinned, once
+	// for each time they are asked for
+	std::uint32_t done = 0;
+	std::vector<PageId> held;
+	try
+	{
+		for (std::uint32_t s = 0; s < numShards; s++)
+		{
+			const std::uint32_t shardEnd = shardStarts[s + 1];
+			if (done == shardEnd)
+				continue;
+
+			// in page order, a page asked for more than once comes up once and misses are read in file order
+			std::sort(requests.begin() + done, requests.begin() + shardEnd);
+
+			// first give every page missing from the shard a frame, published as loading so that other
+			// readers of the pages wait for them
+			BufShard & shard = shards[s];
+			std::unique_lock<std::mutex> lock(shard.latch);
+			const std::chrono::steady_clock::time_point missStart = std::chrono::steady_clock::now();
+			std::vector<FrameId> loads;
+			std::vector<std::uint32_t> loadTimes;
+			try
+			{
+				while (done < shardEnd)
+				{
+					const PageId pageNo = requests[done].pageNo;
+					std::uint32_t end = done + 1;
+					while (end < shardEnd && requests[end].pageNo == pageNo)
+						end++;
+					const std::uint32_t times = end - done;
+
+					// same as readPage(), with one lookup and one pin count update for all the times the page is asked for
+					FrameId frameNo = 0;
+					tally(shard, file, &BufCounters::accesses, times);
+					for (std::uint32_t n = 0; n < times; n++)
+						recordAccess(shard, TRACE_READ, file, pageNo);
+					std::chrono::steady_clock::time_point deadline;
+					bool found;
+					bool waited = false;
+					while (true)
+					{
+						while ((found = shard.hashTable->lookup(file, pageNo, frameNo)) && bufDescTable[frameNo].loading)
+						{
+							waited = true;
+							shard.ioDone.wait(lock);
+						}
+						if (found)
+							break;
+						if (tryAllocBuf(shard, lock, file, pageNo, frameNo))
+						{
+							// the page may have been read in while a dirty victim was written out
+							FrameId loadedFrameNo;
+							if (!shard.hashTable->lookup(file, pageNo, loadedFrameNo))
+								break;
+							releaseFrame(shard, frameNo);
+							continue;
+						}
+						if (!waitForFrame(shard, lock, file, deadline))
+							throw BufferExceededException();
+					}
+					if (waited)
+						tally(shard, file, &BufCounters::pinWaits);
+
+					// once read in, the page is there for the other times it is asked for
+					tally(shard, file, &BufCounters::hits, found ? times : times - 1);
+					if (found)
+					{
+						bufDescTable[frameNo].refbit = true;
+						bufDescTable[frameNo].pinCnt += times;
+						if (shardIndex(frameNo) < shard.numFrames)
+							shard.policy->pageAccessed(shardIndex(frameNo));
+						bufDescTable[frameNo].prefetched = false;
+						held.insert(held.end(), times, pageNo);
+					}
+					else
+					{
+						tally(shard, file, &BufCounters::misses);
+						tally(shard, file, &BufCounters::diskreads);
+						BufDesc & desc = bufDescTable[frameNo];
+						desc.Set(file, pageNo);
+						desc.pinCnt = times;
+						desc.loading = true;
+						shard.policy->pageLoaded(shardIndex(frameNo), file, pageNo);
+						mapPage(shard, frameNo);
+						loads.push_back(frameNo);
+						loadTimes.push_back(times);
+					}
+
+					for (; done < end; done++)
+						pages[requests[done].index] = &bufPool[frameNo];
+				}
+			}
+			catch (...)
+			{
+				abandonLoads(shard, loads);
+				throw;
+			}
+			if (loads.empty())
+				continue;
+
+			// then read them without the latch, each run of consecutive pages at once
+			lock.unlock();
+			std::vector<bool> loaded(loads.size(), false);
+			std::exception_ptr error;
+			std::vector<Page*> run;
+			for (std::size_t first = 0, last; first < loads.size() && !error; first = last)
+			{
+				const PageId firstPageNo = bufDescTable[loads[first]].pageNo;
+				run.clear();
+				for (last = first; last < loads.size() && bufDescTable[loads[last]].pageNo == firstPageNo + (last - first);
+				     last++)
+					run.push_back(&bufPool[loads[last]]);
+				try
+				{
+					file->readPagesInto(firstPageNo, &run[0], run.size());
+					std::fill(loaded.begin() + first, loaded.begin() + last, true);
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+			}
+
+			// and finally make the pages read available, giving back the frames of those that could not be read
+			lock.lock();
+			std::vector<FrameId> failed;
+			for (std::size_t n = 0; n < loads.size(); n++)
+			{
+				if (!loaded[n])
+				{
+					failed.push_back(loads[n]);
+					continue;
+				}
+				bufDescTable[loads[n]].loading = false;
+				held.insert(held.end(), loadTimes[n], bufDescTable[loads[n]].pageNo);
+				shard.bufStats.missLatency.record(nanosSince(missStart));
+			}
+			abandonLoads(shard, failed);
+			if (error)
+				std::rethrow_exception(error);
+		}
+	}
+	catch (...)
+	{
+		// give back the pins taken so far
+		if (!held.empty())
+			unPinPages(file, &held[0], held.size(), false);
+		throw;
+	}
+}
+
+void BufMgr::abandonLoads(BufShard & shard, const std::vector<FrameId> & frames)
+{
+	for (std::size_t n = 0; n < frames.size(); n++)
+	{
+		unmapPage(shard, frames[n]);
+		releaseFrame(shard, frames[n]);
+		bufDescTable[frames[n]].Clear();
+	}
+	shard.ioDone.notify_all();
+}
+
+void BufMgr::unPinPages(File* file, const PageId* pageNos, const std::uint32_t count, const bool dirty)
+{
+	std::vector<BatchRequest> requests;
+	std::vector<std::uint32_t> shardStarts;
+	groupBatch(file, pageNos, count, requests, shardStarts);
+
+	std::exception_ptr error;
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		if (shardStarts[s] == shardStarts[s + 1])
+			continue;
+
+		BufShard & shard = shards[s];
+		std::lock_guard<std::mutex> guard(shard.latch);
+		for (std::uint32_t i = shardStarts[s]; i < shardStarts[s + 1]; i++)
+		{
+			const PageId pageNo = requests[i].pageNo;
+			FrameId frameNo = 0;
+			if (!shard.hashTable->lookup(file, pageNo, frameNo))
+			{
+				if (!error)
+					error = std::make_exception_ptr(HashNotFoundException(file->filename(), pageNo));
+				continue;
+			}
+
+			if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+
+			if (bufDescTable[frameNo].pinCnt == 0)
+			{
+				if (!error)
+					error = std::make_exception_ptr(PageNotPinnedException(file->filename(), pageNo, frameNo));
+				continue;
+			}
+			bufDescTable[frameNo].pinCnt--;
+
+			if (bufDescTable[frameNo].pinCnt == 0 && (shardIndex(frameNo) >= shard.numFrames || shard.frameWaiters > 0))
+				shard.ioDone.notify_all();
+		}
+	}
+
+	if (error)
+		std::rethrow_exception(error);
 }
 
 void BufMgr::flushFile(const File* file) 
 {
-  for (std::uint32_t i = 0; i < numBufs; i++)
+	cancelPrefetch(file);
+
+	// write the dirty pages of the file in runs of consecutive pages first, keeping them pinned meanwhile like
+	// the background writer does; whatever this leaves dirty is written page by page below
+	std::vector<FrameId> dirtyFrames;
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		BufShard & shard = shards[s];
+		std::lock_guard<std::mutex> guard(shard.latch);
+
+		BufShard::FileFrameMap::iterator head = shard.fileFrames.find(file);
+		if (head == shard.fileFrames.end())
+			continue;
+		for (FrameId i = head->second; i != BufDesc::NO_FRAME; i = bufDescTable[i].fileNext)
+		{
+			BufDesc & desc = bufDescTable[i];
+			if (desc.valid && desc.dirty && desc.pinCnt == 0 && !desc.cleaning && !desc.loading)
+			{
+				desc.cleaning = true;
+				desc.pinCnt++;
+				desc.dirty = false;
+				dirtyFrames.push_back(i);
+			}
+		}
+	}
+
+	if (!dirtyFrames.empty())
 	{
-  	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->valid == true && tmpbuf->file == file)
+		std::vector<bool> failed;
+		writeFrames(dirtyFrames, failed);
+
+		for (std::uint32_t s = 0; s < numShards; s++)
+		{
+			BufShard & shard = shards[s];
+			std::lock_guard<std::mutex> guard(shard.latch);
+			for (std::size_t n = 0; n < dirtyFrames.size(); n++)
+			{
+				if (dirtyFrames[n] % numShards != s)
+					continue;
+
+				BufDesc & desc = bufDescTable[dirtyFrames[n]];
+				if (failed[n])
+					desc.dirty = true;
+				else
+					tally(shard, desc.file, &BufCounters::diskwrites);
+				desc.pinCnt--;
+				desc.cleaning = false;
+			}
+			shard.ioDone.notify_all();
+		}
+	}
+
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		BufShard & shard = shards[s];
+		std::unique_lock<std::mutex> lock(shard.latch);
+
+		// only visit the file's own frames, always taking the first one left on its list
+		BufShard::FileFrameMap::iterator head;
+		while ((head = shard.fileFrames.find(file)) != shard.fileFrames.end())
 		{
-	    if (tmpbuf->pinCnt > 0)
-  			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+			FrameId frameNo = head->second;
+			BufDesc* tmpbuf = &(bufDescTable[frameNo]);
+			if (tmpbuf->cleaning || tmpbuf->loading)
+			{
+				// the latch is released while waiting, start over from the list head
+				waitForIO(shard, lock, frameNo);
+				continue;
+			}
 
-	    if (tmpbuf->dirty == true)
+			if (tmpbuf->valid == false)
+				throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+
+			if (tmpbuf->pinCnt > 0)
+				throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+
+			if (tmpbuf->dirty == true)
 			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+				tally(shard, file, &BufCounters::diskwrites);
+				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[frameNo]);
 				tmpbuf->dirty = false;
-    	}
+			}
 
-    	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
-  	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
-  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
-  }
+			unmapPage(shard, frameNo);
+			tmpbuf->Clear();
+			releaseFrame(shard, frameNo);
+		}
+
+		// the File object may go away once flushed; another one could then take its address
+		shard.fileCounters.erase(file);
+		if (shard.lastFile == file)
+			shard.lastFile = NULL;
+		shard.traceFileIds.erase(file);
+	}
 }
 
 void BufMgr::disposePage(File* file, const PageId pageNo) 
 {
-	//Deallocate from file altogether
-  //See if it is in the buffer pool
-  FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+	{
+		BufShard & shard = shardOf(file, pageNo);
+		std::unique_lock<std::mutex> lock(shard.latch);
 
-	// clear the page
-	bufDescTable[frameNo].Clear();
+		//Deallocate from file altogether
+		//See if it is in the buffer pool, if so free its frame once no write or read ahead of it is in progress
+		FrameId frameNo = 0;
+		bool found;
+		while ((found = shard.hashTable->lookup(file, pageNo, frameNo)) && (bufDescTable[frameNo].cleaning || bufDescTable[frameNo].loading))
+			waitForIO(shard, lock, frameNo);
+		recordAccess(shard, TRACE_DISPOSE, file, pageNo);
 
-	hashTable->remove(file, pageNo);
+		if (found)
+		{
+			// clear the page
+			unmapPage(shard, frameNo);
+			bufDescTable[frameNo].Clear();
+			releaseFrame(shard, frameNo);
+		}
+	}
 
   // deallocate it in the file	
   file->deletePage(pageNo);
@@ -212,21 +908,70 @@ void BufMgr::disposePage(File* file, const PageId pageNo)
 
 void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
 {
+  // allocate a new page in the file, its number decides which shard gets it
+  Page newPage = file->allocatePage(pageNo);
+
+  BufShard & shard = shardOf(file, pageNo);
+  std::unique_lock<std::mutex> lock(shard.latch);
+
   FrameId frameNo;
 
-  // alloc a new frame
-  allocBuf(frameNo);
+  // alloc a new frame, waiting for one to be unpinned if every frame is pinned
+  tally(shard, file, &BufCounters::accesses);
+  tally(shard, file, &BufCounters::misses);
+  recordAccess(shard, TRACE_ALLOC, file, pageNo);
+  std::chrono::steady_clock::time_point deadline;
+  while (!tryAllocBuf(shard, lock, file, pageNo, frameNo))
+  {
+    if (!waitForFrame(shard, lock, file, deadline))
+    {
+      // nobody else knows the number of the new page, so hand it back to the file
+      lock.unlock();
+      try
+      {
+        file->deletePage(pageNo);
+      }
+      catch (const InvalidPageException &)
+      {
+        // blob files cannot delete pages, but keep no list of them that the page would linger on
+      }
+      throw BufferExceededException();
+    }
+  }
 
-  // allocate a new page in the file
-	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
+  bufPool[frameNo] = newPage;
   page = &bufPool[frameNo];
 
   // set up the entry properly
   bufDescTable[frameNo].Set(file, pageNo);
+  shard.policy->pageLoaded(shardIndex(frameNo), file, pageNo);
 
   // insert in the hash table
-  hashTable->insert(file, pageNo, frameNo);
+  mapPage(shard, frameNo);
+}
+
+RecordId BufMgr::insertRecord(PageFile* file, const std::string & record_data)
+{
+	while (true)
+	{
+		PageId pageNo = file->findPageWithSpace(record_data.length());
+		const bool allocated = pageNo == Page::INVALID_NUMBER;
+		WritePageGuard guard;
+		if (allocated)
+			guard = WritePageGuard::allocate(this, file, pageNo);
+		else
+			guard = WritePageGuard(this, file, pageNo);
+
+		// the map is only a hint, a page it points to may have filled up since; a new page has to take the record
+		Page* page = guard.getPage();
+		const bool fits = allocated || page->hasSpaceForRecord(record_data);
+		RecordId rid = {pageNo, Page::INVALID_SLOT};
+		if (fits)
+			rid = page->insertRecord(record_data);
+		file->setFreeSpace(pageNo, page->getFreeSpace());
+		if (fits)
+			return rid;
+	}
 }
 
 void BufMgr::printSelf(void) 
@@ -247,4 +992,1172 @@ void BufMgr::printSelf(void)
 	std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
 }
 
+void BufMgr::startBgWriter(const double cleanRatio, const std::uint32_t pagesPerRound,
+                           const std::uint32_t intervalMs)
+{
+	stopBgWriter();
+
+	bgCleanRatio = cleanRatio;
+	bgPagesPerRound = pagesPerRound;
+	bgRoundInterval = intervalMs;
+	bgWriterStop = false;
+	bgWriter = std::thread(&BufMgr::bgWriterLoop, this);
+}
+
+void BufMgr::stopBgWriter()
+{
+	if (!bgWriter.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(bgWriterLatch);
+		bgWriterStop = true;
+	}
+	bgWriterWake.notify_all();
+	bgWriter.join();
+}
+
+void BufMgr::bgWriterLoop()
+{
+	std::uint32_t firstShard = 0;
+	std::unique_lock<std::mutex> lock(bgWriterLatch);
+
+	while (!bgWriterStop)
+	{
+		const std::uint32_t budget = bgPagesPerRound;
+		lock.unlock();
+
+		// start each round at a different shard so a small budget is shared fairly
+		std::uint32_t written = 0;
+		for (std::uint32_t n = 0; n < numShards && written < budget; n++)
+			written += cleanShard(shards[(firstShard + n) % numShards], budget - written);
+		firstShard = (firstShard + 1) % numShards;
+
+		lock.lock();
+		bgWriterWake.wait_for(lock, std::chrono::milliseconds(bgRoundInterval));
+	}
+}
+
+std::uint32_t BufMgr::cleanShard(BufShard & shard, const std::uint32_t budget)
+{
+	std::unique_lock<std::mutex> lock(shard.latch);
+
+	// look at as many upcoming victims as the share of frames to keep clean,
+	// and pick the dirty ones nobody is using
+	std::vector<std::uint32_t> candidates;
+	shard.policy->upcomingVictims(bufDescTable, (std::uint32_t) (bgCleanRatio * shard.numFrames), candidates);
+
+	std::vector<FrameId> batch;
+	for (std::size_t n = 0; n < candidates.size() && batch.size() < budget; n++)
+	{
+		FrameId frameNo = shardFrame(shard, candidates[n]);
+		BufDesc & desc = bufDescTable[frameNo];
+		if (desc.valid && desc.dirty && desc.pinCnt == 0 && !desc.cleaning)
+		{
+			// keep the frame pinned while writing it without the latch; whoever
+			// modifies it meanwhile marks it dirty again when unpinning
+			desc.cleaning = true;
+			desc.pinCnt++;
+			desc.dirty = false;
+			batch.push_back(frameNo);
+		}
+	}
+
+	if (batch.empty())
+		return 0;
+
+	lock.unlock();
+	std::vector<bool> failed;
+	writeFrames(batch, failed);
+	lock.lock();
+
+	std::uint32_t written = 0;
+	for (std::size_t n = 0; n < batch.size(); n++)
+	{
+		BufDesc & desc = bufDescTable[batch[n]];
+		if (failed[n])
+			desc.dirty = true;
+		else
+		{
+			tally(shard, desc.file, &BufCounters::diskwrites);
+			written++;
+		}
+		desc.pinCnt--;
+		desc.cleaning = false;
+	}
+	shard.ioDone.notify_all();
+
+	return written;
+}
+
+void BufMgr::writeFrames(std::vector<FrameId> & frames, std::vector<bool> & failed)
+{
+	std::vector<std::pair<std::pair<File*, PageId>, FrameId> > pages(frames.size());
+	for (std::size_t n = 0; n < frames.size(); n++)
+		pages[n] = std::make_pair(std::make_pair(bufDescTable[frames[n]].file, bufDescTable[frames[n]].pageNo), frames[n]);
+	std::sort(pages.begin(), pages.end());
+	for (std::size_t n = 0; n < frames.size(); n++)
+		frames[n] = pages[n].second;
+	failed.assign(frames.size(), false);
+
+	std::vector<const Page*> run;
+	for (std::size_t first = 0; first < pages.size(); first += run.size())
+	{
+		File* file = pages[first].first.first;
+		const PageId firstPageNo = pages[first].first.second;
+
+		run.clear();
+		while (first + run.size() < pages.size() && run.size() < MAX_WRITE_RUN &&
+		       pages[first + run.size()].first == std::make_pair(file, (PageId) (firstPageNo + run.size())))
+			run.push_back(&bufPool[pages[first + run.size()].second]);
+
+		try
+		{
+			file->writePages(firstPageNo, &run[0], run.size());
+		}
+		catch (...)
+		{
+			for (std::size_t n = 0; n < run.size(); n++)
+				failed[first + n] = true;
+		}
+	}
+}
+
+void BufMgr::prefetchPages(File* file, const PageId firstPageNo, const std::uint32_t count)
+{
+	std::vector<PageId> pageNos;
+	pageNos.reserve(count);
+	for (std::uint32_t n = 0; n < count; n++)
+		pageNos.push_back(firstPageNo + n);
+
+	std::lock_guard<std::mutex> guard(raLatch);
+	queuePrefetch(file, pageNos, false);
+}
+
+void BufMgr::prefetchPages(File* file, const std::vector<PageId> & pageNos)
+{
+	std::vector<PageId> copy(pageNos);
+
+	std::lock_guard<std::mutex> guard(raLatch);
+	queuePrefetch(file, copy, false);
+}
+
+void BufMgr::setReadahead(const std::uint32_t window)
+{
+	std::lock_guard<std::mutex> guard(raLatch);
+	raWindow = window < numBufs / 4 ? window : numBufs / 4;
+}
+
+void BufMgr::queuePrefetch(File* file, std::vector<PageId> & pageNos, const bool sequential)
+{
+	// caller holds raLatch
+	if (pageNos.empty() || raStop || raQueue.size() >= MAX_PREFETCH_REQUESTS)
+		return;
+
+	if (!raWorker.joinable())
+		raWorker = std::thread(&BufMgr::readaheadLoop, this);
+
+	raQueue.push_back(PrefetchRequest());
+	raQueue.back().file = file;
+	raQueue.back().pageNos.swap(pageNos);
+	raQueue.back().sequential = sequential;
+	raWake.notify_one();
+}
+
+void BufMgr::noteSequential(File* file, const PageId pageNo)
+{
+	std::lock_guard<std::mutex> guard(raLatch);
+	if (raWindow == 0)
+		return;
+
+	ReadaheadStream & stream = raStreams[streamOf(file)];
+	if (stream.file != file || pageNo != stream.lastPageNo + 1)
+	{
+		// not (yet) a scan, remember where it would continue
+		stream.file = file;
+		stream.lastPageNo = pageNo;
+		stream.aheadUntil = pageNo + 1;
+		return;
+	}
+	stream.lastPageNo = pageNo;
+
+	// ask for the next window once the scan is half way through the pages already requested
+	if (pageNo + raWindow / 2 + 1 < stream.aheadUntil)
+		return;
+
+	PageId first = stream.aheadUntil > pageNo + 1 ? stream.aheadUntil : pageNo + 1;
+	stream.aheadUntil = pageNo + 1 + raWindow;
+	if (first >= stream.aheadUntil)
+		return;
+
+	std::vector<PageId> pageNos;
+	for (PageId next = first; next < stream.aheadUntil; next++)
+		pageNos.push_back(next);
+	queuePrefetch(file, pageNos, true);
+}
+
+void BufMgr::cancelPrefetch(const File* file)
+{
+	std::unique_lock<std::mutex> lock(raLatch);
+
+	for (std::deque<PrefetchRequest>::iterator it = raQueue.begin(); it != raQueue.end(); )
+	{
+		if (it->file == file)
+			it = raQueue.erase(it);
+		else
+			++it;
+	}
+
+	for (std::uint32_t n = 0; n < READAHEAD_STREAMS; n++)
+	{
+		if (raStreams[n].file == file)
+			raStreams[n] = ReadaheadStream();
+	}
+
+	while (raCurrentFile == file)
+		raIdle.wait(lock);
+}
+
+void BufMgr::stopReadahead()
+{
+	{
+		std::lock_guard<std::mutex> guard(raLatch);
+		raStop = true;
+		raQueue.clear();
+	}
+	raWake.notify_all();
+
+	if (raWorker.joinable())
+		raWorker.join();
+}
+
+void BufMgr::readaheadLoop()
+{
+	std::unique_lock<std::mutex> lock(raLatch);
+
+	while (true)
+	{
+		while (!raStop && raQueue.empty())
+			raWake.wait(lock);
+		if (raStop)
+			break;
+
+		PrefetchRequest request;
+		request.file = raQueue.front().file;
+		request.pageNos.swap(raQueue.front().pageNos);
+		request.sequential = raQueue.front().sequential;
+		raQueue.pop_front();
+		raCurrentFile = request.file;
+
+		const ReadaheadStream & stream = raStreams[streamOf(request.file)];
+		for (std::size_t n = 0; n < request.pageNos.size(); n++)
+		{
+			// when falling behind a scan, don't load pages it has read itself already
+			if (request.sequential && stream.file == request.file && stream.lastPageNo >= request.pageNos[n])
+				continue;
+
+			lock.unlock();
+			bool loaded = prefetchPage(request.file, request.pageNos[n]);
+			lock.lock();
+			if (!loaded)
+				break;
+		}
+
+		raCurrentFile = NULL;
+		raIdle.notify_all();
+	}
+}
+
+bool BufMgr::prefetchPage(File* file, const PageId pageNo)
+{
+	BufShard & shard = shardOf(file, pageNo);
+	std::unique_lock<std::mutex> lock(shard.latch);
+
+	FrameId frameNo = 0;
+	if (shard.hashTable->lookup(file, pageNo, frameNo))
+		return true;
+
+	try
+	{
+		allocBuf(shard, lock, file, pageNo, frameNo);
+	}
+	catch (...)
+	{
+		return false;
+	}
+
+	// the page may have been read in while a dirty victim was written out
+	FrameId loadedFrameNo;
+	if (shard.hashTable->lookup(file, pageNo, loadedFrameNo))
+	{
+		releaseFrame(shard, frameNo);
+		return true;
+	}
+
+	// publish the frame before reading, pinned so that it is neither evicted nor written meanwhile
+	BufDesc & desc = bufDescTable[frameNo];
+	desc.Set(file, pageNo);
+	desc.loading = true;
+	shard.policy->pageLoaded(shardIndex(frameNo), file, pageNo);
+	mapPage(shard, frameNo);
+	lock.unlock();
+
+	bool loaded = true;
+	try
+	{
+		file->readPageInto(pageNo, bufPool[frameNo]);
+	}
+	catch (...)
+	{
+		loaded = false;
+	}
+
+	lock.lock();
+	desc.loading = false;
+	if (loaded)
+	{
+		desc.pinCnt--;
+		desc.prefetched = true;
+		tally(shard, file, &BufCounters::diskreads);
+	}
+	else
+	{
+		unmapPage(shard, frameNo);
+		releaseFrame(shard, frameNo);
+		desc.Clear();
+	}
+	shard.ioDone.notify_all();
+
+	return loaded;
+}
+
+/**
+* Fulfils the promise behind the future returned by BufMgr::readPageAsync(File*, const PageId)
+*/
+struct PromiseCallback
+{
+	std::shared_ptr<std::promise<Page*> > promise;
+
+	void operator()(Page* page, std::exception_ptr error) const
+	{
+		if (error)
+			promise->set_exception(error);
+		else
+			promise->set_value(page);
+	}
+};
+
+void BufMgr::readPageAsync(File* file, const PageId pageNo, const ReadCallback & callback)
+{
+	BufShard & shard = shardOf(file, pageNo);
+	std::unique_lock<std::mutex> lock(shard.latch);
+
+	FrameId frameNo = 0;
+	tally(shard, file, &BufCounters::accesses);
+	recordAccess(shard, TRACE_READ, file, pageNo);
+	bool found;
+	bool waited = false;
+	FrameId newFrameNo = 0;
+	bool allocated = false;
+	while (true)
+	{
+		while ((found = shard.hashTable->lookup(file, pageNo, frameNo)) && bufDescTable[frameNo].loading)
+		{
+			// join a read the I/O threads have in flight; one of the readahead thread is waited for, as in readPage()
+			std::unordered_map<FrameId, std::vector<ReadCallback> >::iterator waiters = shard.asyncWaiters.find(frameNo);
+			if (waiters != shard.asyncWaiters.end())
+			{
+				if (allocated)
+					releaseFrame(shard, newFrameNo);
+				bufDescTable[frameNo].refbit = true;
+				bufDescTable[frameNo].pinCnt++;
+				if (shardIndex(frameNo) < shard.numFrames)
+					shard.policy->pageAccessed(shardIndex(frameNo));
+				waiters->second.push_back(callback);
+				tally(shard, file, &BufCounters::hits);
+				return;
+			}
+			waited = true;
+			shard.ioDone.wait(lock);
+		}
+		if (found || allocated)
+			break;
+
+		try
+		{
+			allocBuf(shard, lock, file, pageNo, newFrameNo);
+		}
+		catch (...)
+		{
+			lock.unlock();
+			callback(NULL, std::current_exception());
+			return;
+		}
+
+		// look again, the page may have been read in while a dirty victim was written out
+		allocated = true;
+	}
+	if (waited)
+		tally(shard, file, &BufCounters::pinWaits);
+
+	if (found)
+	{
+		if (allocated)
+			releaseFrame(shard, newFrameNo);
+		tally(shard, file, &BufCounters::hits);
+		bufDescTable[frameNo].refbit = true;
+		bufDescTable[frameNo].pinCnt++;
+		if (shardIndex(frameNo) < shard.numFrames)
+			shard.policy->pageAccessed(shardIndex(frameNo));
+		bufDescTable[frameNo].prefetched = false;
+		lock.unlock();
+
+		callback(&bufPool[frameNo], std::exception_ptr());
+		return;
+	}
+
+	tally(shard, file, &BufCounters::misses);
+	frameNo = newFrameNo;
+
+	// publish the frame before reading, pinned for the caller; readers of the page wait for the read
+	BufDesc & desc = bufDescTable[frameNo];
+	desc.Set(file, pageNo);
+	desc.loading = true;
+	shard.policy->pageLoaded(shardIndex(frameNo), file, pageNo);
+	mapPage(shard, frameNo);
+	shard.asyncWaiters[frameNo].push_back(callback);
+	lock.unlock();
+
+	AsyncRead read = {file, pageNo, frameNo};
+	std::lock_guard<std::mutex> guard(ioLatch);
+	if (ioWorkers.empty())
+	{
+		for (std::uint32_t n = 0; n < IO_THREADS; n++)
+			ioWorkers.push_back(std::thread(&BufMgr::ioLoop, this));
+	}
+	ioQueue.push_back(read);
+	ioWake.notify_one();
+}
+
+std::future<Page*> BufMgr::readPageAsync(File* file, const PageId pageNo)
+{
+	PromiseCallback callback;
+	callback.promise.reset(new std::promise<Page*>());
+	std::future<Page*> page = callback.promise->get_future();
+
+	readPageAsync(file, pageNo, ReadCallback(callback));
+	return page;
+}
+
+void BufMgr::stopAsyncIO()
+{
+	{
+		std::lock_guard<std::mutex> guard(ioLatch);
+		ioStop = true;
+	}
+	ioWake.notify_all();
+
+	for (std::size_t n = 0; n < ioWorkers.size(); n++)
+		ioWorkers[n].join();
+	ioWorkers.clear();
+}
+
+void BufMgr::ioLoop()
+{
+	std::unique_lock<std::mutex> lock(ioLatch);
+
+	while (true)
+	{
+		while (!ioStop && ioQueue.empty())
+			ioWake.wait(lock);
+		// frames of queued reads are pinned and loading, so the queue is drained even when stopping
+		if (ioQueue.empty())
+			break;
+
+		AsyncRead read = ioQueue.front();
+		ioQueue.pop_front();
+
+		lock.unlock();
+		completeRead(read);
+		lock.lock();
+	}
+}
+
+void BufMgr::completeRead(const AsyncRead & read)
+{
+	std::exception_ptr error;
+	try
+	{
+		read.file->readPageInto(read.pageNo, bufPool[read.frameNo]);
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	BufShard & shard = shardOf(read.file, read.pageNo);
+	std::vector<ReadCallback> callbacks;
+	{
+		std::lock_guard<std::mutex> guard(shard.latch);
+		BufDesc & desc = bufDescTable[read.frameNo];
+		desc.loading = false;
+		callbacks.swap(shard.asyncWaiters[read.frameNo]);
+		shard.asyncWaiters.erase(read.frameNo);
+
+		if (!error)
+		{
+			tally(shard, read.file, &BufCounters::diskreads);
+		}
+		else
+		{
+			unmapPage(shard, read.frameNo);
+			releaseFrame(shard, read.frameNo);
+			desc.Clear();
+		}
+		shard.ioDone.notify_all();
+	}
+
+	Page* page = error ? NULL : &bufPool[read.frameNo];
+	for (std::size_t n = 0; n < callbacks.size(); n++)
+		callbacks[n](page, error);
+}
+
+/**
+* First line of a snapshot file
+*/
+static const char SNAPSHOT_HEADER[] = "badgerdb buffer snapshot 1";
+
+/**
+* A page listed in a snapshot
+*/
+struct SnapshotPage
+{
+	/**
+	 * Rank of the page in its shard divided by the size of the shard, 0 for the hottest page
+	 */
+	double rank;
+
+	std::string filename;
+	PageId pageNo;
+
+	bool operator<(const SnapshotPage & other) const
+	{
+		return rank < other.rank;
+	}
+};
+
+bool BufMgr::saveSnapshot(const std::string & path)
+{
+	std::vector<SnapshotPage> pages;
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		BufShard & shard = shards[s];
+		std::lock_guard<std::mutex> guard(shard.latch);
+
+		// frames the policy does not expect to evict soon are the hottest, the frames it does
+		// get colder towards its next victim
+		std::vector<std::uint32_t> coldest;
+		shard.policy->upcomingVictims(bufDescTable, shard.numFrames, coldest);
+		std::vector<bool> listed(shard.numFrames, false);
+		for (std::size_t n = 0; n < coldest.size(); n++)
+			listed[coldest[n]] = true;
+
+		std::vector<std::uint32_t> ranked;
+		for (std::uint32_t i = 0; i < shard.numFrames; i++)
+		{
+			if (!listed[i])
+				ranked.push_back(i);
+		}
+		ranked.insert(ranked.end(), coldest.rbegin(), coldest.rend());
+
+		for (std::size_t n = 0; n < ranked.size(); n++)
+		{
+			const BufDesc & desc = bufDescTable[shardFrame(shard, ranked[n])];
+			if (!desc.valid || desc.loading)
+				continue;
+
+			SnapshotPage page;
+			page.rank = (double) n / shard.numFrames;
+			page.filename = desc.file->filename();
+			page.pageNo = desc.pageNo;
+			pages.push_back(page);
+		}
+	}
+	std::stable_sort(pages.begin(), pages.end());
+
+	const std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream out(tmpPath.c_str(), std::ofstream::out | std::ofstream::trunc);
+		out << SNAPSHOT_HEADER << "\n";
+		for (std::size_t n = 0; n < pages.size(); n++)
+			out << pages[n].pageNo << " " << pages[n].filename << "\n";
+		out.close();
+		if (!out)
+		{
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+	}
+	return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+std::uint32_t BufMgr::loadSnapshot(const std::string & path, const std::vector<File*> & files)
+{
+	std::ifstream in(path.c_str());
+	std::string line;
+	if (!std::getline(in, line) || line != SNAPSHOT_HEADER)
+		return 0;
+
+	std::map<std::string, File*> filesByName;
+	for (std::size_t n = 0; n < files.size(); n++)
+		filesByName[files[n]->filename()] = files[n];
+
+	// the hottest pages of the files, as many as fit
+	std::vector<std::pair<File*, PageId> > pages;
+	PageId pageNo;
+	while (pages.size() < numBufs && in >> pageNo && in.get() == ' ' && std::getline(in, line))
+	{
+		std::map<std::string, File*>::const_iterator file = filesByName.find(line);
+		if (file != filesByName.end())
+			pages.push_back(std::make_pair(file->second, pageNo));
+	}
+
+	// read each file's pages in physical order, keeping a window of reads in flight
+	std::sort(pages.begin(), pages.end());
+	std::deque<std::future<Page*> > inFlight;
+	std::uint32_t loaded = 0;
+	for (std::size_t next = 0, done = 0; done < pages.size(); )
+	{
+		if (next < pages.size() && inFlight.size() < WARMUP_WINDOW)
+		{
+			inFlight.push_back(readPageAsync(pages[next].first, pages[next].second));
+			next++;
+			continue;
+		}
+
+		try
+		{
+			inFlight.front().get();
+			unPinPage(pages[done].first, pages[done].second, false);
+			loaded++;
+		}
+		catch (...)
+		{
+			// the page is gone or the pool is full of pinned pages, skip it
+		}
+		inFlight.pop_front();
+		done++;
+	}
+
+	return loaded;
+}
+
+void BufMgr::resize(std::uint32_t newBufs)
+{
+	std::lock_guard<std::mutex> guard(resizeLatch);
+
+	// every shard keeps at least one frame
+	if (newBufs < numShards)
+		newBufs = numShards;
+	if ((std::size_t) newBufs * sizeof(Page) > poolArena->capacity() ||
+	    (std::size_t) newBufs * sizeof(BufDesc) > descArena->capacity())
+		throw BufferExceededException();
+
+	const std::uint32_t oldBufs = numBufs;
+	if (newBufs > oldBufs)
+	{
+		// make the new frames exist before any shard can hand them out
+		descArena->resize((std::size_t) newBufs * sizeof(BufDesc));
+		poolArena->resize((std::size_t) newBufs * sizeof(Page));
+		for (FrameId i = oldBufs; i < newBufs; i++)
+		{
+			new (&bufDescTable[i]) BufDesc();
+			bufDescTable[i].frameNo = i;
+			bufDescTable[i].latch.resetVersion(retiredVersion);
+		}
+
+		for (std::uint32_t s = 0; s < numShards; s++)
+		{
+			BufShard & shard = shards[s];
+			std::lock_guard<std::mutex> lock(shard.latch);
+			shard.numFrames = shardFrames(s, newBufs);
+			shard.policy->resize(shard.numFrames);
+			rebuildHashTable(shard);
+		}
+		numBufs = newBufs;
+	}
+	else if (newBufs < oldBufs)
+	{
+		// long-lived pins would keep the frames past the new end busy for good
+		releaseHeldPins();
+
+		numBufs = newBufs;
+		ringGeneration++;
+		for (std::uint32_t s = 0; s < numShards; s++)
+			shrinkShard(shards[s], shardFrames(s, newBufs));
+
+		// frames added later start past every version the frames given up went through
+		for (FrameId i = newBufs; i < oldBufs; i++)
+		{
+			std::uint64_t v = bufDescTable[i].latch.readVersion() + 2;
+			if (v > retiredVersion)
+				retiredVersion = v & ~(std::uint64_t) 1;
+		}
+
+		// nothing refers to the frames past the end anymore, once optimistic readers that
+		// may still be looking at them are gone
+		epochs.synchronize();
+		poolArena->resize((std::size_t) newBufs * sizeof(Page));
+		descArena->resize((std::size_t) newBufs * sizeof(BufDesc));
+	}
+
+	// keep the readahead window within its share of the pool
+	std::lock_guard<std::mutex> raGuard(raLatch);
+	if (raWindow > numBufs / 4)
+		raWindow = numBufs / 4;
+}
+
+void BufMgr::addPinHolder(PinHolder* holder)
+{
+	std::lock_guard<std::mutex> guard(pinHoldersLatch);
+	if (std::find(pinHolders.begin(), pinHolders.end(), holder) == pinHolders.end())
+		pinHolders.push_back(holder);
+}
+
+void BufMgr::removePinHolder(PinHolder* holder)
+{
+	std::lock_guard<std::mutex> guard(pinHoldersLatch);
+	pinHolders.erase(std::remove(pinHolders.begin(), pinHolders.end(), holder), pinHolders.end());
+}
+
+void BufMgr::releaseHeldPins()
+{
+	// holders unpin through this buffer manager, so they are called without the latch held
+	std::vector<PinHolder*> holders;
+	{
+		std::lock_guard<std::mutex> guard(pinHoldersLatch);
+		holders = pinHolders;
+	}
+	for (std::size_t n = 0; n < holders.size(); n++)
+		holders[n]->releasePins();
+}
+
+void BufMgr::shrinkShard(BufShard & shard, const std::uint32_t newFrames)
+{
+	std::unique_lock<std::mutex> lock(shard.latch);
+
+	// stop handing out the frames past the new end, then empty them
+	const std::uint32_t oldFrames = shard.numFrames;
+	shard.numFrames = newFrames;
+	shard.policy->resize(newFrames);
+
+	while (true)
+	{
+		bool busy = false;
+		for (std::uint32_t i = newFrames; i < oldFrames; i++)
+		{
+			FrameId frameNo = shardFrame(shard, i);
+			BufDesc* tmpbuf = &(bufDescTable[frameNo]);
+			if (tmpbuf->valid == false)
+				continue;
+
+			if (tmpbuf->pinCnt > 0 || tmpbuf->cleaning || tmpbuf->loading)
+			{
+				busy = true;
+				continue;
+			}
+
+			if (tmpbuf->dirty == true)
+			{
+				tally(shard, tmpbuf->file, &BufCounters::diskwrites);
+				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[frameNo]);
+			}
+			unmapPage(shard, frameNo);
+			tmpbuf->Clear();
+		}
+
+		if (!busy)
+			break;
+
+		// pinned pages stay where they are until they are unpinned
+		shard.ioDone.wait(lock);
+	}
+
+	rebuildHashTable(shard);
+}
+
+void BufMgr::pinFrame(const FrameId frameNo, Page*& page)
+{
+	BufShard & shard = shards[frameNo % numShards];
+	std::lock_guard<std::mutex> lock(shard.latch);
+
+	tally(shard, bufDescTable[frameNo].file, &BufCounters::accesses);
+	tally(shard, bufDescTable[frameNo].file, &BufCounters::hits);
+	recordAccess(shard, TRACE_READ, bufDescTable[frameNo].file, bufDescTable[frameNo].pageNo);
+	bufDescTable[frameNo].refbit = true;
+	bufDescTable[frameNo].pinCnt++;
+	if (shardIndex(frameNo) < shard.numFrames)
+		shard.policy->pageAccessed(shardIndex(frameNo));
+	page = &bufPool[frameNo];
+}
+
+const Page* BufMgr::readOptimistic(const FrameRef & ref)
+{
+	if (ref.frameNo >= numBufs || bufDescTable[ref.frameNo].latch.readVersion() != ref.version)
+		return NULL;
+	return &bufPool[ref.frameNo];
+}
+
+bool BufMgr::validateOptimistic(const FrameRef & ref)
+{
+	return bufDescTable[ref.frameNo].latch.validate(ref.version);
+}
+
+bool BufMgr::startTrace(const std::string & path)
+{
+	std::lock_guard<std::mutex> control(traceLatch);
+	endTrace();
+
+	TraceWriter* writer = new TraceWriter(path);
+	if (!writer->good())
+	{
+		delete writer;
+		return false;
+	}
+
+	tracer = writer;
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		std::lock_guard<std::mutex> guard(shards[s].latch);
+		shards[s].tracer = writer;
+	}
+	return true;
+}
+
+bool BufMgr::stopTrace()
+{
+	std::lock_guard<std::mutex> control(traceLatch);
+	return endTrace();
+}
+
+bool BufMgr::endTrace()
+{
+	if (tracer == NULL)
+		return true;
+
+	// once every shard has let go of it, nobody else can be using the trace
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		BufShard & shard = shards[s];
+		std::lock_guard<std::mutex> guard(shard.latch);
+		if (!shard.traceBuffer.empty())
+			tracer->write(&shard.traceBuffer[0], shard.traceBuffer.size());
+		std::vector<TraceRecord>().swap(shard.traceBuffer);
+		shard.traceFileIds.clear();
+		shard.tracer = NULL;
+	}
+
+	const bool written = tracer->good();
+	delete tracer;
+	tracer = NULL;
+	return written;
+}
+
+void BufMgr::startMrcSampling(const double rate)
+{
+	std::lock_guard<std::mutex> control(traceLatch);
+	endMrcSampling();
+
+	sampler = new MrcSampler(rate);
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		std::lock_guard<std::mutex> guard(shards[s].latch);
+		shards[s].sampler = sampler;
+		shards[s].sampledAccesses = 0;
+	}
+}
+
+void BufMgr::stopMrcSampling()
+{
+	std::lock_guard<std::mutex> control(traceLatch);
+	endMrcSampling();
+}
+
+void BufMgr::endMrcSampling()
+{
+	if (sampler == NULL)
+		return;
+
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		std::lock_guard<std::mutex> guard(shards[s].latch);
+		shards[s].sampler = NULL;
+	}
+	delete sampler;
+	sampler = NULL;
+}
+
+void BufMgr::traceAccess(BufShard & shard, const TraceOp op, const File* file, const PageId pageNo)
+{
+	if (shard.tracer != NULL)
+	{
+		std::unordered_map<const File*, std::uint32_t>::iterator found = shard.traceFileIds.find(file);
+		const std::uint32_t fileId = found != shard.traceFileIds.end() ? found->second
+		                                                              : (shard.traceFileIds[file] = shard.tracer->fileId(file));
+
+		if (shard.traceBuffer.capacity() < TRACE_BUFFER_RECORDS)
+			shard.traceBuffer.reserve(TRACE_BUFFER_RECORDS);
+		shard.traceBuffer.push_back(shard.tracer->record(op, fileId, pageNo));
+		if (shard.traceBuffer.size() == TRACE_BUFFER_RECORDS)
+		{
+			shard.tracer->write(&shard.traceBuffer[0], shard.traceBuffer.size());
+			shard.traceBuffer.clear();
+		}
+	}
+
+	if (shard.sampler != NULL)
+	{
+		if (op == TRACE_DISPOSE)
+		{
+			if (shard.sampler->samples(file, pageNo))
+				shard.sampler->forget(file, pageNo);
+			return;
+		}
+
+		shard.sampledAccesses++;
+		if (shard.sampler->samples(file, pageNo))
+			shard.sampler->access(file, pageNo);
+	}
+}
+
+BufCounters & BufMgr::fileCounters(BufShard & shard, const File* file)
+{
+	std::unordered_map<const File*, BufCounters*>::iterator found = shard.fileCounters.find(file);
+	if (found != shard.fileCounters.end())
+		return *found->second;
+
+	BufCounters & counters = shard.bufStats.files[file->filename()];
+	shard.fileCounters[file] = &counters;
+	return counters;
+}
+
+BufStats BufMgr::getBufStats()
+{
+	std::lock_guard<std::mutex> control(traceLatch);
+
+	BufStats total;
+	std::uint64_t sampledAccesses = 0;
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		std::lock_guard<std::mutex> guard(shards[s].latch);
+		total += shards[s].bufStats;
+		sampledAccesses += shards[s].sampledAccesses;
+	}
+
+	if (sampler != NULL)
+	{
+		std::vector<std::uint32_t> frames;
+		for (std::uint32_t k = 1; k <= MRC_POINTS; k++)
+		{
+			const std::uint32_t size = (std::uint32_t) ((std::uint64_t) numBufs * k / 8);
+			if (size > 0 && (frames.empty() || size > frames.back()))
+				frames.push_back(size);
+		}
+		sampler->missRatios(sampledAccesses, frames, total.missRatioCurve);
+	}
+	return total;
+}
+
+void BufMgr::clearBufStats()
+{
+	std::lock_guard<std::mutex> control(traceLatch);
+
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		std::lock_guard<std::mutex> guard(shards[s].latch);
+		shards[s].bufStats.clear();
+		shards[s].fileCounters.clear();
+		shards[s].lastFile = NULL;
+		shards[s].sampledAccesses = 0;
+	}
+	if (sampler != NULL)
+		sampler->clearCounts();
+}
+
+/**
+* Writes the counters of a BufCounters as text
+*/
+static void printCounters(std::ostream & out, const BufCounters & counters)
+{
+	out << "accesses " << counters.accesses << " hits " << counters.hits << " misses " << counters.misses
+	    << " hit ratio " << counters.hitRatio() << " diskreads " << counters.diskreads
+	    << " diskwrites " << counters.diskwrites << " evictions " << counters.evictions
+	    << " dirty evictions " << counters.dirtyEvictions << " pin waits " << counters.pinWaits
+	    << " frame waits " << counters.frameWaits;
+}
+
+/**
+* Writes the summary of a histogram as text
+*/
+static void printHistogram(std::ostream & out, const Histogram & histogram)
+{
+	out << "count " << histogram.count() << " mean " << histogram.mean() << " p50 " << histogram.percentile(50)
+	    << " p90 " << histogram.percentile(90) << " p99 " << histogram.percentile(99)
+	    << " p99.9 " << histogram.percentile(99.9) << " max " << histogram.max();
+}
+
+/**
+* Writes a string as a JSON string
+*/
+static void printJsonString(std::ostream & out, const std::string & str)
+{
+	out << '"';
+	for (std::size_t i = 0; i < str.size(); i++)
+	{
+		const unsigned char c = str[i];
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (c < 0x20)
+		{
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out << escaped;
+		}
+		else
+			out << c;
+	}
+	out << '"';
+}
+
+/**
+* Writes the counters of a BufCounters as JSON object members
+*/
+static void printJsonCounters(std::ostream & out, const BufCounters & counters)
+{
+	out << "\"accesses\":" << counters.accesses << ",\"hits\":" << counters.hits
+	    << ",\"misses\":" << counters.misses << ",\"hitRatio\":" << counters.hitRatio()
+	    << ",\"diskreads\":" << counters.diskreads << ",\"diskwrites\":" << counters.diskwrites
+	    << ",\"evictions\":" << counters.evictions << ",\"dirtyEvictions\":" << counters.dirtyEvictions
+	    << ",\"pinWaits\":" << counters.pinWaits << ",\"frameWaits\":" << counters.frameWaits;
+}
+
+/**
+* Writes a histogram as a JSON object
+*/
+static void printJsonHistogram(std::ostream & out, const Histogram & histogram)
+{
+	out << "{\"count\":" << histogram.count() << ",\"mean\":" << histogram.mean()
+	    << ",\"p50\":" << histogram.percentile(50) << ",\"p90\":" << histogram.percentile(90)
+	    << ",\"p99\":" << histogram.percentile(99) << ",\"p999\":" << histogram.percentile(99.9)
+	    << ",\"max\":" << histogram.max() << ",\"buckets\":[";
+
+	std::vector<std::pair<std::uint64_t, std::uint64_t> > buckets;
+	histogram.buckets(buckets);
+	for (std::size_t b = 0; b < buckets.size(); b++)
+		out << (b > 0 ? "," : "") << "[" << buckets[b].first << "," << buckets[b].second << "]";
+	out << "]}";
+}
+
+std::string BufStats::toText() const
+{
+	std::ostringstream out;
+	printCounters(out, *this);
+	out << "\nmiss latency ns: ";
+	printHistogram(out, missLatency);
+	out << "\nsweep length frames: ";
+	printHistogram(out, sweepLength);
+	out << "\n";
+
+	for (std::map<std::string, BufCounters>::const_iterator it = files.begin(); it != files.end(); ++it)
+	{
+		out << "file " << it->first << ": ";
+		printCounters(out, it->second);
+		out << "\n";
+	}
+
+	if (!missRatioCurve.empty())
+	{
+		out << "miss ratio curve (frames miss ratio):";
+		for (std::size_t n = 0; n < missRatioCurve.size(); n++)
+			out << " " << missRatioCurve[n].frames << " " << missRatioCurve[n].missRatio;
+		out << "\n";
+	}
+	return out.str();
+}
+
+std::string BufStats::toJson() const
+{
+	std::ostringstream out;
+	out << "{";
+	printJsonCounters(out, *this);
+	out << ",\"missLatencyNs\":";
+	printJsonHistogram(out, missLatency);
+	out << ",\"sweepLength\":";
+	printJsonHistogram(out, sweepLength);
+
+	out << ",\"files\":{";
+	for (std::map<std::string, BufCounters>::const_iterator it = files.begin(); it != files.end(); ++it)
+	{
+		if (it != files.begin())
+			out << ",";
+		printJsonString(out, it->first);
+		out << ":{";
+		printJsonCounters(out, it->second);
+		out << "}";
+	}
+
+	out << "},\"missRatioCurve\":[";
+	for (std::size_t n = 0; n < missRatioCurve.size(); n++)
+		out << (n > 0 ? "," : "") << "[" << missRatioCurve[n].frames << "," << missRatioCurve[n].missRatio << "]";
+	out << "]}";
+	return out.str();
+}
+
+//----------------------------------------
+// PinBudget
+//----------------------------------------
+
+void PinBudget::reserve()
+{
+	if (pinned.fetch_add(1) >= maxPins)
+	{
+		pinned--;
+		throw BufferExceededException();
+	}
+}
+
+void PinBudget::readPage(File* file, const PageId pageNo, Page*& page, BufRing* ring)
+{
+	reserve();
+	try
+	{
+		bufMgr->readPage(file, pageNo, page, ring);
+	}
+	catch (...)
+	{
+		pinned--;
+		throw;
+	}
+}
+
+void PinBudget::allocPage(File* file, PageId & pageNo, Page*& page)
+{
+	reserve();
+	try
+	{
+		bufMgr->allocPage(file, pageNo, page);
+	}
+	catch (...)
+	{
+		pinned--;
+		throw;
+	}
+}
+
+void PinBudget::unPinPage(File* file, const PageId pageNo, const bool dirty)
+{
+	bufMgr->unPinPage(file, pageNo, dirty);
+	pinned--;
+}
+
 }
@@ -9,7 +9,25 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "replacement.h"
+#include "arena.h"
+#include "latch.h"
+#include "epoch.h"
+#include "trace.h"
+#include "histogram.h"
 #include <iostream>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <future>
+#include <exception>
 
 namespace badgerdb {
 
@@ -17,6 +35,13 @@ namespace badgerdb {
 * forward declaration of BufMgr class 
 */
 class BufMgr;
+class BufShard;
+
+/**
+* Called when an asynchronous read of a page completes, see BufMgr::readPageAsync().  On success page is the page,
+* pinned for the caller, and error is empty; otherwise page is NULL and error holds the exception thrown by the read.
+*/
+typedef std::function<void(Page* page, std::exception_ptr error)> ReadCallback;
 
 /**
 * @brief Class for maintaining information about buffer pool frames
@@ -24,6 +49,9 @@ class BufMgr;
 class BufDesc {
 
 	friend class BufMgr;
+	friend class BufShard;
+	friend class ReplacementPolicy;
+	friend class PoolSimulator;
 
  private:
 	/**
@@ -61,6 +89,37 @@ class BufDesc {
 	 */
   bool refbit;
 
+	/**
+   * True while the background writer is writing the page out; the frame is pinned meanwhile
+	 */
+  bool cleaning;
+
+	/**
+   * True while the page is being read in by the readahead thread; the frame is pinned meanwhile
+	 */
+  bool loading;
+
+	/**
+   * True if the page was read ahead and has not been asked for since
+	 */
+  bool prefetched;
+
+	/**
+   * Neighbours of the frame on the list of its file's frames in its shard, NO_FRAME at either end
+	 */
+  FrameId filePrev;
+  FrameId fileNext;
+
+	/**
+   * Latch on the contents of the frame, taken by page guards while they have the page pinned
+	 */
+  FrameLatch latch;
+
+	/**
+   * Frame number ending a list of frames
+	 */
+  static const FrameId NO_FRAME = 0xFFFFFFFF;
+
 	/**
    * Initialize buffer frame for a new user
 	 */
@@ -72,6 +131,9 @@ class BufDesc {
     dirty = false;
     refbit = false;
 		valid = false;
+		cleaning = false;
+		loading = false;
+		prefetched = false;
   };
 
 	/**
@@ -89,6 +151,9 @@ class BufDesc {
     dirty = false;
     valid = true;
     refbit = true;
+    cleaning = false;
+    loading = false;
+    prefetched = false;
   }
 
   void Print()
@@ -111,6 +176,7 @@ class BufDesc {
    * Constructor of BufDesc class 
 	 */
   BufDesc()
+		: filePrev(NO_FRAME), fileNext(NO_FRAME)
 	{
   	Clear();
   }
@@ -118,178 +184,1508 @@ class BufDesc {
 
 
 /**
-* @brief Class to maintain statistics of buffer usage 
+* @brief Counters of buffer usage, for the whole pool or for the pages of one file.  Counters are 64 bits wide so
+* that they do not wrap on long running services.
 */
-struct BufStats
+struct BufCounters
 {
 	/**
-   * Total number of accesses to buffer pool
+   * Total number of accesses to buffer pool: pages pinned, allocated or read asynchronously
+	 */
+  std::uint64_t accesses;
+
+	/**
+   * Number of accesses that found the page in the buffer pool
+	 */
+  std::uint64_t hits;
+
+	/**
+   * Number of accesses that did not, including pages allocated; hits + misses = accesses
 	 */
-  int accesses;
+  std::uint64_t misses;
 
 	/**
-   * Number of pages read from disk (including allocs)
+   * Number of pages read from disk, including pages read ahead
 	 */
-  int diskreads;
+  std::uint64_t diskreads;
 
 	/**
    * Number of pages written back to disk
 	 */
-  int diskwrites;
+  std::uint64_t diskwrites;
+
+	/**
+   * Number of pages evicted to make room for others
+	 */
+  std::uint64_t evictions;
+
+	/**
+   * Number of pages evicted that had to be written back first, by the thread that needed the frame
+	 */
+  std::uint64_t dirtyEvictions;
+
+	/**
+   * Number of times an access had to wait for the page to be read in by another thread before pinning it
+	 */
+  std::uint64_t pinWaits;
+
+	/**
+   * Number of times an access found every frame pinned and waited for one to be unpinned, see BufMgr::setFrameWait()
+	 */
+  std::uint64_t frameWaits;
 
 	/**
    * Clear all values 
 	 */
   void clear()
   {
-		accesses = diskreads = diskwrites = 0;
+		accesses = hits = misses = diskreads = diskwrites = evictions = dirtyEvictions = pinWaits = frameWaits = 0;
   }
-      
+
 	/**
-   * Constructor of BufStats class 
+   * Constructor of BufCounters class 
 	 */
-  BufStats()
+  BufCounters()
   {
 		clear();
+  }
+
+	/**
+   * Add the values of another set of counters to this one
+	 */
+  BufCounters & operator+=(const BufCounters & other)
+  {
+		accesses += other.accesses;
+		hits += other.hits;
+		misses += other.misses;
+		diskreads += other.diskreads;
+		diskwrites += other.diskwrites;
+		evictions += other.evictions;
+		dirtyEvictions += other.dirtyEvictions;
+		pinWaits += other.pinWaits;
+		frameWaits += other.frameWaits;
+		return *this;
+  }
+
+	/**
+   * Returns the fraction of accesses that were hits, 0 if there were none
+	 */
+  double hitRatio() const
+  {
+		return accesses > 0 ? (double) hits / accesses : 0;
   }
 };
 
 
 /**
-* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+* @brief Class to maintain statistics of buffer usage 
+*
+* The counters of the whole pool, broken down per file, with distributions of how long misses take and how far the
+* replacement policy has to look for a victim.  BufMgr::getBufStats() returns a snapshot, which can be dumped as
+* text for people or JSON for monitoring to scrape.
 */
-class BufMgr 
+struct BufStats : public BufCounters
 {
+	/**
+   * Counters of the pages of each file, by file name
+	 */
+  std::map<std::string, BufCounters> files;
+
+	/**
+   * Nanoseconds readPage() and readPages() take to bring in a page missing from the pool: finding a frame,
+	 * writing back its page if it is dirty, and reading the new page
+	 */
+  Histogram missLatency;
+
+	/**
+   * Number of frames the replacement policy looks at each time a frame is needed
+	 */
+  Histogram sweepLength;
+
+	/**
+	 * Estimated fraction of accesses that would miss with pools of various sizes, from an eighth of the pool to
+	 * four times its size; empty unless the curve is being sampled, see BufMgr::startMrcSampling()
+	 */
+  std::vector<MissRatioPoint> missRatioCurve;
+
+	/**
+   * Clear all values 
+	 */
+  void clear()
+  {
+		BufCounters::clear();
+		files.clear();
+		missLatency.clear();
+		sweepLength.clear();
+		missRatioCurve.clear();
+  }
+
+	/**
+   * Add the values of another set of statistics to this one, except for the miss ratio curve
+	 */
+  BufStats & operator+=(const BufStats & other)
+  {
+		BufCounters::operator+=(other);
+		for (std::map<std::string, BufCounters>::const_iterator it = other.files.begin(); it != other.files.end(); ++it)
+			files[it->first] += it->second;
+		missLatency += other.missLatency;
+		sweepLength += other.sweepLength;
+		return *this;
+  }
+
+	/**
+	 * Returns the statistics as text, one line per group of values, for people to read.
+	 */
+  std::string toText() const;
+
+	/**
+	 * Returns the statistics as a JSON object, for monitoring to scrape.  Histograms come with their percentiles
+	 * and their non-empty buckets, as [smallest value, count] pairs.
+	 */
+  std::string toJson() const;
+};
+
+
+/**
+* @brief A partition of the buffer pool.
+*
+* Frames are dealt out to shards round robin, so that shard s of n owns frames
+* s, s + n, s + 2n, ...  A (file, page) pair always maps to the same shard, whose
+* latch protects the page table, the replacement policy and the descriptors of
+* all the frames it owns.  Threads working on pages of different shards never
+* contend.
+*
+* The shard also links the frames holding pages of each file into a list, so that
+* flushing a file only visits that file's frames.
+*/
+class BufShard {
+
+	friend class BufMgr;
+
  private:
 	/**
-   * Current position of clockhand in our buffer pool
+   * Maps a file to the first frame of the list of its frames
 	 */
-  FrameId clockHand;
+  typedef std::unordered_map<const File*, FrameId> FileFrameMap;
 
 	/**
-   * Number of frames in the buffer pool
+   * Latch protecting everything in this shard, including its frames' descriptors
 	 */
-  std::uint32_t numBufs;
-	
+  std::mutex latch;
+
+	/**
+   * Index of this shard in the buffer manager
+	 */
+  std::uint32_t shardNo;
+
+	/**
+   * Number of frames owned by this shard
+	 */
+  std::uint32_t numFrames;
+
 	/**
-   * Hash table mapping (File, page) to frame
+   * Hash table mapping (File, page) to frame for pages held by this shard
 	 */
   BufHashTbl *hashTable;
 
 	/**
-   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+   * Replacement policy choosing frames to evict among this shard's frames
 	 */
-  BufDesc *bufDescTable;
+  ReplacementPolicy *policy;
+
+	/**
+   * Lists of the frames holding pages of each file, threaded through BufDesc::filePrev and BufDesc::fileNext
+	 */
+  FileFrameMap fileFrames;
 
 	/**
-   * Maintains Buffer pool usage statistics 
+   * Buffer usage statistics of this shard
 	 */
   BufStats bufStats;
 
 	/**
-	 * Allocate a free frame.  
-	 *
-	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
-	 * @throws BufferExceededException If no such buffer is found which can be allocated
+   * Counters in bufStats.files of each file seen, so that the name of a file is only looked up once
+	 */
+  std::unordered_map<const File*, BufCounters*> fileCounters;
+
+	/**
+   * Last file counted and its counters, which most accesses are to
+	 */
+  const File* lastFile;
+  BufCounters* lastFileCounters;
+
+	/**
+   * Signalled, with the latch held, when the background writer or the readahead thread is done with a frame,
+	 * and when a frame is unpinned or emptied while frameWaiters is not 0
+	 */
+  std::condition_variable ioDone;
+
+	/**
+   * Number of threads waiting for a frame to be unpinned, see BufMgr::waitForFrame()
+	 */
+  std::uint32_t frameWaiters;
+
+	/**
+   * Callbacks waiting for the pages the I/O threads are reading, by frame
+	 */
+  std::unordered_map<FrameId, std::vector<ReadCallback> > asyncWaiters;
+
+	/**
+   * Trace accesses to the shard's pages are written to, NULL unless a trace is being taken
+	 */
+  TraceWriter *tracer;
+
+	/**
+   * Accesses traced and not yet written to the trace
+	 */
+  std::vector<TraceRecord> traceBuffer;
+
+	/**
+   * Ids the trace gave the files seen by this shard, kept here so that the trace is only asked once per file
+	 */
+  std::unordered_map<const File*, std::uint32_t> traceFileIds;
+
+	/**
+   * Sampler estimating the miss ratio curve, NULL unless the curve is being sampled
+	 */
+  MrcSampler *sampler;
+
+	/**
+   * Accesses made to the shard's pages since the sampler's counts were last cleared, sampled or not
+	 */
+  std::uint64_t sampledAccesses;
+
+	/**
+   * Constructor of BufShard class
 	 */
-  void allocBuf(FrameId & frame);
+  BufShard()
+  	: shardNo(0), numFrames(0), hashTable(NULL), policy(NULL), lastFile(NULL), lastFileCounters(NULL), frameWaiters(0),
+  	  tracer(NULL), sampler(NULL), sampledAccesses(0)
+  {
+  }
 
 	/**
-   * Advance clock to next frame in the buffer pool
+   * Destructor of BufShard class
 	 */
-  void advanceClock()
+  ~BufShard()
   {
-		clockHand = (clockHand + 1) % numBufs;
+		delete hashTable;
+		delete policy;
   }
+};
 
 
- public:
+/**
+* @brief A frame and the version of its contents at the time the page it held was last looked at.
+*
+* Obtained from a page guard, it lets the page be read again later without pinning it, as long as the frame has
+* not changed since; see BufMgr::readOptimistic().
+*/
+struct FrameRef
+{
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Frame number
 	 */
-  Page* bufPool;
+  FrameId frameNo;
 
 	/**
-   * Constructor of BufMgr class
+   * Version of the frame's latch
 	 */
-  BufMgr(std::uint32_t bufs);
-	
+  std::uint64_t version;
+};
+
+
+/**
+* @brief A frame a ring has brought a page into, and the page it put there
+*/
+struct RingSlot
+{
 	/**
-   * Destructor of BufMgr class
+   * Frame number
 	 */
-  ~BufMgr();
+  FrameId frameNo;
 
 	/**
-	 * Reads the given page from the file into a frame and returns the pointer to page.
-	 * If the requested page is already present in the buffer pool pointer to that frame is returned
-	 * otherwise a new frame is allocated from the buffer pool for reading the page.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number in the file to be read
-	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+   * File of the page loaded into the frame
 	 */
-  void readPage(File* file, const PageId PageNo, Page*& page);
+  const File* file;
 
 	/**
-	 * Unpin a page from memory since it is no longer required for it to remain in memory.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
-	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
-   * @throws  PageNotPinnedException If the page is not already pinned
+   * Page loaded into the frame
 	 */
-  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+  PageId pageNo;
+};
+
+
+/**
+* @brief A small private set of frames for a scan to recycle.
+*
+* Pages read through BufMgr::readPage() with a ring are loaded into frames that the ring then keeps track of.
+* Once the ring is full, the next page is loaded into the ring's oldest frame instead of a frame taken from
+* the rest of the pool, provided that frame still holds the page the ring put there and nobody has it pinned.
+* A sequential pass over a large file thus only cycles through a few frames and leaves the pages other users
+* keep in the pool alone.
+*
+* A ring belongs to one scan and must not be used by several threads at once.  It may be destroyed at any time;
+* the pages in its frames then simply stay in the pool.
+*/
+class BufRing {
 
+	friend class BufMgr;
+
+ public:
 	/**
-	 * Allocates a new, empty page in the file and returns the Page object.
-	 * The newly allocated page is also assigned a frame in the buffer pool.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
-	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+   * Default number of frames of a ring
 	 */
-  void allocPage(File* file, PageId &PageNo, Page*& page); 
+  static const std::uint32_t DEFAULT_SIZE = 32;
 
 	/**
-	 * Writes out all dirty pages of the file to disk.
-	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
-	 * Otherwise Error returned.
+   * Constructor of BufRing class
 	 *
-	 * @param file   	File object
-   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
-   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 * @param size  	Number of frames the ring may hold.  The buffer manager caps it at an eighth of the pool.
 	 */
-  void flushFile(const File* file);
+  explicit BufRing(const std::uint32_t size = DEFAULT_SIZE)
+  	: size(size), generation(0)
+  {
+  }
 
+ private:
 	/**
-	 * Delete page from file and also from buffer pool if present.
-	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
+   * Requested number of frames
 	 */
-  void disposePage(File* file, const PageId PageNo);
+  std::uint32_t size;
 
 	/**
-   * Print member variable values. 
+   * Generation of the buffer manager's frames the slots refer to, see BufMgr::ringGeneration
 	 */
-  void  printSelf();
+  std::uint64_t generation;
 
 	/**
-   * Get buffer pool usage statistics
+   * Frames of the ring in each shard of the buffer manager, oldest first
 	 */
-  BufStats & getBufStats()
-  {
-		return bufStats;
-  }
+  std::vector<std::deque<RingSlot> > slots;
+};
+
+
+/**
+* @brief A page the I/O threads have been asked to read into a frame, see BufMgr::readPageAsync()
+*/
+struct AsyncRead
+{
+	/**
+   * File of the page
+	 */
+  File* file;
+
+	/**
+   * Page to read
+	 */
+  PageId pageNo;
+
+	/**
+   * Frame to read the page into, pinned and marked loading until the read completes
+	 */
+  FrameId frameNo;
+};
+
+
+/**
+* @brief Pages of a file the readahead thread has been asked to load
+*/
+struct PrefetchRequest
+{
+	/**
+   * File the pages belong to
+	 */
+  File* file;
+
+	/**
+   * Pages to load, in order
+	 */
+  std::vector<PageId> pageNos;
+
+	/**
+   * True if the request comes from sequential readahead; its pages are skipped once the scan has passed them
+	 */
+  bool sequential;
+};
+
+
+/**
+* @brief State used to recognize a sequential scan of a file
+*/
+struct ReadaheadStream
+{
+	/**
+   * File being scanned, NULL if the stream is unused
+	 */
+  const File* file;
+
+	/**
+   * Last page of the scan read from disk or from a page read ahead
+	 */
+  PageId lastPageNo;
+
+	/**
+   * First page after the ones already requested from the readahead thread
+	 */
+  PageId aheadUntil;
 
 	/**
-   * Clear buffer pool usage statistics
+   * Constructor of ReadaheadStream class
 	 */
-  void clearBufStats() 
+  ReadaheadStream()
+  	: file(NULL), lastPageNo(Page::INVALID_NUMBER), aheadUntil(Page::INVALID_NUMBER)
   {
-		bufStats.clear();
   }
 };
 
+
+/**
+* @brief One page of a batch passed to BufMgr::readPages() or BufMgr::unPinPages()
+*/
+struct BatchRequest
+{
+	/**
+   * Page number
+	 */
+  PageId pageNo;
+
+	/**
+   * Position of the page in the caller's array
+	 */
+  std::uint32_t index;
+
+	/**
+   * Orders requests by page, so that duplicates are adjacent and pages are read in file order
+	 */
+  bool operator<(const BatchRequest & other) const
+  {
+		return pageNo != other.pageNo ? pageNo < other.pageNo : index < other.index;
+  }
+};
+
+
+/**
+* @brief Holder of pins kept from one call to the next, such as the pins of swizzled B-tree references, that can
+* give them up when the buffer manager needs their frames.
+*
+* Holders register with BufMgr::addPinHolder().  BufMgr::resize() calls releasePins() before it shrinks the pool,
+* and the destructor of BufMgr before it writes dirty pages back, both from the calling thread; a holder that is
+* not thread safe must not be in use by another thread meanwhile.
+*/
+class PinHolder
+{
+ public:
+	/**
+   * Destructor of PinHolder class
+	 */
+  virtual ~PinHolder() {}
+
+	/**
+	 * Unpins every page pinned from one call to the next, after putting back in the pages whatever they hold
+	 * that is only valid while pinned.  The holder may pin pages again later.
+	 */
+  virtual void releasePins() = 0;
+};
+
+
+/**
+* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* The buffer manager may be used by several threads at once.  The pool is split into shards (see BufShard), each
+* with its own latch, so only operations on pages of the same shard are serialized.
+*/
+class BufMgr 
+{
+ private:
+	/**
+   * Number of frames in the buffer pool
+	 */
+  std::atomic<std::uint32_t> numBufs;
+
+	/**
+   * Version frames added by resize start at, past every version frames given up by resize went through
+	 */
+  std::uint64_t retiredVersion;
+
+	/**
+   * Number of times resize has shrunk the pool; rings drop the frames they recorded before the last shrink
+	 */
+  std::atomic<std::uint64_t> ringGeneration;
+
+	/**
+   * Tracks optimistic readers, so that resize does not give back memory they may be reading
+	 */
+  EpochManager epochs;
+
+	/**
+   * Number of shards the buffer pool is partitioned into
+	 */
+  std::uint32_t numShards;
+
+	/**
+   * Array of shards, each owning a page table and a subset of the frames
+	 */
+  BufShard *shards;
+
+	/**
+   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+	 */
+  BufDesc *bufDescTable;
+
+	/**
+   * Memory holding the frames of bufPool
+	 */
+  BufArena *poolArena;
+
+	/**
+   * Memory holding bufDescTable, reserved for as many descriptors as poolArena has room for frames
+	 */
+  BufArena *descArena;
+
+	/**
+   * Serializes calls to resize
+	 */
+  std::mutex resizeLatch;
+
+	/**
+   * Holders of long-lived pins, see addPinHolder()
+	 */
+  std::vector<PinHolder*> pinHolders;
+
+	/**
+   * Protects pinHolders
+	 */
+  std::mutex pinHoldersLatch;
+
+	/**
+   * Asks every registered holder of long-lived pins to release them
+	 */
+  void releaseHeldPins();
+
+	/**
+   * Returns the number of frames a shard owns in a pool of the given size
+	 */
+  std::uint32_t shardFrames(const std::uint32_t shardNo, const std::uint32_t bufs) const
+  {
+		return (bufs - shardNo + numShards - 1) / numShards;
+  }
+
+	/**
+	 * Replaces a shard's page table with one sized for its current number of frames, holding the pages
+	 * on the shard's frame lists.  Caller must hold the shard latch.
+	 */
+  void rebuildHashTable(BufShard & shard);
+
+	/**
+	 * Hands a frame that was just emptied back to the shard's replacement policy.  A frame past the end of
+	 * a shrinking shard is not handed back; the resize waiting for it is woken instead.
+	 * Caller must hold the shard latch.
+	 */
+  void releaseFrame(BufShard & shard, const FrameId frameNo);
+
+	/**
+	 * Takes the frames past newFrames away from a shard: they stop being handed out, and their pages are
+	 * written back if dirty and dropped as soon as they are unpinned.
+	 */
+  void shrinkShard(BufShard & shard, const std::uint32_t newFrames);
+
+	/**
+   * Returns the latch of the frame holding a page the caller has pinned
+	 */
+  FrameLatch & frameLatch(const Page* page)
+  {
+		return bufDescTable[page - bufPool].latch;
+  }
+
+  friend class PageGuard;
+
+	/**
+	 * Adds n to one of the counters of a shard, and to the same counter of the file of the page counted.
+	 * Caller must hold the shard latch.
+	 */
+  void tally(BufShard & shard, const File* file, std::uint64_t BufCounters::* counter, const std::uint64_t n = 1)
+  {
+		shard.bufStats.*counter += n;
+		if (file != shard.lastFile)
+		{
+			shard.lastFileCounters = &fileCounters(shard, file);
+			shard.lastFile = file;
+		}
+		shard.lastFileCounters->*counter += n;
+  }
+
+	/**
+	 * Returns the counters of a file in a shard's statistics, creating them the first time the file is counted.
+	 * Caller must hold the shard latch.
+	 */
+  BufCounters & fileCounters(BufShard & shard, const File* file);
+
+	/**
+   * Number of accesses a shard buffers before writing them to the trace
+	 */
+  static const std::uint32_t TRACE_BUFFER_RECORDS = 4096;
+
+	/**
+   * Number of points of the miss ratio curve returned with the statistics, an eighth of the pool apart
+	 */
+  static const std::uint32_t MRC_POINTS = 32;
+
+	/**
+   * Serializes starting and stopping traces and miss ratio sampling, and keeps them going while in use
+	 */
+  std::mutex traceLatch;
+
+	/**
+   * Trace being taken, NULL if none
+	 */
+  TraceWriter *tracer;
+
+	/**
+   * Sampler estimating the miss ratio curve, NULL if the curve is not being sampled
+	 */
+  MrcSampler *sampler;
+
+	/**
+	 * Passes an access to a page to the trace being taken and the miss ratio sampler, if any.
+	 * Caller must hold the shard latch.
+	 */
+  void recordAccess(BufShard & shard, const TraceOp op, const File* file, const PageId pageNo)
+  {
+		if (shard.tracer != NULL || shard.sampler != NULL)
+			traceAccess(shard, op, file, pageNo);
+  }
+
+	/**
+	 * Does the work of recordAccess() when a trace is being taken or the miss ratio curve sampled.
+	 */
+  void traceAccess(BufShard & shard, const TraceOp op, const File* file, const PageId pageNo);
+
+	/**
+	 * Writes out what the shards have buffered of the trace being taken and closes it, if there is one.
+	 * Caller must hold traceLatch.
+	 *
+	 * @return  			False if the trace could not be written completely
+	 */
+  bool endTrace();
+
+	/**
+	 * Stops sampling the miss ratio curve, if it is being sampled.  Caller must hold traceLatch.
+	 */
+  void endMrcSampling();
+
+	/**
+	 * Enters the page a frame has just been set up for into the shard's page table and its file's frame list.
+	 * Caller must hold the shard latch.
+	 */
+  void mapPage(BufShard & shard, const FrameId frameNo);
+
+	/**
+	 * Removes the page held by a frame from the shard's page table and its file's frame list.
+	 * Caller must hold the shard latch.
+	 */
+  void unmapPage(BufShard & shard, const FrameId frameNo);
+
+	/**
+	 * Allocate a free frame from a shard, evicting the page chosen by the shard's replacement policy if needed.
+	 * Caller must hold the shard latch.  It is released while a dirty victim is written out, so the page the
+	 * frame is for may have been read in by somebody else by the time this returns.
+	 *
+	 * @param shard   	Shard to allocate the frame from
+	 * @param lock   	Caller's lock of the shard latch
+	 * @param file   	File of the page the frame is allocated for
+	 * @param pageNo  Page number of the page the frame is allocated for
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 */
+  void allocBuf(BufShard & shard, std::unique_lock<std::mutex> & lock, const File* file, const PageId pageNo,
+                FrameId & frame);
+
+	/**
+	 * Same as allocBuf(), but returns false instead of throwing if every frame of the shard is pinned.
+	 */
+  bool tryAllocBuf(BufShard & shard, std::unique_lock<std::mutex> & lock, const File* file, const PageId pageNo,
+                   FrameId & frame);
+
+	/**
+	 * Gives back frames reserved for pages that were published as loading but are not going to be read in,
+	 * and wakes up the readers waiting for them.  Caller must hold the shard latch.
+	 */
+  void abandonLoads(BufShard & shard, const std::vector<FrameId> & frames);
+
+	/**
+	 * Waits for a frame of a shard to be unpinned or emptied, after tryAllocBuf() found every frame pinned.
+	 * The latch is released while waiting, so the caller has to look for its page again before retrying.
+	 *
+	 * @param shard   	Shard to wait for a frame of
+	 * @param lock   		Caller's hold of the shard latch
+	 * @param file   		File of the page the frame is needed for, for the statistics
+	 * @param deadline	Time to give up at; set by the first call, from a default constructed time_point
+	 * @return  				False if the pool does not wait for frames or the deadline has passed
+	 */
+  bool waitForFrame(BufShard & shard, std::unique_lock<std::mutex> & lock, const File* file,
+                    std::chrono::steady_clock::time_point & deadline);
+
+	/**
+   * Milliseconds readPage(), readPages() and allocPage() wait for a frame when every frame is pinned, 0 not to wait
+	 */
+  std::atomic<std::uint32_t> frameWaitMs;
+
+	/**
+   * Returns the frame number of the i-th frame owned by a shard
+	 */
+  FrameId shardFrame(const BufShard & shard, const std::uint32_t i) const
+  {
+		return i * numShards + shard.shardNo;
+  }
+
+	/**
+   * Returns the index of a frame among the frames of its shard
+	 */
+  std::uint32_t shardIndex(const FrameId frameNo) const
+  {
+		return frameNo / numShards;
+  }
+
+	/**
+   * Returns the shard responsible for a page of a file
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  BufShard & shardOf(const File* file, const PageId pageNo);
+
+	/**
+   * Waits until the background writer and the readahead thread are done with a frame.
+	 * Caller holds the shard latch through lock.
+	 */
+  void waitForIO(BufShard & shard, std::unique_lock<std::mutex> & lock, const FrameId frameNo);
+
+	/**
+   * Background writer thread
+	 */
+  std::thread bgWriter;
+
+	/**
+   * Protects the background writer settings below and bgWriterStop
+	 */
+  std::mutex bgWriterLatch;
+
+	/**
+   * Wakes the background writer early when it has to stop
+	 */
+  std::condition_variable bgWriterWake;
+
+	/**
+   * Set to ask the background writer to exit
+	 */
+  bool bgWriterStop;
+
+	/**
+   * Fraction of each shard's frames, in the order they would be evicted, the background writer keeps clean
+	 */
+  double bgCleanRatio;
+
+	/**
+   * Maximum number of pages the background writer writes per round, over all shards
+	 */
+  std::uint32_t bgPagesPerRound;
+
+	/**
+   * Pause between two rounds of the background writer, in milliseconds
+	 */
+  std::uint32_t bgRoundInterval;
+
+	/**
+   * Main loop of the background writer thread
+	 */
+  void bgWriterLoop();
+
+	/**
+   * Writes out dirty, unpinned frames among the next victims of a shard's replacement policy.
+	 * Looks at bgCleanRatio of the shard's frames and writes at most budget pages.
+	 *
+	 * @param shard   	Shard to clean
+	 * @param budget  Maximum number of pages to write
+	 * @return  			Number of pages written
+	 */
+  std::uint32_t cleanShard(BufShard & shard, const std::uint32_t budget);
+
+	/**
+   * Maximum number of consecutive pages writeFrames() writes with one call to File::writePages()
+	 */
+  static const std::uint32_t MAX_WRITE_RUN = 64;
+
+	/**
+	 * Writes out the pages held by frames, sorted by file and page number so that consecutive pages of a file are
+	 * written as one run.  No shard latch is held: the frames must be pinned and marked cleaning, so that they
+	 * do not change meanwhile, unless nothing else uses the buffer manager any more.
+	 *
+	 * @param frames		Frames to write, sorted the same way on return
+	 * @param failed		Set to true for each frame, in the sorted order, whose page could not be written
+	 */
+  void writeFrames(std::vector<FrameId> & frames, std::vector<bool> & failed);
+
+	/**
+   * Number of streams tracked for sequential readahead, files hash to one of them
+	 */
+  static const std::uint32_t READAHEAD_STREAMS = 16;
+
+	/**
+   * Maximum number of prefetch requests waiting for the readahead thread, further ones are dropped
+	 */
+  static const std::uint32_t MAX_PREFETCH_REQUESTS = 64;
+
+	/**
+   * Readahead thread, loading prefetched pages.  Started by the first prefetch request.
+	 */
+  std::thread raWorker;
+
+	/**
+   * Protects the readahead settings, streams and request queue below
+	 */
+  std::mutex raLatch;
+
+	/**
+   * Wakes the readahead thread when a request is queued or it has to stop
+	 */
+  std::condition_variable raWake;
+
+	/**
+   * Signalled when the readahead thread finishes a request
+	 */
+  std::condition_variable raIdle;
+
+	/**
+   * Set to ask the readahead thread to exit
+	 */
+  bool raStop;
+
+	/**
+   * Requests waiting for the readahead thread
+	 */
+  std::deque<PrefetchRequest> raQueue;
+
+	/**
+   * File of the request the readahead thread is working on, NULL if it is idle
+	 */
+  const File* raCurrentFile;
+
+	/**
+   * Number of pages read ahead once a sequential scan is recognized, 0 if automatic readahead is disabled
+	 */
+  std::uint32_t raWindow;
+
+	/**
+   * Sequential scans being tracked
+	 */
+  ReadaheadStream raStreams[READAHEAD_STREAMS];
+
+	/**
+   * Returns the frames a ring holds in a shard
+	 */
+  std::deque<RingSlot> & ringSlots(BufRing & ring, const BufShard & shard);
+
+	/**
+   * Returns how many frames a ring may hold in each shard
+	 */
+  std::uint32_t ringCapacity(const BufRing & ring) const;
+
+	/**
+	 * Evicts the page a ring put into a frame, if the frame still holds it and nobody uses it.  If the page is
+	 * dirty and cannot be written out, the frame is left as it was and the exception is passed on.
+	 * Caller must hold the shard latch.
+	 *
+	 * @return  True if the frame was emptied
+	 */
+  bool evictRingFrame(BufShard & shard, const RingSlot & slot);
+
+	/**
+	 * Takes the oldest frame of a full ring for a new page.  Caller must hold the shard latch.
+	 *
+	 * @param shard   	Shard of the new page
+	 * @param ring   	Ring of the scan reading the page
+	 * @param frame   	Frame ID of the recycled frame returned via this variable
+	 * @return  			False if the ring is not full yet or its oldest frame cannot be reused
+	 */
+  bool recycleRingFrame(BufShard & shard, BufRing & ring, FrameId & frame);
+
+	/**
+	 * Adds a frame to a ring, evicting the page of the ring's oldest frame if the ring is full.  Does not
+	 * throw: if that page cannot be written out, the ring keeps it and holds one frame too many until the
+	 * next call.  Caller must hold the shard latch.
+	 */
+  void addToRing(BufShard & shard, BufRing & ring, const FrameId frameNo);
+
+	/**
+   * Returns the index of the readahead stream tracking a file
+	 */
+  std::uint32_t streamOf(const File* file) const
+  {
+		return (((std::uint64_t) file * 0x9E3779B97F4A7C15ULL) >> 32) % READAHEAD_STREAMS;
+  }
+
+	/**
+   * Queues a prefetch request, starting the readahead thread if needed
+	 */
+  void queuePrefetch(File* file, std::vector<PageId> & pageNos, const bool sequential);
+
+	/**
+   * Feeds a page read from disk, or a page read ahead being asked for, to sequential scan detection.
+	 * Queues readahead of the next pages of the file when the page continues a scan.
+	 */
+  void noteSequential(File* file, const PageId pageNo);
+
+	/**
+   * Drops queued prefetch requests for a file and waits for the readahead thread to be done with it
+	 */
+  void cancelPrefetch(const File* file);
+
+	/**
+   * Stops the readahead thread, dropping queued requests
+	 */
+  void stopReadahead();
+
+	/**
+   * Main loop of the readahead thread
+	 */
+  void readaheadLoop();
+
+	/**
+	 * Reads a page into an unpinned frame, unless it is already in the buffer pool.
+	 * The shard latch is released during the read; readers of the page wait for it to finish.
+	 *
+	 * @return  False if no frame was available or the page could not be read
+	 */
+  bool prefetchPage(File* file, const PageId pageNo);
+
+	/**
+   * Number of I/O threads serving asynchronous reads.  They are started by the first asynchronous read.
+	 */
+  static const std::uint32_t IO_THREADS = 4;
+
+	/**
+   * I/O threads
+	 */
+  std::vector<std::thread> ioWorkers;
+
+	/**
+   * Protects the I/O queue, ioWorkers and ioStop
+	 */
+  std::mutex ioLatch;
+
+	/**
+   * Wakes an I/O thread when a read is queued or the threads have to stop
+	 */
+  std::condition_variable ioWake;
+
+	/**
+   * Set to ask the I/O threads to exit once the queue is empty
+	 */
+  bool ioStop;
+
+	/**
+   * Reads waiting for an I/O thread
+	 */
+  std::deque<AsyncRead> ioQueue;
+
+	/**
+   * Main loop of an I/O thread
+	 */
+  void ioLoop();
+
+	/**
+	 * Reads a page into the frame published for it by readPageAsync(), then hands it to the callbacks waiting for it.
+	 * If the read fails, the frame is given back and the callbacks get the error.
+	 */
+  void completeRead(const AsyncRead & read);
+
+	/**
+   * Waits for the I/O threads to complete the reads queued, then stops them
+	 */
+  void stopAsyncIO();
+
+	/**
+   * Maximum number of reads loadSnapshot() keeps in flight
+	 */
+  static const std::uint32_t WARMUP_WINDOW = 64;
+
+	/**
+	 * Groups the pages of a batch by shard.  On return the requests for the pages of shard s are
+	 * requests[shardStarts[s], shardStarts[s + 1]), in the order they appear in pageNos.
+	 */
+  void groupBatch(const File* file, const PageId* pageNos, const std::uint32_t count,
+                  std::vector<BatchRequest> & requests, std::vector<std::uint32_t> & shardStarts);
+
+
+ public:
+	/**
+   * Number of frames address space is reserved for when the constructor is not given a maximum (8GB of frames)
+	 */
+  static const std::uint32_t DEFAULT_MAX_BUFS = 1 << 20;
+
+	/**
+   * Actual buffer pool from which frames are allocated.  Frames live in a huge page aligned arena and are not
+	 * constructed: each one is assigned a whole page before it is first used.
+	 */
+  Page* bufPool;
+
+	/**
+   * Constructor of BufMgr class
+	 *
+	 * @param bufs   	Number of frames in the buffer pool
+	 * @param shards 	Number of independently latched shards to partition the frames into.
+	 *                Using more than one lets threads working on different pages proceed in parallel.
+	 * @param policy 	Page replacement policy used within each shard
+	 * @param maxBufs	Largest number of frames the pool can be resized to; address space is reserved for
+	 *                them up front.  0 reserves DEFAULT_MAX_BUFS, or bufs if that is larger.
+	 */
+  BufMgr(std::uint32_t bufs, std::uint32_t shards = 1, ReplacementPolicyType policy = CLOCK, std::uint32_t maxBufs = 0);
+	
+	/**
+   * Destructor of BufMgr class
+	 */
+  ~BufMgr();
+
+	/**
+	 * Reads the given page from the file into a frame and returns the pointer to page.
+	 * If the requested page is already present in the buffer pool pointer to that frame is returned
+	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+	 *
+	 * Scans reading many pages once should pass a ring: a page not in the pool is then read into one of the
+	 * ring's frames, and pages read ahead for the scan join the ring as they are used (see BufRing).
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param ring  	Ring of frames to recycle, NULL to use the whole pool
+	 * @throws BufferExceededException If the page is not in the pool and no frame can be allocated for it
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page, BufRing* ring = NULL);
+
+	/**
+	 * Reads several pages of a file into the buffer pool and pins them, like as many calls to readPage().
+	 * The pages are grouped by shard, so that each shard is latched only once, and sorted by page number.  The
+	 * pages of a shard missing from the pool all get a frame first; they are then read without the latch, each
+	 * run of consecutive pages with a single read, and in file order.  A page asked for more
+	 * than once is looked up once but pinned once for each time it is asked for.
+	 *
+	 * Either all the pages are pinned or, if an exception is thrown, none of them are.
+	 *
+	 * @param file   	File object
+	 * @param pageNos Numbers of the pages to read
+	 * @param count   Number of pages in pageNos
+	 * @param pages  	Array of count page pointers; pages[i] is set to the page pageNos[i] is read into
+	 * @throws BufferExceededException If a page is not in the pool and no frame can be allocated for it
+	 */
+  void readPages(File* file, const PageId* pageNos, const std::uint32_t count, Page** pages);
+
+	/**
+	 * Asks for pages of a file to be read into the buffer pool ahead of demand.
+	 * The pages are read by a separate thread and left unpinned, so they may be evicted again before
+	 * being asked for.  Pages already in the pool are left alone.  The request is a hint: it is dropped
+	 * if too many requests are pending, and loading stops at the first page that cannot be read.
+	 *
+	 * @param file   	File object
+	 * @param firstPageNo  First page to read
+	 * @param count   Number of consecutive pages to read
+	 */
+  void prefetchPages(File* file, const PageId firstPageNo, const std::uint32_t count);
+
+	/**
+	 * Asks for pages of a file to be read into the buffer pool ahead of demand, in the given order.
+	 * See prefetchPages(File*, const PageId, const std::uint32_t).
+	 *
+	 * @param file   	File object
+	 * @param pageNos Pages to read
+	 */
+  void prefetchPages(File* file, const std::vector<PageId> & pageNos);
+
+	/**
+	 * Sets how many pages are read ahead once readPage() sees a file being read sequentially.
+	 * The window is capped at a quarter of the buffer pool.
+	 *
+	 * @param window  Number of pages to read ahead, 0 to disable automatic readahead
+	 */
+  void setReadahead(const std::uint32_t window);
+
+	/**
+	 * Starts reading a page into the buffer pool without waiting for the read.  If the page is in the pool, it is
+	 * pinned and the callback is called before readPageAsync() returns.  Otherwise a frame is set aside for the
+	 * page and the read is queued for a pool of I/O threads, one of which calls the callback once the page is in;
+	 * many reads can thus be in flight at once.  The page is pinned for the callback, which has to unpin it
+	 * with unPinPage() like a page read with readPage().  Threads asking for the page meanwhile, through
+	 * readPage() or readPageAsync(), get it once the read completes.
+	 *
+	 * Errors, including BufferExceededException if no frame can be set aside, are passed to the callback rather
+	 * than thrown.  The callback must not throw, and the file must stay open until it has been called.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @param callback	Called once with the pinned page, or with the error that kept it from being read
+	 */
+  void readPageAsync(File* file, const PageId pageNo, const ReadCallback & callback);
+
+	/**
+	 * Starts reading a page into the buffer pool without waiting for the read.  See
+	 * readPageAsync(File*, const PageId, const ReadCallback &).
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @return  			Future yielding the pinned page, or rethrowing the error that kept it from being read
+	 */
+  std::future<Page*> readPageAsync(File* file, const PageId pageNo);
+
+	/**
+	 * Writes the list of pages resident in the buffer pool to a file, hottest first, for loadSnapshot() to warm up
+	 * a later buffer manager with.  Pages are identified by the name of their file and their page number.  How hot
+	 * a page is follows from where the replacement policy of its shard ranks it, relative to the size of the shard.
+	 * The list is written to a temporary file first and renamed over path, so that an earlier snapshot survives a
+	 * failed one.  Meant to be called on shutdown, while the files of the pages are still open, and periodically
+	 * while running, so that a crash does not lose the snapshot.
+	 *
+	 * @param path   	Name of the snapshot file
+	 * @return  			False if the snapshot could not be written
+	 */
+  bool saveSnapshot(const std::string & path);
+
+	/**
+	 * Reads the pages listed in a snapshot written by saveSnapshot() back into the buffer pool.  Only pages of the
+	 * given files are read, matched by file name, and only the hottest ones, as many as the pool holds.  They are
+	 * read file by file in page order, through the I/O threads (see readPageAsync()), and left unpinned.  Pages
+	 * that can no longer be read are skipped.  Returns once all the reads have completed.
+	 *
+	 * @param path   	Name of the snapshot file
+	 * @param files   Open files whose pages to read
+	 * @return  			Number of pages read, 0 if there is no snapshot
+	 */
+  std::uint32_t loadSnapshot(const std::string & path, const std::vector<File*> & files);
+
+	/**
+	 * Unpin a page from memory since it is no longer required for it to remain in memory.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+   * @throws  PageNotPinnedException If the page is not already pinned
+   * @throws  HashNotFoundException If the page is not in the buffer pool
+	 */
+  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+
+	/**
+	 * Unpins several pages of a file, like as many calls to unPinPage(), latching each shard only once.
+	 * A page listed more than once is unpinned once for each time it is listed.  Pages that cannot be unpinned
+	 * do not stop the others from being unpinned; the exception for the first of them is thrown at the end.
+	 *
+	 * @param file   	File object
+	 * @param pageNos Numbers of the pages to unpin
+	 * @param count   Number of pages in pageNos
+	 * @param dirty		True if the pages need to be marked dirty
+   * @throws  PageNotPinnedException If a page is not already pinned
+   * @throws  HashNotFoundException If a page is not in the buffer pool
+	 */
+  void unPinPages(File* file, const PageId* pageNos, const std::uint32_t count, const bool dirty);
+
+	/**
+	 * Allocates a new, empty page in the file and returns the Page object.
+	 * The newly allocated page is also assigned a frame in the buffer pool.
+	 *
+	 * The page is allocated in the file before a frame is looked for, as its number decides the shard;
+	 * if no frame can be had, the page is deleted from the file again before the exception is thrown.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 * @throws BufferExceededException If no frame could be allocated for the page
+	 */
+  void allocPage(File* file, PageId &PageNo, Page*& page); 
+
+	/**
+	 * Inserts a record into a relation, in a page its free-space map says has room for it, or a new page if
+	 * none has.  The page is latched exclusive while the record goes in, and left dirty in the buffer pool.
+	 *
+	 * @param file   				Relation to insert into
+	 * @param record_data  	Bytes of the record
+	 * @return	Id of the record inserted
+	 * @throws InsufficientSpaceException If the record does not fit in an empty page
+	 * @throws BufferExceededException If no frame could be allocated for the page
+	 */
+  RecordId insertRecord(PageFile* file, const std::string & record_data);
+
+	/**
+	 * Writes out all dirty pages of the file to disk.
+	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
+	 * Otherwise Error returned.  Pending prefetches of the file are dropped, so it must be called before the File
+	 * object is destroyed.  Only the frames holding pages of the file are visited, whatever the size of the pool.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
+   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 */
+  void flushFile(const File* file);
+
+	/**
+	 * Delete page from file and also from buffer pool if present.
+	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 */
+  void disposePage(File* file, const PageId PageNo);
+
+	/**
+   * Print member variable values. 
+	 */
+  void  printSelf();
+
+	/**
+	 * Starts a background thread which writes out dirty pages ahead of the replacement policy, so that
+	 * readPage() and allocPage() rarely have to write a dirty victim themselves.  Pages being written
+	 * stay pinned for the duration of the write.  Restarts the writer if it is already running.
+	 *
+	 * @param cleanRatio   	Fraction of each shard's frames, next in line for eviction, to keep clean; between 0 and 1
+	 * @param pagesPerRound Maximum number of pages written per round, which bounds the write rate
+	 * @param intervalMs    Pause between rounds in milliseconds
+	 */
+  void startBgWriter(const double cleanRatio = 0.25, const std::uint32_t pagesPerRound = 64,
+                     const std::uint32_t intervalMs = 20);
+
+	/**
+	 * Stops the background writer if it is running, waiting for its current write to finish.
+	 */
+  void stopBgWriter();
+
+	/**
+	 * Grows or shrinks the buffer pool while it is in use.  Frames are added or taken away at the end of every
+	 * shard and each shard's page table is rebuilt for its new size, one shard at a time; the other shards keep
+	 * serving pages meanwhile.  Pages in frames given up are written back if dirty and dropped.  A pinned page
+	 * is never moved or dropped: shrinking waits until it is unpinned, so all pages pinned by the calling
+	 * thread have to be unpinned first.  Holders of long-lived pins registered with addPinHolder() are asked to
+	 * release theirs before the pool shrinks.
+	 *
+	 * @param newBufs	New number of frames, at least one per shard
+	 * @throws BufferExceededException If newBufs is more than the maximum the pool was constructed with
+	 */
+  void resize(std::uint32_t newBufs);
+
+	/**
+	 * Registers a holder of pins kept from one call to the next, so that it is asked to release them before the
+	 * pool shrinks or is destroyed.  The holder has to be unregistered before it goes away.
+	 *
+	 * @param holder	Holder to register
+	 */
+  void addPinHolder(PinHolder* holder);
+
+	/**
+	 * Unregisters a holder registered with addPinHolder().  Does nothing if it is not registered.
+	 *
+	 * @param holder	Holder to unregister
+	 */
+  void removePinHolder(PinHolder* holder);
+
+	/**
+	 * Returns the page a frame held when a guard on it handed out the FrameRef, without pinning or latching
+	 * anything, if the frame has not changed since.  Returns NULL otherwise, in which case the page has to be
+	 * read through a guard.
+	 *
+	 * Whatever is read from the page may be inconsistent until validateOptimistic() confirms that the frame
+	 * still has not changed; nothing read may be acted on before that.  The caller must be in an epoch of
+	 * getEpochManager() from before this call until it is done with the page.  Only pages that are written
+	 * exclusively through WritePageGuards may be read this way.
+	 *
+	 * @param ref   	Frame and version obtained from a guard on the page
+	 * @return Pointer to the page, or NULL if the frame has changed
+	 */
+  const Page* readOptimistic(const FrameRef & ref);
+
+	/**
+	 * Returns true if the frame has not changed since readOptimistic() was called with the same FrameRef,
+	 * so that everything read from the page in between is consistent.
+	 */
+  bool validateOptimistic(const FrameRef & ref);
+
+	/**
+	 * Returns the frame holding a page the caller has pinned, with the current version of its contents.
+	 * The version is only stable while the caller also holds the frame's latch; see readOptimistic().
+	 */
+  FrameRef frameRef(const Page* page)
+  {
+		FrameRef ref = { (FrameId) (page - bufPool), frameLatch(page).readVersion() };
+		return ref;
+  }
+
+	/**
+	 * Returns the number of the page held by a frame.  The caller must have the page pinned, which keeps the
+	 * frame from being given to another page.
+	 */
+  PageId framePageNo(const FrameId frameNo) const
+  {
+		return bufDescTable[frameNo].pageNo;
+  }
+
+	/**
+	 * Pins once more a page the caller already has pinned, reached through its frame rather than the page table.
+	 * Counts as an access of the page, like readPage().
+	 *
+	 * @param frameNo		Frame holding the page
+	 * @param page  		Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 */
+  void pinFrame(const FrameId frameNo, Page*& page);
+
+	/**
+   * Returns the number of frames in the buffer pool
+	 */
+  std::uint32_t getNumBufs() const
+  {
+		return numBufs;
+  }
+
+	/**
+   * Returns the epochs optimistic readers must register with
+	 */
+  EpochManager & getEpochManager()
+  {
+		return epochs;
+  }
+
+	/**
+	 * Makes readPage(), readPages() and allocPage() wait for a frame to be unpinned when every frame that could
+	 * hold their page is pinned, instead of throwing BufferExceededException at once, so that a burst of pins
+	 * slows threads down rather than failing them.  They throw only once the timeout has passed.  A thread
+	 * waiting for a frame keeps the pages it has pinned, so threads that each pin many pages at once can wait
+	 * for each other until they time out; see PinBudget.  readPageAsync() and readahead never wait.
+	 *
+	 * @param timeoutMs	Longest a call waits for a frame in milliseconds, 0 (the default) not to wait
+	 */
+  void setFrameWait(const std::uint32_t timeoutMs)
+  {
+		frameWaitMs = timeoutMs;
+  }
+
+	/**
+	 * Starts writing a trace of the accesses to pages in the buffer pool to a file, stopping any trace being
+	 * taken.  Every page pinned through readPage() and its variants, allocated or disposed of is recorded with its
+	 * file, page number and the time of the access, for the miss ratio curves of the pool to be worked out offline
+	 * (see badgerdb_mrc).  Accesses are buffered by each shard and written in blocks of TRACE_BUFFER_RECORDS.
+	 * Costs a single test per access when no trace is being taken.
+	 *
+	 * @param path   	Name of the trace file, replaced if it exists
+	 * @return  			False if the trace file could not be created
+	 */
+  bool startTrace(const std::string & path);
+
+	/**
+	 * Stops the trace being taken, if any, and closes its file.  Also done by the destructor.
+	 *
+	 * @return  			False if the trace could not be written completely
+	 */
+  bool stopTrace();
+
+	/**
+	 * Starts estimating the miss ratio curve of the pool from a sample of the pages accessed, restarting the
+	 * estimate if the curve is already being sampled.  The curve comes with getBufStats(), which shows how the
+	 * miss ratio would change if the pool were resized.  Only accesses to sampled pages take a latch; the curve is
+	 * that of an LRU pool, which other policies approach.
+	 *
+	 * @param rate   	Fraction of pages to sample, between 0 and 1; the smaller the pool the larger it needs to be
+	 */
+  void startMrcSampling(const double rate = 0.01);
+
+	/**
+	 * Stops estimating the miss ratio curve.
+	 */
+  void stopMrcSampling();
+
+	/**
+   * Get buffer pool usage statistics, summed over all shards, with the estimated miss ratio curve if it is
+	 * being sampled
+	 */
+  BufStats getBufStats();
+
+	/**
+   * Clear buffer pool usage statistics, including the counts the miss ratio curve is estimated from
+	 */
+  void clearBufStats();
+};
+
+
+/**
+* @brief Caps the number of pages a query has pinned at once, so that one large query cannot pin the whole pool.
+*
+* The query reads, allocates and unpins its pages through its budget rather than straight through the BufMgr.
+* Asking for a page that would take the query over its budget throws BufferExceededException without looking at
+* the pool, and without waiting for a frame as setFrameWait() may have other callers do: only the query itself
+* can bring its pins back under budget.  The threads of a query can share its budget.
+*/
+class PinBudget {
+
+ public:
+	/**
+	 * Constructor of PinBudget class
+	 *
+	 * @param bufMgr   	Buffer manager the query reads its pages through
+	 * @param maxPins   Largest number of pages the query may have pinned at once, counting a page pinned twice
+	 *                  twice
+	 */
+  PinBudget(BufMgr* bufMgr, const std::uint32_t maxPins)
+  	: bufMgr(bufMgr), maxPins(maxPins), pinned(0)
+  {
+  }
+
+	/**
+	 * Reads a page into the buffer pool and pins it, see BufMgr::readPage().
+	 *
+	 * @throws BufferExceededException If the query has as many pages pinned as its budget allows, or no frame can
+	 *                                 be allocated for the page
+	 */
+  void readPage(File* file, const PageId pageNo, Page*& page, BufRing* ring = NULL);
+
+	/**
+	 * Allocates a new page in a file and pins it, see BufMgr::allocPage().  The budget is checked before the page
+	 * is allocated in the file.
+	 *
+	 * @throws BufferExceededException If the query has as many pages pinned as its budget allows, or no frame can
+	 *                                 be allocated for the page
+	 */
+  void allocPage(File* file, PageId & pageNo, Page*& page);
+
+	/**
+	 * Unpins a page pinned through this budget, see BufMgr::unPinPage().
+	 */
+  void unPinPage(File* file, const PageId pageNo, const bool dirty);
+
+	/**
+   * Returns the number of pages the query has pinned
+	 */
+  std::uint32_t getPinned() const
+  {
+		return pinned;
+  }
+
+ private:
+	/**
+	 * Counts a page about to be pinned, or throws if that would take the query over its budget.
+	 */
+  void reserve();
+
+	/**
+   * Buffer manager the query reads its pages through
+	 */
+  BufMgr* bufMgr;
+
+	/**
+   * Largest number of pages the query may have pinned at once
+	 */
+  const std::uint32_t maxPins;
+
+	/**
+   * Number of pages the query has pinned, including pages being pinned
+	 */
+  std::atomic<std::uint32_t> pinned;
+
+  PinBudget(const PinBudget &);
+  PinBudget & operator=(const PinBudget &);
+};
+
 }
@@ -0,0 +1,156 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+namespace badgerdb {
+
+/**
+* @brief Tells when memory that threads may still be reading without holding anything can be given back.
+*
+* Threads reading frames optimistically enter an epoch for the duration of the read.  Before memory is released,
+* synchronize() waits until every thread that entered before it was called has left.  Threads entering later
+* cannot have seen the memory, provided whatever made it unreachable was done before the call.
+*
+* Readers are counted in a few slots, picked by thread, and in two counters per slot, picked by the parity of
+* the global epoch.  synchronize() moves the epoch on and only waits for the counters of the previous parity to
+* drain, so a steady stream of new readers cannot hold it up.
+*/
+class EpochManager {
+
+ public:
+	/**
+   * Constructor of EpochManager class
+	 */
+  EpochManager()
+  	: epoch(0)
+  {
+		for (std::uint32_t i = 0; i < NUM_SLOTS; i++)
+		{
+			slots[i].readers[0] = 0;
+			slots[i].readers[1] = 0;
+		}
+  }
+
+	/**
+	 * Registers the calling thread as a reader.
+	 *
+	 * @return Ticket to pass to leave()
+	 */
+  std::uint32_t enter()
+  {
+		std::atomic<std::uint32_t>* const readers = slots[slotOf()].readers;
+		while (true)
+		{
+			std::uint64_t e = epoch.load();
+			readers[e & 1]++;
+			// a synchronize() that moved on meanwhile may not have seen us; count in the new parity instead
+			if (epoch.load() == e)
+				return (slotOf() << 1) | (std::uint32_t) (e & 1);
+			readers[e & 1]--;
+		}
+  }
+
+	/**
+	 * Unregisters a reader.
+	 *
+	 * @param ticket	Value returned by the matching enter()
+	 */
+  void leave(const std::uint32_t ticket)
+  {
+		slots[ticket >> 1].readers[ticket & 1]--;
+  }
+
+	/**
+	 * Waits until every reader that entered before the call has left.  Only one thread may call it at a time.
+	 */
+  void synchronize()
+  {
+		const std::uint64_t old = epoch++;
+		for (std::uint32_t i = 0; i < NUM_SLOTS; i++)
+		{
+			while (slots[i].readers[old & 1].load() != 0)
+				std::this_thread::yield();
+		}
+  }
+
+ private:
+	/**
+   * Number of slots readers are spread over
+	 */
+  static const std::uint32_t NUM_SLOTS = 32;
+
+	/**
+	 * @brief Reader counts of one slot, padded to a cache line of its own
+	 */
+  struct Slot
+  {
+		std::atomic<std::uint32_t> readers[2];
+		char pad[64 - 2 * sizeof(std::atomic<std::uint32_t>)];
+  };
+
+	/**
+   * Returns the slot of the calling thread
+	 */
+  static std::uint32_t slotOf()
+  {
+		return (std::uint32_t) (std::hash<std::thread::id>()(std::this_thread::get_id()) % NUM_SLOTS);
+  }
+
+	/**
+   * Global epoch, advanced by synchronize()
+	 */
+  std::atomic<std::uint64_t> epoch;
+
+	/**
+   * Reader counts
+	 */
+  Slot slots[NUM_SLOTS];
+
+  EpochManager(const EpochManager &);
+  EpochManager & operator=(const EpochManager &);
+};
+
+
+/**
+* @brief Keeps the calling thread in an epoch for as long as it exists.
+*/
+class EpochGuard {
+
+ public:
+	/**
+	 * Enters an epoch.
+	 *
+	 * @param epochs	Manager to register with
+	 */
+  explicit EpochGuard(EpochManager & epochs)
+  	: epochs(epochs), ticket(epochs.enter())
+  {
+  }
+
+	/**
+   * Leaves the epoch
+	 */
+  ~EpochGuard()
+  {
+		epochs.leave(ticket);
+  }
+
+ private:
+  EpochManager & epochs;
+  std::uint32_t ticket;
+
+  EpochGuard(const EpochGuard &);
+  EpochGuard & operator=(const EpochGuard &);
+};
+
+}
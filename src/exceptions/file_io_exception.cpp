@@ -0,0 +1,24 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "file_io_exception.h"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+FileIOException::FileIOException(const std::string& name, const int error)
+    : BadgerDbException(""), error_(error) {
+  std::stringstream ss;
+  ss << "Could not write to file: " << name << " (" << std::strerror(error)
+     << ")";
+  message_.assign(ss.str());
+}
+
+}
@@ -0,0 +1,42 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the operating system fails to write
+ *        to a file, for instance because the disk is full.
+ */
+class FileIOException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a file I/O exception for the given file.
+   *
+   * @param name    Name of the file written to.
+   * @param error   errno value the write failed with.
+   */
+  FileIOException(const std::string& name, const int error);
+
+  /**
+   * Returns the errno value the write failed with.
+   */
+  virtual int error() const { return error_; }
+
+ protected:
+  /**
+   * errno value the write failed with.
+   */
+  const int error_;
+};
+
+}
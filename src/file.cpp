@@ -7,14 +7,29 @@
 
 #include "file.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <new>
+#include <cstddef>
 #include <string>
 #include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <cassert>
+#include <cerrno>
+#include <vector>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 #include "exceptions/file_exists_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
@@ -23,8 +38,331 @@
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
+namespace {
+
+/**
+ * Size of the header of files of the earlier layout, which has no room for
+ * the fields after first_free_page.
+ */
+const std::size_t LEGACY_HEADER_SIZE = offsetof(FileHeader, last_used_page);
+
+/**
+ * Skips the buffers of a sequence that a read or write cut short went
+ * through, and the part of the next one that it got to.
+ */
+void skipTransferred(struct iovec*& iov, int& iovcnt, std::size_t done) {
+  while (iovcnt > 0 && done >= iov->iov_len) {
+    done -= iov->iov_len;
+    ++iov;
+    --iovcnt;
+  }
+  if (iovcnt > 0) {
+    iov->iov_base = static_cast<char*>(iov->iov_base) + done;
+    iov->iov_len -= done;
+  }
+}
+
+/**
+ * Reads from a file descriptor at the given position into a sequence of
+ * buffers, retrying reads that are interrupted or cut short.  Returns the
+ * number of bytes read, short only at the end of the file or on an error.
+ */
+std::size_t preadFully(const int fd, struct iovec* iov, int iovcnt,
+                       off_t position) {
+  std::size_t done = 0;
+  while (iovcnt > 0) {
+    const ssize_t n = ::preadv(fd, iov, std::min(iovcnt, IOV_MAX), position);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    done += n;
+    position += n;
+    skipTransferred(iov, iovcnt, n);
+  }
+  return done;
+}
+
+/**
+ * Writes a sequence of buffers to a file descriptor at the given position,
+ * retrying writes that are interrupted or cut short.  Throws a
+ * FileIOException, naming the file, on any other error.
+ */
+void pwriteFully(const int fd, struct iovec* iov, int iovcnt,
+                 off_t position, const std::string& filename) {
+  while (iovcnt > 0) {
+    const ssize_t n = ::pwritev(fd, iov, std::min(iovcnt, IOV_MAX), position);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      throw FileIOException(filename, errno);
+    }
+    if (n == 0) {
+      // no progress and no error; the disk has no room for more
+      throw FileIOException(filename, ENOSPC);
+    }
+    position += n;
+    skipTransferred(iov, iovcnt, n);
+  }
+}
+
+/**
+ * Block of memory aligned for direct I/O, freed when it goes out of scope.
+ */
+class AlignedBuffer {
+ public:
+  explicit AlignedBuffer(const std::size_t size) {
+    if (::posix_memalign(&data_, File::DIRECT_IO_ALIGNMENT, size) != 0) {
+      throw std::bad_alloc();
+    }
+    std::memset(data_, 0, size);
+  }
+
+  ~AlignedBuffer() { std::free(data_); }
+
+  char* data() const { return static_cast<char*>(data_); }
+
+ private:
+  void* data_;
+
+  AlignedBuffer(const AlignedBuffer&);
+  AlignedBuffer& operator=(const AlignedBuffer&);
+};
+
+/**
+ * Returns true if a sequence of buffers can be read or written at the given
+ * position with direct I/O as it is.
+ */
+bool isAligned(const struct iovec* iov, const int iovcnt,
+               const off_t position) {
+  const std::size_t alignment = File::DIRECT_IO_ALIGNMENT;
+  if (position % alignment != 0) {
+    return false;
+  }
+  for (int i = 0; i < iovcnt; ++i) {
+    if (reinterpret_cast<std::uintptr_t>(iov[i].iov_base) % alignment != 0 ||
+        iov[i].iov_len % alignment != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Returns the number of bytes in a sequence of buffers.
+ */
+std::size_t totalLength(const struct iovec* iov, const int iovcnt) {
+  std::size_t total = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    total += iov[i].iov_len;
+  }
+  return total;
+}
+
+/**
+ * Reads into a sequence of buffers like preadFully(), through an aligned
+ * buffer covering the blocks the bytes fall in if the file is open for
+ * direct I/O and the buffers are not aligned for it.
+ */
+std::size_t readFully(const FileDescriptor& descriptor, struct iovec* iov,
+                      const int iovcnt, const off_t position) {
+  if (!descriptor.direct() || isAligned(iov, iovcnt, position)) {
+    return preadFully(descriptor.fd(), iov, iovcnt, position);
+  }
+
+  const std::size_t alignment = File::DIRECT_IO_ALIGNMENT;
+  const std::size_t total = totalLength(iov, iovcnt);
+  const off_t start = position - position % alignment;
+  const std::size_t skip = position - start;
+  const std::size_t length = (skip + total + alignment - 1) / alignment *
+      alignment;
+  AlignedBuffer bounce(length);
+  struct iovec whole = {bounce.data(), length};
+  const std::size_t read = preadFully(descriptor.fd(), &whole, 1, start);
+  const std::size_t done = read > skip ? std::min(total, read - skip) : 0;
+
+  std::size_t copied = 0;
+  for (int i = 0; i < iovcnt && copied < done; ++i) {
+    const std::size_t n = std::min(iov[i].iov_len, done - copied);
+    std::memcpy(iov[i].iov_base, bounce.data() + skip + copied, n);
+    copied += n;
+  }
+  return done;
+}
+
+/**
+ * Writes a sequence of buffers like pwriteFully(), through an aligned buffer
+ * covering the blocks the bytes fall in if the file is open for direct I/O
+ * and the buffers are not aligned for it.  The parts of those blocks outside
+ * the bytes written are read first, so that they are kept.
+ */
+void writeFully(const FileDescriptor& descriptor, struct iovec* iov,
+                const int iovcnt, const off_t position,
+                const std::string& filename) {
+  if (!descriptor.direct() || isAligned(iov, iovcnt, position)) {
+    pwriteFully(descriptor.fd(), iov, iovcnt, position, filename);
+    return;
+  }
+
+  const std::size_t alignment = File::DIRECT_IO_ALIGNMENT;
+  const std::size_t total = totalLength(iov, iovcnt);
+  const off_t start = position - position % alignment;
+  const std::size_t skip = position - start;
+  const std::size_t length = (skip + total + alignment - 1) / alignment *
+      alignment;
+  AlignedBuffer bounce(length);
+  struct iovec whole = {bounce.data(), length};
+  if (skip != 0 || total != length) {
+    // blocks past the end of the file are read short and stay zeroed
+    preadFully(descriptor.fd(), &whole, 1, start);
+    whole.iov_base = bounce.data();
+    whole.iov_len = length;
+  }
+
+  std::size_t copied = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    std::memcpy(bounce.data() + skip + copied, iov[i].iov_base,
+                iov[i].iov_len);
+    copied += iov[i].iov_len;
+  }
+  pwriteFully(descriptor.fd(), &whole, 1, start, filename);
+}
+
+/**
+ * Returns the offset of page 1 in an existing file of the given size.  Files
+ * of the earlier layout have pages right after the header, and so a size that
+ * is not a multiple of the page size; newer ones reserve a whole page for the
+ * header, so that pages are aligned.
+ */
+off_t firstPagePositionOf(const off_t size) {
+  if (size % Page::SIZE == LEGACY_HEADER_SIZE) {
+    return LEGACY_HEADER_SIZE;
+  }
+  return Page::SIZE;
+}
+
+}
+
+FileDescriptor::~FileDescriptor() {
+  ::close(fd_);
+}
+
+void FreeExtents::add(const PageId page_number) {
+  PageId first = page_number;
+  PageId last = page_number;
+  std::map<PageId, PageId>::iterator next = extents_.upper_bound(page_number);
+  if (next != extents_.end() && next->first == page_number + 1) {
+    last = next->second;
+    next = extents_.erase(next);
+  }
+  if (next != extents_.begin()) {
+    std::map<PageId, PageId>::iterator previous = next;
+    --previous;
+    if (previous->second + 1 == page_number) {
+      first = previous->first;
+    }
+  }
+  extents_[first] = last;
+}
+
+void FreeExtents::remove(const PageId page_number) {
+  std::map<PageId, PageId>::iterator extent =
+      extents_.upper_bound(page_number);
+  if (extent == extents_.begin()) {
+    return;
+  }
+  --extent;
+  const PageId first = extent->first;
+  const PageId last = extent->second;
+  if (last < page_number) {
+    return;
+  }
+  extents_.erase(extent);
+  if (first < page_number) {
+    extents_[first] = page_number - 1;
+  }
+  if (page_number < last) {
+    extents_[page_number + 1] = last;
+  }
+}
+
+void FreeExtents::neighbours(const PageId page_number, const PageId num_pages,
+                             PageId& previous, PageId& next) const {
+  PageId first = Page::INVALID_NUMBER;
+  PageId last = Page::INVALID_NUMBER;
+  // Page 0 is the header.
+  previous = page_number - 1;
+  if (find(previous, first, last)) {
+    previous = first - 1;
+  }
+  next = page_number + 1;
+  if (find(next, first, last)) {
+    next = last + 1;
+  }
+  if (next >= num_pages) {
+    next = Page::INVALID_NUMBER;
+  }
+}
+
+bool FreeExtents::find(const PageId page_number, PageId& first,
+                       PageId& last) const {
+  std::map<PageId, PageId>::const_iterator extent =
+      extents_.upper_bound(page_number);
+  if (extent == extents_.begin()) {
+    return false;
+  }
+  --extent;
+  first = extent->first;
+  last = extent->second;
+  return last >= page_number;
+}
+
+void FreeSpaceMap::set(const PageId page_number, const std::uint8_t category) {
+  if (page_number >= categories_.size()) {
+    categories_.resize(page_number + 1, 0);
+  }
+  const std::uint8_t previous = categories_[page_number];
+  if (previous == category) {
+    return;
+  }
+  if (previous > 0) {
+    pages_[previous].erase(page_number);
+  }
+  if (category > 0) {
+    pages_[category].insert(page_number);
+  }
+  categories_[page_number] = category;
+}
+
+bool FreeSpaceMap::store(const PageId page_number,
+                         const std::uint8_t category) {
+  if (page_number >= stored_.size()) {
+    stored_.resize(page_number + 1, 0);
+  }
+  if (stored_[page_number] == category) {
+    return false;
+  }
+  stored_[page_number] = category;
+  return true;
+}
+
+PageId FreeSpaceMap::find(const std::uint8_t category) const {
+  for (std::uint8_t c = std::max<std::uint8_t>(category, 1); c < CATEGORIES;
+       ++c) {
+    if (!pages_[c].empty()) {
+      return *pages_[c].begin();
+    }
+  }
+  return Page::INVALID_NUMBER;
+}
+
+File::DescriptorMap File::open_descriptors_;
 File::CountMap File::open_counts_;
+File::LatchMap File::open_latches_;
+std::mutex File::open_files_latch_;
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -40,6 +378,7 @@ bool File::isOpen(const std::string& filename) {
   if (!exists(filename)) {
     return false;
   }
+  std::lock_guard<std::mutex> guard(open_files_latch_);
   return open_counts_.find(filename) != open_counts_.end();
 }
 
@@ -64,24 +403,53 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
-  openIfNeeded(create_new);
+std::size_t File::readAt(void* buffer, const std::size_t size,
+                         const off_t position) const {
+  struct iovec iov = {buffer, size};
+  return readFully(*descriptor_, &iov, 1, position);
+}
+
+void File::writeAt(const void* buffer, const std::size_t size,
+                   const off_t position) {
+  struct iovec iov = {const_cast<void*>(buffer), size};
+  writeFully(*descriptor_, &iov, 1, position, filename_);
+}
+
+void File::readPagesInto(const PageId first_page_number, Page* const* pages,
+                         const std::size_t count) const {
+  for (std::size_t i = 0; i < count; ++i) {
+    readPageInto(first_page_number + i, *pages[i]);
+  }
+}
+
+void File::writePages(const PageId first_page_number, const Page* const* pages,
+                      const std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    writePage(first_page_number + i, *pages[i]);
+  }
+}
+
+File::File(const std::string& name, const bool create_new,
+           const bool direct_io) : filename_(name) {
+  openIfNeeded(create_new, direct_io);
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         0 /* last_used_page */, 0 /* free_space_map */};
     writeHeader(header);
   }
 }
 
-void File::openIfNeeded(const bool create_new) {
+void File::openIfNeeded(const bool create_new, const bool direct_io) {
+  std::lock_guard<std::mutex> guard(open_files_latch_);
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
     ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+    descriptor_ = open_descriptors_[filename_];
+    latch_ = open_latches_[filename_];
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
+    int flags = O_RDWR | O_CLOEXEC;
     const bool already_exists = exists(filename_);
     if (create_new) {
       // Error if we try to overwrite an existing file.
@@ -89,60 +457,107 @@ void File::openIfNeeded(const bool create_new) {
         throw FileExistsException(filename_);
       }
       // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
+      flags = flags | O_CREAT | O_TRUNC;
     } else {
       // Error if we try to open a file that doesn't exist.
       if (!already_exists) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
+    const int fd = ::open(filename_.c_str(), flags, 0644);
+    if (fd < 0) {
+      throw FileNotFoundException(filename_);
+    }
+
+    // New files reserve a whole page for the header.
+    off_t first_page_position = Page::SIZE;
+    struct stat status;
+    if (create_new) {
+      if (::ftruncate(fd, Page::SIZE) != 0) {
+        ::close(fd);
+        throw FileNotFoundException(filename_);
+      }
+    } else if (::fstat(fd, &status) == 0) {
+      first_page_position = firstPagePositionOf(status.st_size);
+    }
+
+    // Direct I/O needs aligned pages, and is not supported by every
+    // filesystem; files fall back to buffered I/O otherwise.
+    bool direct = false;
+    if (direct_io && first_page_position % DIRECT_IO_ALIGNMENT == 0) {
+      direct = ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_DIRECT) == 0;
+    }
+    descriptor_.reset(new FileDescriptor(fd, first_page_position, direct));
+    if (create_new) {
+      // No pages to be free yet.
+      descriptor_->freeExtents().setLoaded();
+    }
+    latch_.reset(new std::recursive_mutex());
+    open_descriptors_[filename_] = descriptor_;
+    open_latches_[filename_] = latch_;
     open_counts_[filename_] = 1;
   }
 }
 
 void File::close() {
+  std::lock_guard<std::mutex> guard(open_files_latch_);
 	if(open_counts_[filename_] > 0)
   	--open_counts_[filename_];
 
-  stream_.reset();
+  descriptor_.reset();
+  latch_.reset();
 	assert(open_counts_[filename_] >= 0);
 
   if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
+    open_descriptors_.erase(filename_);
+    open_latches_.erase(filename_);
     open_counts_.erase(filename_);
   }
 }
 
 FileHeader File::readHeader() const {
   FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+  header.last_used_page = Page::INVALID_NUMBER;
+  header.free_space_map = Page::INVALID_NUMBER;
+  readAt(&header, headerSize(), 0 /* pos */);
   return header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  writeAt(&header, headerSize(), 0 /* pos */);
 }
 
+std::size_t File::headerSize() const {
+  if (descriptor_->firstPagePosition() < (off_t) sizeof(FileHeader)) {
+    return LEGACY_HEADER_SIZE;
+  }
+  return sizeof(FileHeader);
+}
 
 
 
 
-PageFile PageFile::create(const std::string& filename) {
-  return PageFile(filename, true /* create_new */);
+
+PageFile PageFile::create(const std::string& filename, const bool direct_io) {
+  return PageFile(filename, true /* create_new */, direct_io);
 }
 
-PageFile PageFile::open(const std::string& filename) {
-  return PageFile(filename, false /* create_new */);
+PageFile PageFile::open(const std::string& filename, const bool direct_io) {
+  return PageFile(filename, false /* create_new */, direct_io);
 }
 
-PageFile::PageFile(const std::string& name, const bool create_new)
-: File(name, create_new)
+PageFile::PageFile(const std::string& name, const bool create_new,
+                   const bool direct_io)
+: File(name, create_new, direct_io)
 {
+  if (create_new) {
+    // New files keep their free-space map on disk, from the first page on.
+    FileHeader header = readHeader();
+    header.free_space_map = 1;
+    writeHeader(header);
+    descriptor_->freeSpaceMap().setLoaded(header.free_space_map);
+  }
 }
 
 PageFile::~PageFile() {
@@ -163,38 +578,35 @@ PageFile& PageFile::operator=(const PageFile& rhs) {
 }
 
 Page PageFile::allocatePage(PageId &new_page_number) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
   FileHeader header = readHeader();
+  FreeSpaceMap& free_space_map = loadFreeSpaceMap();
   Page new_page;
   Page existing_page;
   if (header.num_free_pages > 0) {
+    FreeExtents& free_extents = loadFreeExtents(header);
     new_page = readPage(header.first_free_page, true /* allow_free */);
     new_page.set_page_number(header.first_free_page);
 		new_page_number = new_page.page_number();
     header.first_free_page = new_page.next_page_number();
     --header.num_free_pages;
 
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
+    // The used list is in page order, so the new page goes between the used
+    // pages closest to it, which are found without walking the list.
+    PageId previous_page_number;
+    PageId next_page_number;
+    free_extents.neighbours(new_page_number, header.num_pages,
+                            previous_page_number, next_page_number);
+    free_extents.remove(new_page_number);
+    new_page.set_next_page_number(next_page_number);
+    if (previous_page_number == Page::INVALID_NUMBER) {
+      header.first_used_page = new_page_number;
     } else {
-      // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
+      existing_page = readPage(previous_page_number);
+      existing_page.set_next_page_number(new_page_number);
+    }
+    if (next_page_number == Page::INVALID_NUMBER) {
+      header.last_used_page = new_page_number;
     }
 
     assert((header.num_free_pages == 0) ==
@@ -202,6 +614,15 @@ Page PageFile::allocatePage(PageId &new_page_number) {
   }
 	else
 	{
+    if (free_space_map.isMapPage(header.num_pages)) {
+      // The map page goes in front of the pages it holds the free space of.
+      const Page map_page;
+      writeAt(&map_page, Page::SIZE, pagePosition(header.num_pages));
+      if (descriptor_->freeExtents().loaded()) {
+        descriptor_->freeExtents().add(header.num_pages);
+      }
+      ++header.num_pages;
+    }
     new_page.set_page_number(header.num_pages);
 		new_page_number = new_page.page_number();
 
@@ -213,15 +634,11 @@ Page PageFile::allocatePage(PageId &new_page_number) {
 		{
       // If we have pages allocated, we need to add the new page to the tail
       // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
+      existing_page = readPage(lastUsedPage(header));
+      assert(existing_page.next_page_number() == Page::INVALID_NUMBER);
       existing_page.set_next_page_number(new_page.page_number());
     }
+    header.last_used_page = new_page_number;
     ++header.num_pages;
   }
   writePage(new_page_number, new_page.header_, new_page);
@@ -236,20 +653,49 @@ Page PageFile::allocatePage(PageId &new_page_number) {
 }
 
 Page PageFile::readPage(const PageId page_number) const {
-  FileHeader header = readHeader();
+  Page page;
+  readPageInto(page_number, page);
+  return page;
+}
 
-	if (page_number >= header.num_pages)
-	{
-		throw InvalidPageException(page_number, filename_);
-	}
-	return readPage(page_number, false /* allow_free */);
+void PageFile::readPageInto(const PageId page_number, Page& page) const {
+  // The file ends after its last page, which is read short; there is no need
+  // to read num_pages from the header.  Page 0 is the header.
+  if (page_number == Page::INVALID_NUMBER ||
+      readAt(&page, Page::SIZE, pagePosition(page_number)) != Page::SIZE ||
+      !page.isUsed()) {
+    throw InvalidPageException(page_number, filename_);
+  }
+}
+
+void PageFile::readPagesInto(const PageId first_page_number,
+                             Page* const* pages,
+                             const std::size_t count) const {
+  if (first_page_number == Page::INVALID_NUMBER) {
+    throw InvalidPageException(first_page_number, filename_);
+  }
+  // Read the pages where they are in one go, then check each like
+  // readPageInto() does.
+  std::vector<struct iovec> iov(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    iov[i].iov_base = pages[i];
+    iov[i].iov_len = Page::SIZE;
+  }
+  const std::size_t read = readFully(*descriptor_, &iov[0], iov.size(),
+                                     pagePosition(first_page_number));
+  for (std::size_t i = 0; i < count; ++i) {
+    if (read < (i + 1) * Page::SIZE || !pages[i]->isUsed()) {
+      throw InvalidPageException(first_page_number + i, filename_);
+    }
+  }
 }
 
 Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
+  if (readAt(&page, Page::SIZE, pagePosition(page_number)) != Page::SIZE) {
+    // past the end of the file
+    throw InvalidPageException(page_number, filename_);
+  }
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
@@ -258,6 +704,7 @@ Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
 }
 
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
 	PageHeader header = readPageHeader(new_page_number);
 	if (header.current_page_number == Page::INVALID_NUMBER)
 	{
@@ -273,25 +720,58 @@ void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
 	writePage(new_page_number, header, new_page);
 }
 
+void PageFile::writePages(const PageId first_page_number,
+                          const Page* const* pages, const std::size_t count) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  // Keep the next page pointers on disk like writePage() does, then write the
+  // headers and the data of the pages where they are in one go.
+  std::vector<PageHeader> headers(count);
+  std::vector<struct iovec> iov(2 * count);
+  for (std::size_t i = 0; i < count; ++i) {
+    headers[i] = readPageHeader(first_page_number + i);
+    if (headers[i].current_page_number == Page::INVALID_NUMBER) {
+      throw InvalidPageException(first_page_number + i, filename_);
+    }
+    const PageId next_page_number = headers[i].next_page_number;
+    headers[i] = pages[i]->header_;
+    headers[i].next_page_number = next_page_number;
+    iov[2 * i].iov_base = &headers[i];
+    iov[2 * i].iov_len = sizeof(PageHeader);
+    iov[2 * i + 1].iov_base = const_cast<char*>(&pages[i]->data_[0]);
+    iov[2 * i + 1].iov_len = Page::DATA_SIZE;
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    storeFreeSpace(first_page_number + i, headers[i]);
+  }
+  writeFully(*descriptor_, &iov[0], iov.size(),
+             pagePosition(first_page_number), filename_);
+}
+
 void PageFile::deletePage(const PageId page_number) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
   FileHeader header = readHeader();
 
   Page existing_page = readPage(page_number);
   Page previous_page;
-  // If this page is the head of the used list, update the header to point to
-  // the next page in line.
-  if (page_number == header.first_used_page) {
+  // The used list is in page order, so the page that points to this one is the
+  // used page closest before it.
+  FreeExtents& free_extents = loadFreeExtents(header);
+  PageId previous_page_number;
+  PageId next_page_number;
+  free_extents.neighbours(page_number, header.num_pages, previous_page_number,
+                          next_page_number);
+  if (previous_page_number == Page::INVALID_NUMBER) {
+    // This page is the head of the used list, so update the header to point
+    // to the next page in line.
     header.first_used_page = existing_page.next_page_number();
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
-    }
+    previous_page = readPage(previous_page_number);
+    previous_page.set_next_page_number(existing_page.next_page_number());
+  }
+  if (next_page_number == Page::INVALID_NUMBER) {
+    header.last_used_page = previous_page_number;
   }
+  free_extents.add(page_number);
   // Clear the page and add it to the head of the free list.
   existing_page.initialize();
   existing_page.set_next_page_number(header.first_free_page);
@@ -304,6 +784,108 @@ void PageFile::deletePage(const PageId page_number) {
   writeHeader(header);
 }
 
+PageId PageFile::lastUsedPage(FileHeader& header) {
+  if (header.last_used_page == Page::INVALID_NUMBER &&
+      header.first_used_page != Page::INVALID_NUMBER) {
+    // Files of the earlier layout, and files written before the header kept
+    // it, do not know their last page; it is the used page closest before the
+    // end of the file.
+    PageId next_page_number;
+    loadFreeExtents(header).neighbours(header.num_pages, header.num_pages,
+                                       header.last_used_page,
+                                       next_page_number);
+  }
+  return header.last_used_page;
+}
+
+FreeExtents& PageFile::loadFreeExtents(const FileHeader& header) {
+  FreeExtents& free_extents = descriptor_->freeExtents();
+  if (!free_extents.loaded()) {
+    for (PageId page_number = header.first_free_page;
+         page_number != Page::INVALID_NUMBER;
+         page_number = readPageHeader(page_number).next_page_number) {
+      free_extents.add(page_number);
+    }
+    // Map pages are in neither list.
+    if (header.free_space_map != Page::INVALID_NUMBER) {
+      for (PageId page_number = header.free_space_map;
+           page_number < header.num_pages;
+           page_number += FreeSpaceMap::ENTRIES_PER_PAGE + 1) {
+        free_extents.add(page_number);
+      }
+    }
+    free_extents.setLoaded();
+  }
+  return free_extents;
+}
+
+FreeSpaceMap& PageFile::loadFreeSpaceMap() {
+  FreeSpaceMap& free_space_map = descriptor_->freeSpaceMap();
+  if (free_space_map.loaded()) {
+    return free_space_map;
+  }
+  const FileHeader header = readHeader();
+  if (header.free_space_map == Page::INVALID_NUMBER) {
+    // Nothing on disk to read but the used pages themselves.
+    for (PageId page_number = header.first_used_page;
+         page_number != Page::INVALID_NUMBER;) {
+      const PageHeader page_header = readPageHeader(page_number);
+      free_space_map.set(page_number, FreeSpaceMap::categoryOf(
+          page_header.free_space_upper_bound -
+          page_header.free_space_lower_bound));
+      page_number = page_header.next_page_number;
+    }
+  } else {
+    std::vector<unsigned char> entries(FreeSpaceMap::ENTRIES_PER_PAGE / 2);
+    for (PageId map_page = header.free_space_map;
+         map_page < header.num_pages;
+         map_page += FreeSpaceMap::ENTRIES_PER_PAGE + 1) {
+      readAt(&entries[0], entries.size(),
+             pagePosition(map_page) + sizeof(PageHeader));
+      for (PageId i = 0; i < FreeSpaceMap::ENTRIES_PER_PAGE &&
+           map_page + 1 + i < header.num_pages; ++i) {
+        const std::uint8_t category = (entries[i / 2] >> (i % 2 * 4)) & 0xf;
+        free_space_map.store(map_page + 1 + i, category);
+        free_space_map.set(map_page + 1 + i, category);
+      }
+    }
+  }
+  free_space_map.setLoaded(header.free_space_map);
+  return free_space_map;
+}
+
+void PageFile::storeFreeSpace(const PageId page_number,
+                              const PageHeader& header) {
+  FreeSpaceMap& free_space_map = loadFreeSpaceMap();
+  const std::uint8_t category =
+      header.current_page_number == Page::INVALID_NUMBER ? 0 :
+      FreeSpaceMap::categoryOf(header.free_space_upper_bound -
+                               header.free_space_lower_bound);
+  free_space_map.set(page_number, category);
+  if (free_space_map.onDisk() && !free_space_map.isMapPage(page_number) &&
+      free_space_map.store(page_number, category)) {
+    // The entry shares its byte with the page next to it.
+    const PageId map_page = free_space_map.mapPageOf(page_number);
+    const PageId first = page_number - (page_number - map_page - 1) % 2;
+    const unsigned char entries = free_space_map.stored(first) |
+        free_space_map.stored(first + 1) << 4;
+    writeAt(&entries, 1, pagePosition(map_page) + sizeof(PageHeader) +
+            (first - map_page - 1) / 2);
+  }
+}
+
+PageId PageFile::findPageWithSpace(const std::size_t record_size) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  return loadFreeSpaceMap().find(
+      FreeSpaceMap::categoryFor(record_size + sizeof(PageSlot)));
+}
+
+void PageFile::setFreeSpace(const PageId page_number,
+                            const std::size_t free_space) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  loadFreeSpaceMap().set(page_number, FreeSpaceMap::categoryOf(free_space));
+}
+
 FileIterator PageFile::begin() {
   const FileHeader& header = readHeader();
   return FileIterator(this, header.first_used_page);
@@ -315,33 +897,34 @@ FileIterator PageFile::end() {
 
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  storeFreeSpace(page_number, header);
+  struct iovec iov[2] = {{const_cast<PageHeader*>(&header), sizeof(PageHeader)},
+                         {const_cast<char*>(&new_page.data_[0]),
+                          Page::DATA_SIZE}};
+  writeFully(*descriptor_, iov, 2, pagePosition(page_number), filename_);
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
+  readAt(&header, sizeof(PageHeader), pagePosition(page_number));
   return header;
 }
 
 
 
 
-BlobFile BlobFile::create(const std::string& filename) {
-  return BlobFile(filename, true /* create_new */);
+BlobFile BlobFile::create(const std::string& filename, const bool direct_io) {
+  return BlobFile(filename, true /* create_new */, direct_io);
 }
 
-BlobFile BlobFile::open(const std::string& filename) {
-  return BlobFile(filename, false /* create_new */);
+BlobFile BlobFile::open(const std::string& filename, const bool direct_io) {
+  return BlobFile(filename, false /* create_new */, direct_io);
 }
 
-BlobFile::BlobFile(const std::string& name, const bool create_new)
-: File(name, create_new) {
+BlobFile::BlobFile(const std::string& name, const bool create_new,
+                   const bool direct_io)
+: File(name, create_new, direct_io) {
 }
 
 BlobFile::~BlobFile() {
@@ -362,6 +945,7 @@ BlobFile& BlobFile::operator=(const BlobFile& rhs) {
 }
 
 Page BlobFile::allocatePage(PageId &new_page_number) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
   FileHeader header = readHeader();
 	Page new_page;
 
@@ -381,15 +965,55 @@ Page BlobFile::allocatePage(PageId &new_page_number) {
 
 Page BlobFile::readPage(const PageId page_number) const {
 	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	readPageInto(page_number, page);
 	return page;
 }
 
+void BlobFile::readPageInto(const PageId page_number, Page& page) const {
+	if (page_number == Page::INVALID_NUMBER ||
+	    readAt(&page, Page::SIZE, pagePosition(page_number)) != Page::SIZE) {
+		// past the end of the file, or the header
+		throw InvalidPageException(page_number, filename_);
+	}
+}
+
+void BlobFile::readPagesInto(const PageId first_page_number,
+                             Page* const* pages,
+                             const std::size_t count) const {
+	if (first_page_number == Page::INVALID_NUMBER) {
+		throw InvalidPageException(first_page_number, filename_);
+	}
+	// the pages are read where they are in one go
+	std::vector<struct iovec> iov(count);
+	for (std::size_t i = 0; i < count; ++i) {
+		iov[i].iov_base = pages[i];
+		iov[i].iov_len = Page::SIZE;
+	}
+	const std::size_t read = readFully(*descriptor_, &iov[0], iov.size(),
+	                                   pagePosition(first_page_number));
+	if (read < count * Page::SIZE) {
+		// past the end of the file
+		throw InvalidPageException(first_page_number + read / Page::SIZE,
+		                           filename_);
+	}
+}
+
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+	std::lock_guard<std::recursive_mutex> guard(*latch_);
+	writeAt(&new_page, Page::SIZE, pagePosition(new_page_number));
+}
+
+void BlobFile::writePages(const PageId first_page_number,
+                          const Page* const* pages, const std::size_t count) {
+	std::lock_guard<std::recursive_mutex> guard(*latch_);
+	// the pages go where they are in one go
+	std::vector<struct iovec> iov(count);
+	for (std::size_t i = 0; i < count; ++i) {
+		iov[i].iov_base = const_cast<Page*>(pages[i]);
+		iov[i].iov_len = Page::SIZE;
+	}
+	writeFully(*descriptor_, &iov[0], iov.size(),
+	           pagePosition(first_page_number), filename_);
 }
 
 //delePage should not be called for a blob_file, not supported
@@ -397,4 +1021,77 @@ void BlobFile::deletePage(const PageId page_number) {
 	throw InvalidPageException(page_number, filename_);
 }
 
+
+
+
+MappedBlobFile::MappedBlobFile(const std::string& name,
+                               const AccessPattern pattern)
+    : filename_(name), base_(NULL), length_(0), first_page_position_(0),
+      num_pages_(0) {
+  const int fd = ::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw FileNotFoundException(name);
+  }
+  struct stat status;
+  void* base = MAP_FAILED;
+  if (::fstat(fd, &status) == 0 &&
+      status.st_size >= (off_t) LEGACY_HEADER_SIZE) {
+    length_ = status.st_size;
+    base = ::mmap(NULL, length_, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  // The mapping outlives the descriptor.
+  ::close(fd);
+  if (base == MAP_FAILED) {
+    throw FileNotFoundException(name);
+  }
+  base_ = static_cast<const char*>(base);
+  first_page_position_ = firstPagePositionOf(status.st_size);
+
+  // The file does not change while it is mapped, so neither does its header.
+  // Pages past the end of the file, should it have been cut short, are not
+  // counted.
+  FileHeader header;
+  std::memcpy(&header, base_, LEGACY_HEADER_SIZE);
+  const std::size_t first = first_page_position_;
+  const std::size_t pages_mapped =
+      length_ > first ? (length_ - first) / Page::SIZE + 1 : 1;
+  num_pages_ = std::min<std::size_t>(header.num_pages, pages_mapped);
+  advise(pattern);
+}
+
+MappedBlobFile::~MappedBlobFile() {
+  ::munmap(const_cast<char*>(base_), length_);
+}
+
+void MappedBlobFile::advise(const AccessPattern pattern) {
+  int advice = MADV_NORMAL;
+  if (pattern == ACCESS_RANDOM) {
+    advice = MADV_RANDOM;
+  } else if (pattern == ACCESS_SEQUENTIAL) {
+    advice = MADV_SEQUENTIAL;
+  }
+  ::madvise(const_cast<char*>(base_), length_, advice);
+}
+
+void MappedBlobFile::willNeed(const PageId first_page_number,
+                              const std::size_t count) {
+  if (first_page_number == Page::INVALID_NUMBER ||
+      first_page_number >= num_pages_) {
+    return;
+  }
+  // madvise() wants a range starting on a memory page boundary.
+  const std::size_t memory_page = ::sysconf(_SC_PAGESIZE);
+  const std::size_t first =
+      first_page_position_ + (first_page_number - 1) * Page::SIZE;
+  const std::size_t last = std::min<std::size_t>(
+      first_page_position_ +
+          (first_page_number - 1 + count) * Page::SIZE, length_);
+  const std::size_t start = first - first % memory_page;
+  ::madvise(const_cast<char*>(base_) + start, last - start, MADV_WILLNEED);
+}
+
+void MappedBlobFile::throwInvalidPage(const PageId page_number) const {
+  throw InvalidPageException(page_number, filename_);
+}
+
 }
@@ -7,10 +7,13 @@
 
 #pragma once
 
-#include <fstream>
 #include <string>
 #include <map>
+#include <set>
+#include <vector>
 #include <memory>
+#include <mutex>
+#include <sys/types.h>
 
 #include "page.h"
 
@@ -42,6 +45,22 @@ struct FileHeader {
    */
   PageId first_free_page;
 
+  /**
+   * Page number of the last used page in the file, so that a page can be
+   * added to the end of the used list without walking it.  Only the header of
+   * page-aligned files (see File) has room for it; it reads as
+   * Page::INVALID_NUMBER, while first_used_page does not, when the file does
+   * not keep it.
+   */
+  PageId last_used_page;
+
+  /**
+   * Page number of the first free-space map page of a PageFile, or
+   * Page::INVALID_NUMBER if the file keeps no map on disk.  Only page-aligned
+   * files created with one have it.
+   */
+  PageId free_space_map;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -52,40 +71,366 @@ struct FileHeader {
     return num_pages == rhs.num_pages &&
         num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        first_free_page == rhs.first_free_page &&
+        last_used_page == rhs.last_used_page &&
+        free_space_map == rhs.free_space_map;
+  }
+};
+
+/**
+ * @brief Pages of a PageFile not in its used list, free pages and free-space
+ *        map pages, as runs of consecutive page numbers sorted by number, kept
+ *        in memory while the file is open.
+ *
+ * The used list of a PageFile is sorted by page number, so the used pages
+ * closest to any page are found from the runs around it without reading the
+ * used list.  Built from the free list of the file the first time it is
+ * needed.
+ */
+class FreeExtents {
+ public:
+  FreeExtents() : loaded_(false) {}
+
+  /**
+   * Returns true once the free pages of the file have been added.
+   */
+  bool loaded() const { return loaded_; }
+
+  /**
+   * Records that the free pages of the file have all been added.
+   */
+  void setLoaded() { loaded_ = true; }
+
+  /**
+   * Adds a free page, merging the runs on either side of it.
+   *
+   * @param page_number   Number of page freed.
+   */
+  void add(const PageId page_number);
+
+  /**
+   * Removes a free page that is about to be used, splitting its run.
+   *
+   * @param page_number   Number of page no longer free.
+   */
+  void remove(const PageId page_number);
+
+  /**
+   * Finds the used pages closest to a page, used or not.
+   *
+   * @param page_number   Number of page.
+   * @param num_pages     Number of pages allocated in the file.
+   * @param previous      Number of the last used page before it, or
+   *                      Page::INVALID_NUMBER if there is none, returned via
+   *                      this variable.
+   * @param next          Number of the first used page after it, or
+   *                      Page::INVALID_NUMBER if there is none, returned via
+   *                      this variable.
+   */
+  void neighbours(const PageId page_number, const PageId num_pages,
+                  PageId& previous, PageId& next) const;
+
+ private:
+  /**
+   * Finds the run a page is in.
+   *
+   * @param page_number   Number of page.
+   * @param first         First page of the run, returned via this variable.
+   * @param last          Last page of the run, returned via this variable.
+   * @return  True if the page is in a run.
+   */
+  bool find(const PageId page_number, PageId& first, PageId& last) const;
+
+  /**
+   * Last page of each run of free pages, by first page.
+   */
+  std::map<PageId, PageId> extents_;
+
+  /**
+   * Whether the free pages of the file have all been added.
+   */
+  bool loaded_;
+};
+
+/**
+ * @brief How much free space each page of a PageFile has, in coarse
+ *        categories, kept in memory while the file is open.
+ *
+ * A page in category c has at least c * CATEGORY_SIZE bytes free, so a page
+ * with room for a record is found with one lookup per category instead of by
+ * reading pages.  Free pages are in category 0, and so never found.
+ *
+ * Files that keep the map on disk have a map page in front of every
+ * ENTRIES_PER_PAGE pages, holding their categories after a page header that
+ * marks it unused.  The category last written there is kept apart, so that
+ * entries are only written when they change.
+ */
+class FreeSpaceMap {
+ public:
+  /**
+   * Number of categories; one fits in 4 bits.
+   */
+  static const std::uint8_t CATEGORIES = 16;
+
+  /**
+   * Bytes of free space each category stands for.
+   */
+  static const std::size_t CATEGORY_SIZE = Page::SIZE / CATEGORIES;
+
+  /**
+   * Number of pages each map page holds the category of, two to a byte.
+   */
+  static const PageId ENTRIES_PER_PAGE = (Page::SIZE - sizeof(PageHeader)) * 2;
+
+  FreeSpaceMap()
+      : first_map_page_(Page::INVALID_NUMBER),
+        loaded_(false) {}
+
+  /**
+   * Returns the category of a page with the given free space.
+   *
+   * @param free_space  Bytes free in the page.
+   * @return  Category, rounded down.
+   */
+  static std::uint8_t categoryOf(const std::size_t free_space) {
+    const std::size_t category = free_space / CATEGORY_SIZE;
+    return category < CATEGORIES ? category : CATEGORIES - 1;
+  }
+
+  /**
+   * Returns the category a page needs to be in to be sure to have the given
+   * free space.
+   *
+   * @param free_space  Bytes needed.
+   * @return  Category, rounded up.
+   */
+  static std::uint8_t categoryFor(const std::size_t free_space) {
+    return (free_space + CATEGORY_SIZE - 1) / CATEGORY_SIZE;
+  }
+
+  /**
+   * Returns true once every page of the file has been added.
+   */
+  bool loaded() const { return loaded_; }
+
+  /**
+   * Records that every page of the file has been added.
+   *
+   * @param first_map_page  Number of the first map page of the file, or
+   *                        Page::INVALID_NUMBER if it keeps no map on disk.
+   */
+  void setLoaded(const PageId first_map_page) {
+    first_map_page_ = first_map_page;
+    loaded_ = true;
+  }
+
+  /**
+   * Returns true if the file keeps the map on disk.
+   */
+  bool onDisk() const { return first_map_page_ != Page::INVALID_NUMBER; }
+
+  /**
+   * Returns true if a page of the file is a map page.
+   *
+   * @param page_number   Number of page.
+   */
+  bool isMapPage(const PageId page_number) const {
+    return onDisk() && page_number >= first_map_page_ &&
+        (page_number - first_map_page_) % (ENTRIES_PER_PAGE + 1) == 0;
+  }
+
+  /**
+   * Returns the map page holding the category of a page, which must not be a
+   * map page itself.
+   *
+   * @param page_number   Number of page.
+   */
+  PageId mapPageOf(const PageId page_number) const {
+    return page_number - 1 -
+        (page_number - 1 - first_map_page_) % (ENTRIES_PER_PAGE + 1);
+  }
+
+  /**
+   * Sets the category of a page.
+   *
+   * @param page_number   Number of page.
+   * @param category      Category of the page.
+   */
+  void set(const PageId page_number, const std::uint8_t category);
+
+  /**
+   * Sets the category of a page as written to disk.
+   *
+   * @param page_number   Number of page.
+   * @param category      Category written.
+   * @return  True if that changes the category on disk.
+   */
+  bool store(const PageId page_number, const std::uint8_t category);
+
+  /**
+   * Returns the category of a page as written to disk, 0 if never written.
+   *
+   * @param page_number   Number of page.
+   */
+  std::uint8_t stored(const PageId page_number) const {
+    return page_number < stored_.size() ? stored_[page_number] : 0;
   }
+
+  /**
+   * Finds the lowest numbered page in at least the given category.
+   *
+   * @param category  Category needed.
+   * @return  Number of page found, or Page::INVALID_NUMBER if there is none.
+   */
+  PageId find(const std::uint8_t category) const;
+
+ private:
+  /**
+   * Category of each page, by page number.
+   */
+  std::vector<std::uint8_t> categories_;
+
+  /**
+   * Category of each page as written to disk, by page number.
+   */
+  std::vector<std::uint8_t> stored_;
+
+  /**
+   * Pages in each category but 0.
+   */
+  std::set<PageId> pages_[CATEGORIES];
+
+  /**
+   * Number of the first map page of the file.
+   */
+  PageId first_map_page_;
+
+  /**
+   * Whether every page of the file has been added.
+   */
+  bool loaded_;
+};
+
+/**
+ * @brief Descriptor of an open file on disk, closed once the last File object
+ *        using it is gone, with how the file is laid out and accessed.
+ */
+class FileDescriptor {
+ public:
+  /**
+   * Takes ownership of an open file descriptor.
+   *
+   * @param fd                    File descriptor.
+   * @param first_page_position   Offset of page 1 from the beginning of the
+   *                              file.
+   * @param direct                Whether the file was opened for direct I/O.
+   */
+  FileDescriptor(const int fd, const off_t first_page_position,
+                 const bool direct)
+      : fd_(fd), first_page_position_(first_page_position), direct_(direct) {}
+
+  /**
+   * Closes the file descriptor.
+   */
+  ~FileDescriptor();
+
+  /**
+   * Returns the file descriptor.
+   */
+  int fd() const { return fd_; }
+
+  /**
+   * Returns the offset of page 1 from the beginning of the file.
+   */
+  off_t firstPagePosition() const { return first_page_position_; }
+
+  /**
+   * Returns true if the file was opened for direct I/O (O_DIRECT).
+   */
+  bool direct() const { return direct_; }
+
+  /**
+   * Returns the free pages of the file, if it is a PageFile.  Shared by every
+   * File object for the file, and latched like its writes.
+   */
+  FreeExtents& freeExtents() { return free_extents_; }
+
+  /**
+   * Returns the free space of the pages of the file, if it is a PageFile.
+   * Shared and latched like freeExtents().
+   */
+  FreeSpaceMap& freeSpaceMap() { return free_space_map_; }
+
+ private:
+  const int fd_;
+  const off_t first_page_position_;
+  const bool direct_;
+  FreeExtents free_extents_;
+  FreeSpaceMap free_space_map_;
+
+  FileDescriptor(const FileDescriptor&);
+  FileDescriptor& operator=(const FileDescriptor&);
 };
 
 /**
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
- * fixed-sized pages, and they never deallocate space (though they do reuse
- * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * The File class wraps a descriptor of an underlying file on disk.  Files
+ * contain fixed-sized pages, and they never deallocate space (though they do
+ * reuse deleted pages if possible).  If multiple File objects refer to the
+ * same underlying file, they will share the descriptor.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * detects this (by looking in the open_descriptors_ map) and just returns a file object with
+ * the already opened descriptor for the file without actually opening the UNIX file again.
+ *
+ * Pages are read and written with positional I/O (pread and pwrite), which
+ * has no shared file offset, so several threads (e.g. through the buffer
+ * manager) may read pages of one file at the same time without holding any
+ * latch.  Writes, and operations that read and update several pages such as
+ * allocating or deleting a page, are serialized by a latch which is shared,
+ * like the descriptor, by all File objects for the same underlying file.  A
+ * page must not be read while it is being written; the buffer manager never
+ * does, as it only reads pages it does not hold.  Opening and closing files is
+ * also latched.
+ *
+ * Files created now keep their header in a slot of a whole page, so that every
+ * page starts at a multiple of Page::SIZE.  Files of the earlier layout, in
+ * which the first page follows the header directly, are told apart by their
+ * size and still read and written.
  *
- * @warning This class is not threadsafe.
+ * A file may be opened for direct I/O, which bypasses the kernel page cache
+ * so that pages the buffer manager holds are not cached a second time by the
+ * kernel.  Reads and writes of whole pages to and from memory aligned on
+ * DIRECT_IO_ALIGNMENT bytes, such as buffer pool frames (see readPageInto()),
+ * then go straight to the disk; anything else goes through an aligned buffer.
+ * Files of the earlier layout, and files on filesystems without direct I/O,
+ * are opened for buffered I/O instead.  Every File object for the same
+ * underlying file accesses it the way the first one opened it.
  */
 
 
 class File {
  public:
+  /**
+   * Alignment of the memory, positions and sizes that direct I/O requires.
+   */
+  static const std::size_t DIRECT_IO_ALIGNMENT = 4096;
 
   /**
    * Constructs a file object representing a file on the filesystem.
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param direct_io   Whether to bypass the kernel page cache, if the file is
+   *                    not open already.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new,
+       const bool direct_io = false);
 
   /**
    * Deletes an existing file.
@@ -134,15 +479,58 @@ class File {
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
+  /**
+   * Reads an existing page from the file into the given page, rather than
+   * returning a copy of it.  With direct I/O, a page aligned on
+   * DIRECT_IO_ALIGNMENT bytes is read from the disk straight into place.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  virtual void readPageInto(const PageId page_number, Page& page) const = 0;
+
+  /**
+   * Reads existing pages at consecutive page numbers into the given pages.
+   * Files that can read such a run with a single read of the underlying file
+   * do so; by default the pages are read one by one with readPageInto().
+   *
+   * @param first_page_number Number of page to read into pages[0].
+   * @param pages             Pages to read into.
+   * @param count             Number of pages to read.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or is not currently used, in which
+   *                                case the pages after it may not be read.
+   */
+  virtual void readPagesInto(const PageId first_page_number,
+                             Page* const* pages, const std::size_t count) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
    *
    * @param page_number Number of page whose contents to replace.
    * @param new_page    Page to write.
+   * @throws  FileIOException  If the operating system fails the write.
    */
   virtual void writePage(const PageId page_number, const Page& new_page) = 0;
 
+  /**
+   * Writes pages into the file at consecutive page numbers.  Files that can
+   * write such a run with a single write to the underlying file do so; by
+   * default the pages are written one by one with writePage().
+   * No bounds checking is performed.
+   *
+   * @param first_page_number Number of page whose contents to replace with
+   *                          pages[0].
+   * @param pages             Pages to write.
+   * @param count             Number of pages to write.
+   * @throws  FileIOException   If the operating system fails the write.
+   */
+  virtual void writePages(const PageId first_page_number,
+                          const Page* const* pages, const std::size_t count);
+
   /**
    * Deletes a page from the file.
    *
@@ -164,6 +552,11 @@ class File {
    */
 	PageId getFirstPageNo();
 
+  /**
+   * Returns true if the file is accessed with direct I/O.
+   */
+  bool isDirect() const { return descriptor_->direct(); }
+
  protected:
   /**
    * Returns the position of the page with the given number in the file (as an
@@ -172,25 +565,27 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+  off_t pagePosition(const PageId page_number) const {
+    return descriptor_->firstPagePosition() +
+        (off_t) (page_number - 1) * Page::SIZE;
   }
 
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing descriptor.
    *
    * @param create_new  Whether to create a new file.
+   * @param direct_io   Whether to open the file for direct I/O.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  void openIfNeeded(const bool create_new);
+  void openIfNeeded(const bool create_new, const bool direct_io = false);
 
   /**
-   * Closes the underlying file stream in <stream_>.
+   * Closes the underlying file descriptor in <descriptor_>.
    * This method only closes the file if no other File objects exist that access
    * the same file.
    */
@@ -210,28 +605,82 @@ class File {
    */
   void writeHeader(const FileHeader& header);
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
+  /**
+   * Returns the number of header bytes on disk, which is less than
+   * sizeof(FileHeader) for files of the earlier layout.
+   */
+  std::size_t headerSize() const;
+
+  /**
+   * Reads from the file at the given position, retrying reads cut short.
+   * Takes no latch.  With direct I/O, the blocks the bytes fall in are read
+   * through an aligned buffer unless buffer, size and position are all
+   * aligned.
+   *
+   * @param buffer    Buffer to read into.
+   * @param size      Number of bytes to read.
+   * @param position  Offset from the beginning of the file.
+   * @return  Number of bytes read, less than size only at the end of the file
+   *          or if the read failed.
+   */
+  std::size_t readAt(void* buffer, const std::size_t size,
+                     const off_t position) const;
+
+  /**
+   * Writes to the file at the given position, retrying writes cut short or
+   * interrupted.  With direct I/O, the blocks the
+   * bytes fall in are written through an aligned buffer, with the rest of
+   * their contents read first, unless buffer, size and position are all
+   * aligned; the caller holds the latch.
+   *
+   * @param buffer    Bytes to write.
+   * @param size      Number of bytes to write.
+   * @param position  Offset from the beginning of the file.
+   * @throws  FileIOException  If the operating system fails the write.
+   */
+  void writeAt(const void* buffer, const std::size_t size,
+               const off_t position);
+
+  typedef std::map<std::string, std::shared_ptr<FileDescriptor> > DescriptorMap;
   typedef std::map<std::string, int> CountMap;
+  typedef std::map<std::string, std::shared_ptr<std::recursive_mutex> > LatchMap;
 
   /**
-   * Streams for opened files.
+   * Descriptors of opened files.
    */
-  static StreamMap open_streams_;
+  static DescriptorMap open_descriptors_;
 
   /**
    * Counts for opened files.
    */
   static CountMap open_counts_;
 
+  /**
+   * Latches for opened files, one per underlying file.
+   */
+  static LatchMap open_latches_;
+
+  /**
+   * Protects open_descriptors_, open_counts_ and open_latches_.
+   */
+  static std::mutex open_files_latch_;
+
   /**
    * Name of the file this object represents.
    */
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Descriptor of underlying filesystem object.
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::shared_ptr<FileDescriptor> descriptor_;
+
+  /**
+   * Latch serializing writes to <descriptor_>.  Recursive, since composite
+   * operations such as allocating a page hold it while calling the single page
+   * helpers.
+   */
+  std::shared_ptr<std::recursive_mutex> latch_;
 
   friend class FileIterator;
 };
@@ -243,33 +692,41 @@ class PageFile : public File {
    * Creates a new file.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the kernel page cache.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static PageFile create(const std::string& filename);
+  static PageFile create(const std::string& filename,
+                         const bool direct_io = false);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same file descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_descriptors_ map.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the kernel page cache, if the file is
+   *                  not open already.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
    */
-  static PageFile open(const std::string& filename);
+  static PageFile open(const std::string& filename,
+                       const bool direct_io = false);
 
   /**
    * Constructs a file object representing a file on the filesystem.
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param direct_io   Whether to bypass the kernel page cache, if the file is
+   *                    not open already.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  PageFile(const std::string& name, const bool create_new);
+  PageFile(const std::string& name, const bool create_new,
+           const bool direct_io = false);
 
   /**
    * Copy constructor.
@@ -310,6 +767,29 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file into the given page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPageInto(const PageId page_number, Page& page) const;
+
+  /**
+   * Reads existing pages at consecutive page numbers into the given pages,
+   * with a single read from the underlying file.
+   *
+   * @param first_page_number Number of page to read into pages[0].
+   * @param pages             Pages to read into.
+   * @param count             Number of pages to read.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  void readPagesInto(const PageId first_page_number, Page* const* pages,
+                     const std::size_t count) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -319,6 +799,22 @@ class PageFile : public File {
    */
   void writePage(const PageId page_number, const Page& new_page);
 
+  /**
+   * Writes pages into the file at consecutive page numbers, with a single
+   * write to the underlying file.  As with writePage(), the pages on disk
+   * keep their next page pointers.
+   * No bounds checking is performed.
+   *
+   * @param first_page_number Number of page whose contents to replace with
+   *                          pages[0].
+   * @param pages             Pages to write.
+   * @param count             Number of pages to write.
+   * @throws  InvalidPageException  If any of the pages has been deleted, in
+   *                                which case none of them is written.
+   */
+  void writePages(const PageId first_page_number, const Page* const* pages,
+                  const std::size_t count);
+
   /**
    * Deletes a page from the file.
    *
@@ -326,6 +822,29 @@ class PageFile : public File {
    */
   void deletePage(const PageId page_number);
 
+  /**
+   * Finds a used page that the free-space map says has room for a record.
+   * The map is only as current as the last call to setFreeSpace() or write of
+   * the page, so the page may turn out to be short of space.
+   *
+   * @param record_size   Length of the record in bytes.
+   * @return  Number of page found, or Page::INVALID_NUMBER if no page is known
+   *          to have room.
+   */
+  PageId findPageWithSpace(const std::size_t record_size);
+
+  /**
+   * Records the free space of a page changed in memory, for
+   * findPageWithSpace().  Only the map kept in memory changes; the map pages
+   * on disk follow when the page itself is written, so after a crash they
+   * may be as stale as the pages that were not written back.  The map is a
+   * hint either way: a page it points to is checked for room before use.
+   *
+   * @param page_number   Number of page.
+   * @param free_space    Bytes free in the page.
+   */
+  void setFreeSpace(const PageId page_number, const std::size_t free_space);
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -347,14 +866,13 @@ class PageFile : public File {
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed beyond the end of the file.
    *
    * @param page_number   Number of page to read.
    * @param allow_free    Whether to allow reading a free (unused) page.
    * @return  The page.
-   * @throws  InvalidPageException  If the page is free (unused) and
-   *                                allow_free is false.
+   * @throws  InvalidPageException  If the page is past the end of the file, or
+   *                                is free (unused) and allow_free is false.
    */
   Page readPage(const PageId page_number, const bool allow_free) const;
 
@@ -379,6 +897,43 @@ class PageFile : public File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Returns the last page of the used list, finding it from the free pages
+   * if the header does not know it.
+   *
+   * @param header  Header of this file, updated with the page found.
+   * @return  Number of the last used page, or Page::INVALID_NUMBER if no page
+   *          is used.
+   */
+  PageId lastUsedPage(FileHeader& header);
+
+  /**
+   * Returns the free pages of this file, reading the free list for them the
+   * first time they are needed while it is open.
+   *
+   * @param header  Header of this file.
+   * @return  Free pages of the file.
+   */
+  FreeExtents& loadFreeExtents(const FileHeader& header);
+
+  /**
+   * Returns the free space of the pages of this file, reading the map pages
+   * for it the first time it is needed while it is open, or the used pages
+   * if the file keeps no map on disk.
+   *
+   * @return  Free space of the pages of the file.
+   */
+  FreeSpaceMap& loadFreeSpaceMap();
+
+  /**
+   * Records the free space of a page about to be written, on disk too if the
+   * file keeps a map there and its category changes.
+   *
+   * @param page_number   Number of page.
+   * @param header        Header of page to write.
+   */
+  void storeFreeSpace(const PageId page_number, const PageHeader& header);
+
   friend class FileIterator;
 };
 
@@ -389,21 +944,26 @@ class BlobFile : public File {
    * Creates a new BlobFile.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the kernel page cache.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static BlobFile create(const std::string& filename);
+  static BlobFile create(const std::string& filename,
+                         const bool direct_io = false);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same file descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_descriptors_ map.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the kernel page cache, if the file is
+   *                  not open already.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
    */
-  static BlobFile open(const std::string& filename);
+  static BlobFile open(const std::string& filename,
+                       const bool direct_io = false);
 
   /**
    * Constructs a file object representing a file on the filesystem.
@@ -412,12 +972,15 @@ class BlobFile : public File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param direct_io   Whether to bypass the kernel page cache, if the file is
+   *                    not open already.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  BlobFile(const std::string& name, const bool create_new);
+  BlobFile(const std::string& name, const bool create_new,
+           const bool direct_io = false);
 
   /**
    * Copy constructor.
@@ -458,6 +1021,29 @@ class BlobFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file into the given page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPageInto(const PageId page_number, Page& page) const;
+
+  /**
+   * Reads existing pages at consecutive page numbers into the given pages,
+   * with a single read from the underlying file.
+   *
+   * @param first_page_number Number of page to read into pages[0].
+   * @param pages             Pages to read into.
+   * @param count             Number of pages to read.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  void readPagesInto(const PageId first_page_number, Page* const* pages,
+                     const std::size_t count) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -467,6 +1053,19 @@ class BlobFile : public File {
    */
   void writePage(const PageId page_number, const Page& new_page);
 
+  /**
+   * Writes pages into the file at consecutive page numbers, with a single
+   * write to the underlying file.
+   * No bounds checking is performed.
+   *
+   * @param first_page_number Number of page whose contents to replace with
+   *                          pages[0].
+   * @param pages             Pages to write.
+   * @param count             Number of pages to write.
+   */
+  void writePages(const PageId first_page_number, const Page* const* pages,
+                  const std::size_t count);
+
   /**
    * Deletes a page from the file.
    *
@@ -475,4 +1074,117 @@ class BlobFile : public File {
   void deletePage(const PageId page_number);
 };
 
+/**
+ * @brief How the pages of a mapped file are going to be accessed, passed on to
+ *        the kernel as a hint for how much to read ahead.
+ */
+enum AccessPattern {
+  ACCESS_NORMAL,      /* Read ahead moderately */
+  ACCESS_RANDOM,      /* Read only the pages touched */
+  ACCESS_SEQUENTIAL   /* Read ahead aggressively, and drop pages read early */
+};
+
+/**
+ * @brief Read-only view of a BlobFile mapped into memory, whose pages are used
+ *        in place without being read into the buffer pool.
+ *
+ * Meant for read-only replicas of index files: a page is a pointer into the
+ * mapping, and the kernel pages it in and out as it would any file data.  The
+ * file must not be changed, through a BlobFile or otherwise, while it is
+ * mapped.  Files of both layouts (see File) can be mapped.
+ */
+class MappedBlobFile {
+ public:
+  /**
+   * Maps an existing BlobFile.
+   *
+   * @param name      Name of file.
+   * @param pattern   How the pages will be accessed.
+   * @throws  FileNotFoundException   If the file doesn't exist or cannot be
+   *                                  mapped.
+   */
+  MappedBlobFile(const std::string& name,
+                 const AccessPattern pattern = ACCESS_RANDOM);
+
+  /**
+   * Unmaps the file.
+   */
+  ~MappedBlobFile();
+
+  /**
+   * Returns the page with the given number, in place.
+   *
+   * @param page_number   Number of page.
+   * @return  The page, valid for as long as the file is mapped.
+   * @throws  InvalidPageException  If the page doesn't exist in the file.
+   */
+  const Page* page(const PageId page_number) const {
+    if (page_number == Page::INVALID_NUMBER || page_number >= num_pages_) {
+      throwInvalidPage(page_number);
+    }
+    return reinterpret_cast<const Page*>(
+        base_ + first_page_position_ + (page_number - 1) * Page::SIZE);
+  }
+
+  /**
+   * Tells the kernel how the pages will be accessed from now on.
+   *
+   * @param pattern   How the pages will be accessed.
+   */
+  void advise(const AccessPattern pattern);
+
+  /**
+   * Asks the kernel to start reading pages that are about to be accessed, as
+   * BufMgr::prefetchPages() does for files read through the buffer pool.
+   *
+   * @param first_page_number   Number of the first page to read.
+   * @param count               Number of pages to read.
+   */
+  void willNeed(const PageId first_page_number, const std::size_t count);
+
+  /**
+   * Returns the number of pages of the file, counting the header.
+   */
+  PageId numPages() const { return num_pages_; }
+
+  /**
+   * Returns the name of the file mapped.
+   */
+  const std::string& filename() const { return filename_; }
+
+ private:
+  /**
+   * Throws InvalidPageException for a page of this file.
+   */
+  void throwInvalidPage(const PageId page_number) const;
+
+  /**
+   * Name of the file mapped.
+   */
+  std::string filename_;
+
+  /**
+   * Start of the mapping.
+   */
+  const char* base_;
+
+  /**
+   * Length of the mapping.
+   */
+  std::size_t length_;
+
+  /**
+   * Offset of page 1 from the beginning of the file.
+   */
+  off_t first_page_position_;
+
+  /**
+   * Number of pages of the file, counting the header.
+   */
+  PageId num_pages_;
+
+  MappedBlobFile(const MappedBlobFile&);
+  MappedBlobFile& operator=(const MappedBlobFile&);
+};
+
 }
@@ -53,8 +53,9 @@ void FileScan::scanNext(RecordId& outRid)
 		}
 	 
 		// read the first page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage); 
+    bufMgr->readPage(file, (*filePageIter).page_number(), curPage, &ring); 
 		curDirtyFlag = false;
+    prefetchNext();
 
 		// get the first record off the page
     pageRecordIter = curPage->begin(); 
@@ -88,7 +89,8 @@ void FileScan::scanNext(RecordId& outRid)
     }
 
     // read the next page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
+    bufMgr->readPage(file, (*filePageIter).page_number(), curPage, &ring);
+    prefetchNext();
 
     // get the first record off the page
     pageRecordIter = curPage->begin(); 
@@ -104,6 +106,14 @@ void FileScan::scanNext(RecordId& outRid)
 	return;
 }
 
+// have the buffer manager read the page following the current one while it is scanned
+void FileScan::prefetchNext()
+{
+  PageId nextPageNo = curPage->next_page_number();
+  if (nextPageNo != Page::INVALID_NUMBER)
+    bufMgr->prefetchPages(file, nextPageNo, 1);
+}
+
 // returns pointer to the current record.  page is left pinned
 // and the scan logic is required to unpin the page 
 std::string FileScan::getRecord()
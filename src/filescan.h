@@ -53,6 +53,11 @@ class FileScan
    */
   Page*         curPage;
 
+  /**
+   * Frames the scan recycles, so that it does not flush the buffer pool.
+   */
+  BufRing       ring;
+
   FileIterator  filePageIter;
   PageIterator  pageRecordIter;
 
@@ -60,6 +65,11 @@ class FileScan
    * True if page has been updated
    */
   bool  	      curDirtyFlag;
+
+  /**
+   * Asks the buffer manager to read ahead the page following the current page in the file.
+   */
+  void prefetchNext();
 };
 
 }
@@ -0,0 +1,66 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "histogram.h"
+
+namespace badgerdb {
+
+const std::uint32_t Histogram::SUB_BUCKETS;
+
+Histogram & Histogram::operator+=(const Histogram & other)
+{
+	if (other.counts.size() > counts.size())
+		counts.resize(other.counts.size(), 0);
+	for (std::size_t b = 0; b < other.counts.size(); b++)
+		counts[b] += other.counts[b];
+	total += other.total;
+	sum += other.sum;
+	if (other.maxValue > maxValue)
+		maxValue = other.maxValue;
+	return *this;
+}
+
+void Histogram::clear()
+{
+	counts.clear();
+	total = sum = maxValue = 0;
+}
+
+std::uint64_t Histogram::percentile(const double percent) const
+{
+	if (total == 0)
+		return 0;
+
+	// the rank of the value asked for, counting from 1
+	std::uint64_t rank = (std::uint64_t) (percent / 100 * total + 0.5);
+	if (rank < 1)
+		rank = 1;
+
+	std::uint64_t seen = 0;
+	for (std::uint32_t b = 0; b < counts.size(); b++)
+	{
+		seen += counts[b];
+		if (seen >= rank)
+		{
+			// the highest value of the bucket, unless no value that high was counted
+			const std::uint64_t high = bucketLow(b + 1) - 1;
+			return high < maxValue ? high : maxValue;
+		}
+	}
+	return maxValue;
+}
+
+void Histogram::buckets(std::vector<std::pair<std::uint64_t, std::uint64_t> > & out) const
+{
+	for (std::uint32_t b = 0; b < counts.size(); b++)
+	{
+		if (counts[b] > 0)
+			out.push_back(std::make_pair(bucketLow(b), counts[b]));
+	}
+}
+
+}
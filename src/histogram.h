@@ -0,0 +1,140 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+* @brief Distribution of non-negative values, such as latencies, kept in buckets that widen with the values.
+*
+* As in HdrHistogram, each power of two is split into SUB_BUCKETS buckets of equal width, so a value is known to
+* within 1/SUB_BUCKETS of itself whatever its magnitude, and values below 2 * SUB_BUCKETS are counted exactly.
+* Recording is a handful of instructions.  Histograms add up, so that per-shard ones can be merged.
+*/
+class Histogram {
+
+ public:
+	/**
+   * Number of buckets each power of two is split into
+	 */
+  static const std::uint32_t SUB_BUCKETS = 16;
+
+	/**
+   * Constructor of Histogram class; the histogram is empty
+	 */
+  Histogram()
+  	: total(0), sum(0), maxValue(0)
+  {
+  }
+
+	/**
+	 * Counts a value.
+	 */
+  void record(const std::uint64_t value)
+  {
+		const std::uint32_t b = bucketOf(value);
+		if (b >= counts.size())
+			counts.resize(b + 1, 0);
+		counts[b]++;
+		total++;
+		sum += value;
+		if (value > maxValue)
+			maxValue = value;
+  }
+
+	/**
+	 * Adds the values counted by another histogram to this one.
+	 */
+  Histogram & operator+=(const Histogram & other);
+
+	/**
+	 * Forgets all the values counted.
+	 */
+  void clear();
+
+	/**
+   * Returns the number of values counted
+	 */
+  std::uint64_t count() const
+  {
+		return total;
+  }
+
+	/**
+   * Returns the largest value counted, 0 if none
+	 */
+  std::uint64_t max() const
+  {
+		return maxValue;
+  }
+
+	/**
+   * Returns the mean of the values counted, 0 if none
+	 */
+  double mean() const
+  {
+		return total > 0 ? (double) sum / total : 0;
+  }
+
+	/**
+	 * Returns a value that the given percentage of the values counted are no larger than, to within the width of
+	 * its bucket; 0 if the histogram is empty.
+	 *
+	 * @param percent		Between 0 and 100
+	 */
+  std::uint64_t percentile(const double percent) const;
+
+	/**
+	 * Lists the buckets holding values, lowest first.
+	 *
+	 * @param out  			Smallest value of each bucket and number of values in it, appended to this vector
+	 */
+  void buckets(std::vector<std::pair<std::uint64_t, std::uint64_t> > & out) const;
+
+ private:
+	/**
+   * Returns the bucket a value falls in
+	 */
+  static std::uint32_t bucketOf(const std::uint64_t value)
+  {
+		if (value < 2 * SUB_BUCKETS)
+			return (std::uint32_t) value;
+		// shift keeps the top five bits of the value, the highest of which is always set
+		const std::uint32_t shift = 63 - __builtin_clzll(value) - 4;
+		return (shift + 1) * SUB_BUCKETS + (std::uint32_t) (value >> shift) - SUB_BUCKETS;
+  }
+
+	/**
+   * Returns the smallest value of a bucket
+	 */
+  static std::uint64_t bucketLow(const std::uint32_t b)
+  {
+		if (b < 2 * SUB_BUCKETS)
+			return b;
+		const std::uint32_t shift = b / SUB_BUCKETS - 1;
+		return (std::uint64_t) (b % SUB_BUCKETS + SUB_BUCKETS) << shift;
+  }
+
+	/**
+   * Number of values in each bucket, up to the highest bucket holding any
+	 */
+  std::vector<std::uint64_t> counts;
+
+	/**
+   * Number, sum and largest of the values counted
+	 */
+  std::uint64_t total;
+  std::uint64_t sum;
+  std::uint64_t maxValue;
+};
+
+}
@@ -0,0 +1,159 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace badgerdb {
+
+/**
+* @brief Reader/writer latch protecting the contents of a buffer frame.
+*
+* Any number of threads can hold the latch shared, or one thread can hold it exclusive.  Latches are only held for
+* short stretches by threads that already have the page pinned, so waiters spin and yield instead of sleeping.  A
+* waiting writer keeps new readers out, so that a steady stream of readers cannot starve it.
+*
+* The latch is not reentrant: a thread must not ask for a latch it already holds.
+*
+* The latch also carries a version, which is odd while a writer holds the latch and moves on every time the
+* contents of the frame may have changed.  A reader can then skip the latch altogether: it notes the version,
+* reads, and validates afterwards that the version is still the one it noted, starting over if it is not.
+*/
+class FrameLatch {
+
+ public:
+	/**
+   * Constructor of FrameLatch class
+	 */
+  FrameLatch()
+  	: state(0), version(0)
+  {
+  }
+
+	/**
+	 * Waits until no writer holds or waits for the latch, then takes it shared.
+	 */
+  void lockShared()
+  {
+		while (true)
+		{
+			std::uint32_t s = state.load(std::memory_order_relaxed);
+			if ((s & (WRITER | WRITER_WAITING)) == 0 &&
+			    state.compare_exchange_weak(s, s + 1, std::memory_order_acquire))
+				return;
+			std::this_thread::yield();
+		}
+  }
+
+	/**
+	 * Releases a shared hold of the latch.
+	 */
+  void unlockShared()
+  {
+		state.fetch_sub(1, std::memory_order_release);
+  }
+
+	/**
+	 * Waits until nobody holds the latch, then takes it exclusive.
+	 */
+  void lockExclusive()
+  {
+		while (true)
+		{
+			std::uint32_t s = state.load(std::memory_order_relaxed);
+			if ((s & ~WRITER_WAITING) == 0)
+			{
+				if (state.compare_exchange_weak(s, WRITER, std::memory_order_acquire))
+				{
+					// odd from now on, before anything is written
+					version.fetch_add(1);
+					return;
+				}
+			}
+			else if ((s & WRITER_WAITING) == 0)
+			{
+				// announce ourselves so that readers arriving from now on wait
+				state.compare_exchange_weak(s, s | WRITER_WAITING, std::memory_order_relaxed);
+			}
+			std::this_thread::yield();
+		}
+  }
+
+	/**
+	 * Releases an exclusive hold of the latch.  Other writers still waiting announce themselves again.
+	 */
+  void unlockExclusive()
+  {
+		version.fetch_add(1, std::memory_order_release);
+		state.store(0, std::memory_order_release);
+  }
+
+	/**
+	 * Returns the current version, to be validated after an optimistic read.  An odd version means a writer
+	 * holds the latch and the read will not validate.
+	 */
+  std::uint64_t readVersion() const
+  {
+		return version.load(std::memory_order_acquire);
+  }
+
+	/**
+	 * Returns true if nothing has changed the frame since readVersion() returned the given version.
+	 */
+  bool validate(const std::uint64_t v) const
+  {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return (v & 1) == 0 && version.load(std::memory_order_relaxed) == v;
+  }
+
+	/**
+	 * Moves the version on without taking the latch, when the buffer manager gives the frame to another page.
+	 * Nobody may hold the latch.
+	 */
+  void bumpVersion()
+  {
+		version.fetch_add(2);
+  }
+
+	/**
+	 * Sets the version of a frame that did not exist before, so that it cannot be mistaken for an earlier frame
+	 * with the same number.  Nobody may hold the latch.
+	 */
+  void resetVersion(const std::uint64_t v)
+  {
+		version.store(v);
+  }
+
+ private:
+	/**
+   * State bit set while a writer holds the latch
+	 */
+  static const std::uint32_t WRITER = 0x80000000;
+
+	/**
+   * State bit set while a writer waits for the latch
+	 */
+  static const std::uint32_t WRITER_WAITING = 0x40000000;
+
+	/**
+   * Writer bits, and the number of readers holding the latch in the remaining bits
+	 */
+  std::atomic<std::uint32_t> state;
+
+	/**
+   * Version of the contents of the frame, odd while a writer holds the latch
+	 */
+  std::atomic<std::uint64_t> version;
+
+  FrameLatch(const FrameLatch &);
+  FrameLatch & operator=(const FrameLatch &);
+};
+
+}
@@ -5,8 +5,15 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <random>
+#include <set>
+#include <thread>
 #include <vector>
 #include "btree.h"
+#include "bufHashTbl.h"
 #include "page.h"
 #include "filescan.h"
 #include "page_iterator.h"
@@ -20,6 +27,11 @@
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
 #include "exceptions/test_exception.h"
+#include "exceptions/hash_already_present_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/file_io_exception.h"
+#include "exceptions/invalid_page_exception.h"
 
 #define checkPassFail(a, b)                                                                                \
 {                                                                                                                                        \
@@ -44,6 +56,8 @@ int testNum = 1;
 const std::string relationName = "relA";
 //If the relation size is changed then the second parameter 2 chechPassFail may need to be changed to number of record that are expected to be found during the scan, else tests will erroneously be reported to have failed.
 const int relationSize = 5000;
+// Number of rids whose records intScan fetches from the relation at once.
+const size_t FETCH_BATCH = 32;
 std::string intIndexName, doubleIndexName, stringIndexName;
 
 // This is the structure for tuples in the base relation
@@ -77,6 +91,22 @@ int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator
 
 void indexTests();
 
+void testPageTable();
+
+void testLegacyFileOpen();
+
+void testUsedPageList();
+
+void testPageSlotChurn();
+
+void testEvictionWriteFailure();
+
+void testRingShrink();
+
+void testRingWriteFailure();
+
+void testReadPagesFailure();
+
 void testIndexCreation();
 
 void testIndexOpen();
@@ -151,6 +181,14 @@ int main(int argc, char **argv) {
 
     File::remove(relationName);
 
+    testPageTable();
+    testLegacyFileOpen();
+    testUsedPageList();
+    testPageSlotChurn();
+    testEvictionWriteFailure();
+    testRingShrink();
+    testRingWriteFailure();
+    testReadPagesFailure();
     testIndexCreation();
     testIndexOpen();
     testRootFill();
@@ -164,6 +202,528 @@ int main(int argc, char **argv) {
     return 1;
 }
 
+// Runs random inserts and removes of pages of two files against a small
+// buffer pool page table and checks every lookup against a std::map, so that
+// probe runs wrap around the table and removes shift them back.
+void testPageTable() {
+    const std::string tableName0 = "relH0";
+    const std::string tableName1 = "relH1";
+    const int tableEntries = 24;
+    const PageId tablePages = 40;
+
+    std::cout << "Testing the buffer pool page table..." << std::endl;
+    bool passed = true;
+    {
+        PageFile tableFile0 = PageFile::create(tableName0);
+        PageFile tableFile1 = PageFile::create(tableName1);
+        const File *files[2] = {&tableFile0, &tableFile1};
+
+        BufHashTbl table(tableEntries);
+        std::map<std::pair<int, PageId>, FrameId> expected;
+        std::minstd_rand rng(1);
+
+        for (int op = 0; op < 20000 && passed; op++) {
+            int f = rng() % 2;
+            PageId pageNo = 1 + rng() % tablePages;
+            std::pair<int, PageId> key(f, pageNo);
+            bool present = expected.count(key) > 0;
+
+            if (present && rng() % 2 == 0) {
+                table.remove(files[f], pageNo);
+                expected.erase(key);
+            } else if (!present && (int) expected.size() < tableEntries) {
+                FrameId frameNo = rng() % tableEntries;
+                table.insert(files[f], pageNo, frameNo);
+                expected[key] = frameNo;
+            } else if (present) {
+                try {
+                    table.insert(files[f], pageNo, 0);
+                    passed = false;
+                } catch (const HashAlreadyPresentException &) {
+                }
+            } else {
+                try {
+                    table.remove(files[f], pageNo);
+                    passed = false;
+                } catch (const HashNotFoundException &) {
+                }
+            }
+
+            // every page of both files, present or not
+            for (int g = 0; g < 2 && passed; g++) {
+                for (PageId p = 1; p <= tablePages; p++) {
+                    std::map<std::pair<int, PageId>, FrameId>::const_iterator it =
+                        expected.find(std::make_pair(g, p));
+                    FrameId frameNo = 0;
+                    bool found = table.lookup(files[g], p, frameNo);
+                    if (found != (it != expected.end()) ||
+                        (found && frameNo != it->second)) {
+                        passed = false;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    File::remove(tableName0);
+    File::remove(tableName1);
+
+    if (!passed) {
+        std::cout << "Page table lookup disagrees with the pages inserted." << std::endl;
+        throw TestFailedException("PageTable");
+    }
+    std::cout << "Page table lookups matched every insert and remove." << std::endl;
+}
+
+// Returns the used pages of a file in list order, or an empty list if a page
+// does not hold the one record "legacy record <page number>" it was given.
+std::vector<PageId> legacyUsedPages(PageFile &file) {
+    std::vector<PageId> pages;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+        Page page = *iter;
+        RecordId firstRid = {page.page_number(), 1};
+        char expected[32];
+        sprintf(expected, "legacy record %u", page.page_number());
+        if (page.getRecord(firstRid) != expected) {
+            return std::vector<PageId>();
+        }
+        pages.push_back(page.page_number());
+    }
+    return pages;
+}
+
+// Writes a file the way files were laid out before pages were aligned, with
+// the pages right after a 16 byte header, then checks that it opens, that
+// pages can be allocated and deleted in it, and that it keeps its layout.
+void testLegacyFileOpen() {
+    const std::string legacyName = "relL";
+    const PageId legacyPages = 3;
+
+    std::cout << "Opening a file of the unaligned layout..." << std::endl;
+    {
+        std::ofstream out(legacyName.c_str(), std::ios::binary | std::ios::trunc);
+        // num_pages counts the header, as page 0
+        PageId header[4] = {legacyPages + 1 /* num_pages */, 1 /* first_used_page */,
+                            0 /* num_free_pages */, Page::INVALID_NUMBER /* first_free_page */};
+        out.write(reinterpret_cast<const char *>(header), sizeof(header));
+        for (PageId p = 1; p <= legacyPages; p++) {
+            Page page;
+            char data[32];
+            sprintf(data, "legacy record %u", p);
+            page.insertRecord(data);
+
+            // a page is stored as its header followed by its data
+            char bytes[Page::SIZE];
+            memcpy(bytes, &page, Page::SIZE);
+            PageHeader pageHeader;
+            memcpy(&pageHeader, bytes, sizeof(pageHeader));
+            pageHeader.current_page_number = p;
+            pageHeader.next_page_number = p < legacyPages ? p + 1 : Page::INVALID_NUMBER;
+            memcpy(bytes, &pageHeader, sizeof(pageHeader));
+            out.write(bytes, Page::SIZE);
+        }
+    }
+
+    bool passed = true;
+    {
+        PageFile legacyFile = PageFile::open(legacyName);
+        std::vector<PageId> pages = legacyUsedPages(legacyFile);
+        passed = passed && pages.size() == 3 && pages[0] == 1 && pages[1] == 2 && pages[2] == 3;
+
+        PageId newPageNo;
+        Page newPage = legacyFile.allocatePage(newPageNo);
+        char data[32];
+        sprintf(data, "legacy record %u", newPageNo);
+        newPage.insertRecord(data);
+        legacyFile.writePage(newPageNo, newPage);
+        legacyFile.deletePage(2);
+        passed = passed && newPageNo == 4;
+    }
+    {
+        PageFile legacyFile = PageFile::open(legacyName);
+        std::vector<PageId> pages = legacyUsedPages(legacyFile);
+        passed = passed && pages.size() == 3 && pages[0] == 1 && pages[1] == 3 && pages[2] == 4;
+
+        // the deleted page is reused, and goes back in its place in the list
+        PageId newPageNo;
+        Page newPage = legacyFile.allocatePage(newPageNo);
+        char data[32];
+        sprintf(data, "legacy record %u", newPageNo);
+        newPage.insertRecord(data);
+        legacyFile.writePage(newPageNo, newPage);
+        pages = legacyUsedPages(legacyFile);
+        passed = passed && newPageNo == 2 && pages.size() == 4 &&
+                 pages[0] == 1 && pages[1] == 2 && pages[2] == 3 && pages[3] == 4;
+    }
+    {
+        std::ifstream in(legacyName.c_str(), std::ios::binary | std::ios::ate);
+        passed = passed && (std::size_t) in.tellg() == 4 * sizeof(PageId) + 4 * Page::SIZE;
+    }
+    File::remove(legacyName);
+
+    if (!passed) {
+        std::cout << "File of the unaligned layout read or changed incorrectly." << std::endl;
+        throw TestFailedException("LegacyFileOpen");
+    }
+    std::cout << "File of the unaligned layout opened and kept its layout." << std::endl;
+}
+
+// Returns true if the used pages of a file, in list order, are the given ones
+// and the free-space map only points to used pages with the room asked for.
+bool usedPagesMatch(PageFile &file, const std::set<PageId> &used) {
+    std::vector<PageId> pages;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+        pages.push_back((*iter).page_number());
+    }
+    if (pages != std::vector<PageId>(used.begin(), used.end())) {
+        return false;
+    }
+
+    for (std::size_t recordSize = 100; recordSize < Page::SIZE; recordSize += 1000) {
+        PageId pageNo = file.findPageWithSpace(recordSize);
+        if (pageNo != Page::INVALID_NUMBER &&
+            (used.count(pageNo) == 0 || file.readPage(pageNo).getFreeSpace() < recordSize)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Allocates and deletes pages of a file at random, filling each new page to a
+// random size, and checks the used list and the free-space map against the
+// pages expected, also after the file is reopened.
+void testUsedPageList() {
+    const std::string usedName = "relU";
+    std::set<PageId> used;
+    std::minstd_rand rng(2);
+    bool passed = true;
+
+    std::cout << "Allocating and deleting pages at random..." << std::endl;
+    for (int round = 0; round < 2 && passed; round++) {
+        PageFile usedFile = round == 0 ? PageFile::create(usedName) : PageFile::open(usedName);
+        passed = usedPagesMatch(usedFile, used);
+
+        for (int op = 0; op < 2000 && passed; op++) {
+            if (used.empty() || rng() % 100 < 55) {
+                PageId newPageNo;
+                Page newPage = usedFile.allocatePage(newPageNo);
+                newPage.insertRecord(std::string(rng() % 8000, 'u'));
+                usedFile.writePage(newPageNo, newPage);
+                passed = used.insert(newPageNo).second;
+            } else {
+                std::set<PageId>::iterator victim = used.begin();
+                std::advance(victim, rng() % used.size());
+                PageId deletedPageNo = *victim;
+                usedFile.deletePage(deletedPageNo);
+                used.erase(victim);
+
+                // the page deleted last is the first to be reused
+                if (op % 10 == 0) {
+                    PageId newPageNo;
+                    usedFile.allocatePage(newPageNo);
+                    passed = newPageNo == deletedPageNo;
+                    used.insert(newPageNo);
+                }
+            }
+            if (op % 100 == 0) {
+                passed = passed && usedPagesMatch(usedFile, used);
+            }
+        }
+        passed = passed && usedPagesMatch(usedFile, used);
+    }
+    File::remove(usedName);
+
+    if (!passed) {
+        std::cout << "Used pages or free-space map differ from the pages allocated." << std::endl;
+        throw TestFailedException("UsedPageList");
+    }
+    std::cout << "Used pages and free-space map matched the pages allocated." << std::endl;
+}
+
+// Inserts and deletes records of random sizes in one page for long enough
+// that new slots are appended over space earlier records were moved out of.
+void testPageSlotChurn() {
+    Page page;
+    std::vector<RecordId> live;
+    std::minstd_rand rng(3);
+
+    std::cout << "Inserting and deleting records in a page..." << std::endl;
+    for (int op = 0; op < 200000; op++) {
+        std::string record(20 + rng() % 280, 's');
+        if (live.empty() || (rng() % 100 >= 45 && page.hasSpaceForRecord(record))) {
+            live.push_back(page.insertRecord(record));
+        } else {
+            std::size_t victim = rng() % live.size();
+            page.deleteRecord(live[victim]);
+            live[victim] = live.back();
+            live.pop_back();
+        }
+    }
+    std::cout << "Page kept " << live.size() << " records through the churn." << std::endl;
+}
+
+// A page file whose writes can be made to fail, as a full disk would.
+class FailingPageFile : public PageFile {
+public:
+    FailingPageFile(const std::string &name) : PageFile(name, true), failWrites(false) {
+    }
+
+    void writePage(const PageId page_number, const Page &new_page) {
+        if (failWrites) {
+            throw FileIOException(filename(), ENOSPC);
+        }
+        PageFile::writePage(page_number, new_page);
+    }
+
+    void writePages(const PageId first_page_number, const Page *const *pages, const std::size_t count) {
+        if (failWrites) {
+            throw FileIOException(filename(), ENOSPC);
+        }
+        PageFile::writePages(first_page_number, pages, count);
+    }
+
+    bool failWrites;
+};
+
+// Fills a small pool with dirty pages under each replacement policy and fails
+// the write of the page chosen for eviction.  The page must stay in the pool
+// where the policy can find it: hits on it must work, and once writes work
+// again every frame must be evictable and every change reach the file.
+void testEvictionWriteFailure() {
+    const std::string failName = "relW";
+    const ReplacementPolicyType policies[4] = {CLOCK, LRU_K, TWO_Q, ARC};
+    const int poolPages = 4;
+    bool passed = true;
+
+    std::cout << "Failing the write of a page chosen for eviction..." << std::endl;
+    for (int p = 0; p < 4 && passed; p++) {
+        {
+            FailingPageFile failFile(failName);
+            std::vector<PageId> pageNos(2 * poolPages);
+            for (int k = 0; k < 2 * poolPages; k++) {
+                failFile.allocatePage(pageNos[k]);
+            }
+
+            BufMgr failMgr(poolPages, 1, policies[p]);
+            for (int k = 0; k < poolPages; k++) {
+                Page *page;
+                failMgr.readPage(&failFile, pageNos[k], page);
+                char record[32];
+                sprintf(record, "kept record %u", pageNos[k]);
+                page->insertRecord(record);
+                failMgr.unPinPage(&failFile, pageNos[k], true);
+            }
+
+            failFile.failWrites = true;
+            try {
+                Page *page;
+                failMgr.readPage(&failFile, pageNos[poolPages], page);
+                passed = false;
+            } catch (const FileIOException &) {
+            }
+            failFile.failWrites = false;
+
+            for (int k = 0; k < poolPages; k++) {
+                Page *page;
+                failMgr.readPage(&failFile, pageNos[k], page);
+                failMgr.unPinPage(&failFile, pageNos[k], false);
+            }
+            // all of them pinned at once, so that each takes a frame of its own
+            int pinned = poolPages;
+            try {
+                for (; pinned < 2 * poolPages; pinned++) {
+                    Page *page;
+                    failMgr.readPage(&failFile, pageNos[pinned], page);
+                }
+            } catch (const BufferExceededException &) {
+                passed = false;
+            }
+            for (int k = poolPages; k < pinned; k++) {
+                failMgr.unPinPage(&failFile, pageNos[k], false);
+            }
+            failMgr.flushFile(&failFile);
+
+            for (int k = 0; k < poolPages && passed; k++) {
+                Page page = failFile.readPage(pageNos[k]);
+                RecordId firstRid = {pageNos[k], 1};
+                char expected[32];
+                sprintf(expected, "kept record %u", pageNos[k]);
+                passed = page.getRecord(firstRid) == expected;
+            }
+        }
+        File::remove(failName);
+    }
+
+    if (!passed) {
+        std::cout << "A page whose eviction failed was lost to its policy." << std::endl;
+        throw TestFailedException("EvictionWriteFailure");
+    }
+    std::cout << "Pages whose eviction failed stayed in the pool under every policy." << std::endl;
+}
+
+// Scans a file through a ring whose frames are then given up by shrinking the
+// pool, and reads the same pages through the ring again, which must not touch
+// the frames it recorded.  The pool is large enough for the descriptors of the
+// frames given up to be unmapped, and has two frames per shard, so that a page
+// read through the ring into a shard whose first frame is taken lands in the
+// second, which the shrink drops.
+void testRingShrink() {
+    const std::string ringName = "relR";
+    const std::uint32_t shardCount = 20000;
+    const int scanPages = 2000;
+    bool passed = true;
+
+    std::cout << "Shrinking the pool under a scan's ring..." << std::endl;
+    {
+        PageFile ringFile = PageFile::create(ringName);
+        std::vector<PageId> pageNos(2 * scanPages);
+        for (int k = 0; k < 2 * scanPages; k++) {
+            Page newPage = ringFile.allocatePage(pageNos[k]);
+            char record[32];
+            sprintf(record, "ring record %u", pageNos[k]);
+            newPage.insertRecord(record);
+            ringFile.writePage(pageNos[k], newPage);
+        }
+
+        BufMgr ringMgr(2 * shardCount, shardCount);
+        for (int k = 0; k < scanPages; k++) {
+            Page *page;
+            ringMgr.readPage(&ringFile, pageNos[k], page);
+            ringMgr.unPinPage(&ringFile, pageNos[k], false);
+        }
+
+        BufRing ring;
+        for (int pass = 0; pass < 2 && passed; pass++) {
+            if (pass == 1) {
+                ringMgr.resize(shardCount);
+            }
+            for (int k = scanPages; k < 2 * scanPages && passed; k++) {
+                Page *page;
+                ringMgr.readPage(&ringFile, pageNos[k], page, &ring);
+                RecordId firstRid = {pageNos[k], 1};
+                char expected[32];
+                sprintf(expected, "ring record %u", pageNos[k]);
+                passed = page->getRecord(firstRid) == expected;
+                ringMgr.unPinPage(&ringFile, pageNos[k], false);
+            }
+        }
+    }
+    File::remove(ringName);
+
+    if (!passed) {
+        std::cout << "A scan through a ring read the wrong page after the pool shrank." << std::endl;
+        throw TestFailedException("RingShrink");
+    }
+    std::cout << "A scan through a ring kept going after the pool shrank." << std::endl;
+}
+
+// Has a page read ahead join a full ring whose oldest page is dirty and
+// cannot be written.  The read of the page read ahead must still succeed,
+// and the dirty page must stay in the pool until it can be written.
+void testRingWriteFailure() {
+    const std::string failName = "relF";
+    bool passed = true;
+
+    std::cout << "Failing the write of a page leaving a scan's ring..." << std::endl;
+    {
+        FailingPageFile failFile(failName);
+        PageId dirtyPageNo, aheadPageNo;
+        failFile.allocatePage(dirtyPageNo);
+        failFile.allocatePage(aheadPageNo);
+
+        BufMgr failMgr(16);
+        BufRing ring(1);
+        Page *page;
+        failMgr.readPage(&failFile, dirtyPageNo, page, &ring);
+        page->insertRecord("ring record");
+        failMgr.unPinPage(&failFile, dirtyPageNo, true);
+
+        failMgr.prefetchPages(&failFile, aheadPageNo, 1);
+        for (int wait = 0; wait < 5000 && failMgr.getBufStats().diskreads < 2; wait++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        failFile.failWrites = true;
+        try {
+            failMgr.readPage(&failFile, aheadPageNo, page, &ring);
+        } catch (const FileIOException &) {
+            passed = false;
+        }
+        failFile.failWrites = false;
+        failMgr.unPinPage(&failFile, aheadPageNo, false);
+        failMgr.flushFile(&failFile);
+
+        RecordId firstRid = {dirtyPageNo, 1};
+        passed = passed && failFile.readPage(dirtyPageNo).getRecord(firstRid) == "ring record";
+    }
+    File::remove(failName);
+
+    if (!passed) {
+        std::cout << "A failed write out of a ring failed the read or lost the page." << std::endl;
+        throw TestFailedException("RingWriteFailure");
+    }
+    std::cout << "A failed write out of a ring left the read and the page alone." << std::endl;
+}
+
+// Reads a batch of consecutive pages, one of which has been deleted, through
+// readPages().  The batch must fail as a whole, pinning nothing and leaving
+// none of the pages it could not read in the pool; the other pages are then
+// read correctly by the next batch.
+void testReadPagesFailure() {
+    const std::string batchName = "relB";
+    const int batchPages = 8;
+    const int deleted = 5;
+    bool passed = true;
+
+    std::cout << "Reading a batch of pages with a deleted page in it..." << std::endl;
+    {
+        PageFile batchFile = PageFile::create(batchName);
+        std::vector<PageId> pageNos(batchPages);
+        for (int k = 0; k < batchPages; k++) {
+            Page newPage = batchFile.allocatePage(pageNos[k]);
+            char record[32];
+            sprintf(record, "batch record %u", pageNos[k]);
+            newPage.insertRecord(record);
+            batchFile.writePage(pageNos[k], newPage);
+        }
+        batchFile.deletePage(pageNos[deleted]);
+
+        BufMgr batchMgr(16);
+        std::vector<Page *> pages(batchPages);
+        try {
+            batchMgr.readPages(&batchFile, &pageNos[0], batchPages, &pages[0]);
+            passed = false;
+        } catch (const InvalidPageException &) {
+        }
+        try {
+            Page *page;
+            batchMgr.readPage(&batchFile, pageNos[deleted], page);
+            passed = false;
+        } catch (const InvalidPageException &) {
+        }
+
+        pageNos.erase(pageNos.begin() + deleted);
+        batchMgr.readPages(&batchFile, &pageNos[0], batchPages - 1, &pages[0]);
+        for (int k = 0; k < batchPages - 1; k++) {
+            RecordId firstRid = {pageNos[k], 1};
+            char expected[32];
+            sprintf(expected, "batch record %u", pageNos[k]);
+            passed = passed && pages[k]->getRecord(firstRid) == expected;
+        }
+        batchMgr.unPinPages(&batchFile, &pageNos[0], batchPages - 1, false);
+
+        // throws if the failed batch left a page pinned
+        batchMgr.flushFile(&batchFile);
+    }
+    File::remove(batchName);
+
+    if (!passed) {
+        std::cout << "A batch with a deleted page in it did not fail as a whole." << std::endl;
+        throw TestFailedException("ReadPagesFailure");
+    }
+    std::cout << "A batch with a deleted page in it failed as a whole." << std::endl;
+}
+
 void testIndexCreation() {
     createRelationRandom();
 
@@ -509,7 +1069,6 @@ void intTests() {
 
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp) {
     RecordId scanRid;
-    Page *curPage;
 
     std::cout << "Scan for ";
     if (lowOp == GT) { std::cout << "("; } else { std::cout << "["; }
@@ -527,25 +1086,48 @@ int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator
         return 0;
     }
 
-    while (1) {
-        try {
-            index->scanNext(scanRid);
-            bufMgr->readPage(file1, scanRid.page_number, curPage);
-            RECORD myRec = *(reinterpret_cast<const RECORD *>(curPage->getRecord(scanRid).data()));
-            bufMgr->unPinPage(file1, scanRid.page_number, false);
+    // fetch the records of the rids in batches, pinning the pages of a batch with one call
+    std::vector<RecordId> scanRids;
+    std::vector<PageId> pageNos;
+    std::vector<Page *> pages;
+    bool scanCompleted = false;
+    while (!scanCompleted) {
+        scanRids.clear();
+        while (scanRids.size() < FETCH_BATCH) {
+            try {
+                index->scanNext(scanRid);
+            }
+            catch (IndexScanCompletedException e) {
+                scanCompleted = true;
+                break;
+            }
+            scanRids.push_back(scanRid);
+        }
+        if (scanRids.empty()) {
+            break;
+        }
+
+        pageNos.resize(scanRids.size());
+        pages.resize(scanRids.size());
+        for (size_t i = 0; i < scanRids.size(); i++) {
+            pageNos[i] = scanRids[i].page_number;
+        }
+        bufMgr->readPages(file1, &pageNos[0], pageNos.size(), &pages[0]);
+
+        for (size_t i = 0; i < scanRids.size(); i++) {
+            RECORD myRec = *(reinterpret_cast<const RECORD *>(pages[i]->getRecord(scanRids[i]).data()));
 
             if (numResults < 5) {
-                std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+                std::cout << "at:" << scanRids[i].page_number << "," << scanRids[i].slot_number;
                 std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" << std::endl;
             } else if (numResults == 5) {
                 std::cout << "..." << std::endl;
             }
-        }
-        catch (IndexScanCompletedException e) {
-            break;
+
+            numResults++;
         }
 
-        numResults++;
+        bufMgr->unPinPages(file1, &pageNos[0], pageNos.size(), false);
     }
 
     if (numResults >= 5) {
@@ -0,0 +1,149 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * badgerdb_mrc: replays a trace taken with BufMgr::startTrace() against pools of various sizes and replacement
+ * policies, and prints the miss ratio of each, so that the pool can be sized from how its miss ratio falls off.
+ *
+ *   badgerdb_mrc TRACE [-p POLICY,...] [FRAMES ...]
+ *
+ * POLICY is one of clock, lru-k, 2q and arc, all of them by default.  Without FRAMES, 16 sizes evenly spaced up
+ * to the number of distinct pages of the trace are replayed.  The lru column is the exact curve of an LRU pool,
+ * worked out in a single pass over the trace.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "trace.h"
+
+using namespace badgerdb;
+
+namespace {
+
+struct PolicyName
+{
+	const char* name;
+	ReplacementPolicyType type;
+};
+
+const PolicyName POLICIES[] = {
+	{"clock", CLOCK},
+	{"lru-k", LRU_K},
+	{"2q", TWO_Q},
+	{"arc", ARC}
+};
+
+const std::size_t NUM_POLICIES = sizeof(POLICIES) / sizeof(POLICIES[0]);
+
+void usage()
+{
+	std::cerr << "usage: badgerdb_mrc TRACE [-p clock,lru-k,2q,arc] [FRAMES ...]\n";
+	std::exit(2);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+		usage();
+
+	std::vector<const PolicyName*> policies;
+	std::vector<std::uint32_t> frames;
+	for (int a = 2; a < argc; a++)
+	{
+		if (std::strcmp(argv[a], "-p") == 0)
+		{
+			if (++a == argc)
+				usage();
+			std::stringstream list(argv[a]);
+			std::string name;
+			while (std::getline(list, name, ','))
+			{
+				std::size_t p = 0;
+				while (p < NUM_POLICIES && name != POLICIES[p].name)
+					p++;
+				if (p == NUM_POLICIES)
+					usage();
+				policies.push_back(&POLICIES[p]);
+			}
+		}
+		else
+		{
+			const long size = std::atol(argv[a]);
+			if (size <= 0)
+				usage();
+			frames.push_back((std::uint32_t) size);
+		}
+	}
+	if (policies.empty())
+		for (std::size_t p = 0; p < NUM_POLICIES; p++)
+			policies.push_back(&POLICIES[p]);
+
+	std::vector<TraceRecord> records;
+	std::vector<std::string> fileNames;
+	if (!readTrace(argv[1], records, fileNames))
+	{
+		std::cerr << argv[1] << ": not a buffer manager trace\n";
+		return 1;
+	}
+
+	std::unordered_set<std::uint64_t> pages;
+	for (std::size_t r = 0; r < records.size(); r++)
+		pages.insert(((std::uint64_t) records[r].fileId << 32) | records[r].pageNo);
+
+	std::cout << records.size() << " accesses to " << pages.size() << " pages of " << fileNames.size() << " files";
+	if (!records.empty())
+		std::cout << " over " << records.back().time() / 1000000 << " ms";
+	std::cout << "\n";
+	for (std::size_t f = 0; f < fileNames.size(); f++)
+		std::cout << "  file " << f << ": " << fileNames[f] << "\n";
+	if (records.empty())
+		return 0;
+
+	if (frames.empty())
+		for (std::uint32_t k = 1; k <= 16; k++)
+			frames.push_back((std::uint32_t) ((pages.size() * k + 15) / 16));
+
+	// exact LRU curve: sampling every page, file ids stand in for the files
+	MrcSampler lru(1);
+	for (std::size_t r = 0; r < records.size(); r++)
+	{
+		const File* file = reinterpret_cast<const File*>((std::uintptr_t) records[r].fileId + 1);
+		if (records[r].op() == TRACE_DISPOSE)
+			lru.forget(file, records[r].pageNo);
+		else
+			lru.access(file, records[r].pageNo);
+	}
+	std::vector<MissRatioPoint> lruCurve;
+	lru.missRatios(0, frames, lruCurve);
+
+	std::printf("\n%10s %8s", "frames", "lru");
+	for (std::size_t p = 0; p < policies.size(); p++)
+		std::printf(" %8s", policies[p]->name);
+	std::printf("\n");
+
+	for (std::size_t n = 0; n < frames.size(); n++)
+	{
+		std::printf("%10u %8.4f", frames[n], lruCurve[n].missRatio);
+		for (std::size_t p = 0; p < policies.size(); p++)
+		{
+			PoolSimulator pool(policies[p]->type, frames[n]);
+			for (std::size_t r = 0; r < records.size(); r++)
+				pool.replay(records[r]);
+			std::printf(" %8.4f", pool.getAccesses() > 0 ? (double) pool.getMisses() / pool.getAccesses() : 0.0);
+		}
+		std::printf("\n");
+	}
+	return 0;
+}
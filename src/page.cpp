@@ -165,11 +165,16 @@ SlotId Page::getAvailableSlot() {
       }
     }
   } else {
-    // Have to allocate a new slot.
+    // Have to allocate a new slot.  Its space may still hold bytes of a record
+    // moved by a delete, so clear it.
     slot_number = header_.num_slots + 1;
     ++header_.num_slots;
     ++header_.num_free_slots;
     header_.free_space_lower_bound = sizeof(PageSlot) * header_.num_slots;
+    PageSlot* slot = getSlot(slot_number);
+    slot->used = false;
+    slot->item_offset = 0;
+    slot->item_length = 0;
   }
   assert(slot_number != INVALID_SLOT);
   return static_cast<SlotId>(slot_number);
@@ -0,0 +1,86 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "page_guard.h"
+
+namespace badgerdb { 
+
+PageGuard::PageGuard(BufMgr* bufMgr, File* file, const PageId pageNo, Page* page, const bool exclusive)
+	: bufMgr(bufMgr), file(file), pageNo(pageNo), page(page), exclusive(exclusive)
+{
+	// the pin keeps the frame from being given to another page while we wait for the latch
+	if (exclusive)
+		bufMgr->frameLatch(page).lockExclusive();
+	else
+		bufMgr->frameLatch(page).lockShared();
+}
+
+PageGuard::PageGuard(PageGuard && other)
+	: bufMgr(other.bufMgr), file(other.file), pageNo(other.pageNo), page(other.page), exclusive(other.exclusive)
+{
+	other.page = NULL;
+}
+
+PageGuard & PageGuard::operator=(PageGuard && other)
+{
+	if (this != &other)
+	{
+		release();
+		bufMgr = other.bufMgr;
+		file = other.file;
+		pageNo = other.pageNo;
+		page = other.page;
+		exclusive = other.exclusive;
+		other.page = NULL;
+	}
+	return *this;
+}
+
+PageGuard::~PageGuard()
+{
+	release();
+}
+
+void PageGuard::release()
+{
+	if (page == NULL)
+		return;
+
+	if (exclusive)
+		bufMgr->frameLatch(page).unlockExclusive();
+	else
+		bufMgr->frameLatch(page).unlockShared();
+	page = NULL;
+
+	bufMgr->unPinPage(file, pageNo, exclusive);
+}
+
+Page* PageGuard::pinPage(BufMgr* bufMgr, File* file, const PageId pageNo, BufRing* ring)
+{
+	Page* page;
+	bufMgr->readPage(file, pageNo, page, ring);
+	return page;
+}
+
+ReadPageGuard::ReadPageGuard(BufMgr* bufMgr, File* file, const PageId pageNo, BufRing* ring)
+	: PageGuard(bufMgr, file, pageNo, pinPage(bufMgr, file, pageNo, ring), false)
+{
+}
+
+WritePageGuard::WritePageGuard(BufMgr* bufMgr, File* file, const PageId pageNo)
+	: PageGuard(bufMgr, file, pageNo, pinPage(bufMgr, file, pageNo, NULL), true)
+{
+}
+
+WritePageGuard WritePageGuard::allocate(BufMgr* bufMgr, File* file, PageId & pageNo)
+{
+	Page* page;
+	bufMgr->allocPage(file, pageNo, page);
+	return WritePageGuard(bufMgr, file, pageNo, page);
+}
+
+}
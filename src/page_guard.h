@@ -0,0 +1,267 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <utility>
+#include "buffer.h"
+
+namespace badgerdb {
+
+/**
+* @brief Pin and latch on a page in the buffer pool, released when the guard goes away.
+*
+* A guard pins its page when it is constructed, then takes the latch of the page's frame, shared for a
+* ReadPageGuard and exclusive for a WritePageGuard.  Both are released, in the reverse order, when the guard
+* is destroyed, on every path out of the scope holding it, exceptions included.  release() lets go of the page
+* earlier, so that its frame can be evicted as soon as it is no longer needed.
+*
+* Guards can be moved but not copied: exactly one guard is responsible for a pin.  A moved-from or released
+* guard holds no page.
+*
+* Latches are not reentrant and are taken after the pin, so a thread must not guard the same page twice, and
+* threads guarding several pages at once must take them in a consistent order (for a tree, top down).
+*/
+class PageGuard {
+
+ public:
+	/**
+   * Move constructor; the other guard no longer holds the page
+	 */
+  PageGuard(PageGuard && other);
+
+	/**
+   * Releases the page held, then takes over the page of the other guard
+	 */
+  PageGuard & operator=(PageGuard && other);
+
+	/**
+   * Destructor of PageGuard class; releases the page if it is still held
+	 */
+  ~PageGuard();
+
+	/**
+	 * Releases the latch, then unpins the page, marking it dirty if this is a WritePageGuard.
+	 * Does nothing if the guard holds no page.
+	 */
+  void release();
+
+	/**
+   * Returns true if the guard holds a page
+	 */
+  bool isValid() const
+  {
+		return page != NULL;
+  }
+
+	/**
+   * Returns the number of the page held
+	 */
+  PageId pageNumber() const
+  {
+		return pageNo;
+  }
+
+ protected:
+	/**
+   * Constructs a guard holding no page
+	 */
+  PageGuard()
+  	: bufMgr(NULL), file(NULL), pageNo(Page::INVALID_NUMBER), page(NULL), exclusive(false)
+  {
+  }
+
+	/**
+	 * Takes over a pin on a page and latches its frame.
+	 *
+	 * @param bufMgr   	Buffer manager the page is pinned in
+	 * @param file   		File of the page
+	 * @param pageNo  	Number of the page
+	 * @param page   		Page pinned by the caller
+	 * @param exclusive	True to latch the frame exclusive, which also marks the page dirty on release
+	 */
+  PageGuard(BufMgr* bufMgr, File* file, const PageId pageNo, Page* page, const bool exclusive);
+
+	/**
+   * Reads a page into the buffer pool and pins it, for a guard to take over
+	 */
+  static Page* pinPage(BufMgr* bufMgr, File* file, const PageId pageNo, BufRing* ring);
+
+	/**
+   * Buffer manager the page is pinned in
+	 */
+  BufMgr* bufMgr;
+
+	/**
+   * File of the page held
+	 */
+  File* file;
+
+	/**
+   * Number of the page held
+	 */
+  PageId pageNo;
+
+	/**
+   * Page held, NULL if the guard holds no page
+	 */
+  Page* page;
+
+	/**
+   * True if the frame is latched exclusive
+	 */
+  bool exclusive;
+
+ private:
+  PageGuard(const PageGuard &);
+  PageGuard & operator=(const PageGuard &);
+};
+
+
+/**
+* @brief Guard giving shared, read only access to a page.
+*/
+class ReadPageGuard : public PageGuard {
+
+ public:
+	/**
+   * Constructs a guard holding no page, to move one into later
+	 */
+  ReadPageGuard()
+  {
+  }
+
+	/**
+	 * Reads a page into the buffer pool, pins it and latches its frame shared.
+	 *
+	 * @param bufMgr   	Buffer manager to read the page through
+	 * @param file   		File object
+	 * @param pageNo  	Page number in the file
+	 * @param ring  		Ring the page is loaded through, if it is not in the pool; see BufMgr::readPage()
+	 * @throws BufferExceededException If the page is not in the pool and no frame can be allocated for it
+	 */
+  ReadPageGuard(BufMgr* bufMgr, File* file, const PageId pageNo, BufRing* ring = NULL);
+
+	/**
+   * Move constructor
+	 */
+  ReadPageGuard(ReadPageGuard && other)
+  	: PageGuard(std::move(other))
+  {
+  }
+
+	/**
+   * Move assignment
+	 */
+  ReadPageGuard & operator=(ReadPageGuard && other)
+  {
+		PageGuard::operator=(std::move(other));
+		return *this;
+  }
+
+	/**
+   * Returns the page held
+	 */
+  const Page* getPage() const
+  {
+		return page;
+  }
+
+	/**
+   * Returns the frame holding the page, to read the page optimistically later; see BufMgr::readOptimistic()
+	 */
+  FrameRef frameRef() const
+  {
+		return bufMgr->frameRef(page);
+  }
+
+	/**
+   * Returns the contents of the page held, viewed as a T
+	 */
+  template <class T>
+  const T* as() const
+  {
+		return reinterpret_cast<const T*>(page);
+  }
+};
+
+
+/**
+* @brief Guard giving exclusive access to a page.  The page is marked dirty when the guard releases it.
+*/
+class WritePageGuard : public PageGuard {
+
+ public:
+	/**
+   * Constructs a guard holding no page, to move one into later
+	 */
+  WritePageGuard()
+  {
+  }
+
+	/**
+	 * Reads a page into the buffer pool, pins it and latches its frame exclusive.
+	 *
+	 * @param bufMgr   	Buffer manager to read the page through
+	 * @param file   		File object
+	 * @param pageNo  	Page number in the file
+	 * @throws BufferExceededException If the page is not in the pool and no frame can be allocated for it
+	 */
+  WritePageGuard(BufMgr* bufMgr, File* file, const PageId pageNo);
+
+	/**
+	 * Allocates a new page in a file and returns a guard holding it, latched exclusive.
+	 *
+	 * @param bufMgr   	Buffer manager to allocate the page through
+	 * @param file   		File object
+	 * @param pageNo  	Number of the new page, returned via this variable
+	 * @throws BufferExceededException If no frame could be allocated for the page
+	 */
+  static WritePageGuard allocate(BufMgr* bufMgr, File* file, PageId & pageNo);
+
+	/**
+   * Move constructor
+	 */
+  WritePageGuard(WritePageGuard && other)
+  	: PageGuard(std::move(other))
+  {
+  }
+
+	/**
+   * Move assignment
+	 */
+  WritePageGuard & operator=(WritePageGuard && other)
+  {
+		PageGuard::operator=(std::move(other));
+		return *this;
+  }
+
+	/**
+   * Returns the page held
+	 */
+  Page* getPage() const
+  {
+		return page;
+  }
+
+	/**
+   * Returns the contents of the page held, viewed as a T
+	 */
+  template <class T>
+  T* as() const
+  {
+		return reinterpret_cast<T*>(page);
+  }
+
+ private:
+  WritePageGuard(BufMgr* bufMgr, File* file, const PageId pageNo, Page* page)
+  	: PageGuard(bufMgr, file, pageNo, page, true)
+  {
+  }
+};
+
+}
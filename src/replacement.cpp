@@ -0,0 +1,666 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cassert>
+#include "replacement.h"
+#include "buffer.h"
+
+namespace badgerdb {
+
+//----------------------------------------
+// ReplacementPolicy
+//----------------------------------------
+
+ReplacementPolicy* ReplacementPolicy::create(const ReplacementPolicyType type, const FrameId first,
+																						 const std::uint32_t stride, const std::uint32_t numFrames)
+{
+	switch (type)
+	{
+		case LRU_K:
+			return new LRUKPolicy(first, stride, numFrames);
+		case TWO_Q:
+			return new TwoQPolicy(first, stride, numFrames);
+		case ARC:
+			return new ARCPolicy(first, stride, numFrames);
+		case CLOCK:
+		default:
+			return new ClockPolicy(first, stride, numFrames);
+	}
+}
+
+BufDesc& ReplacementPolicy::desc(BufDesc* table, const std::uint32_t i) const
+{
+	return table[first + i * stride];
+}
+
+bool ReplacementPolicy::isFree(const BufDesc& desc)
+{
+	return !desc.valid;
+}
+
+bool ReplacementPolicy::isEvictable(const BufDesc& desc)
+{
+	return desc.valid && desc.pinCnt == 0;
+}
+
+PageKey ReplacementPolicy::keyOf(const BufDesc& desc)
+{
+	PageKey key = {desc.file, desc.pageNo};
+	return key;
+}
+
+bool& ReplacementPolicy::refbit(BufDesc& desc)
+{
+	return desc.refbit;
+}
+
+void ReplacementPolicy::listFrames(const FrameList& list, const std::uint32_t max, std::vector<std::uint32_t>& out)
+{
+	std::uint32_t listed = 0;
+	for (std::uint32_t j = list.front(); j != FrameList::NONE && listed < max; j = list.next(j), listed++)
+		out.push_back(j);
+}
+
+void ReplacementPolicy::resizeFreeFrames(std::vector<std::uint32_t>& freeFrames, const std::uint32_t newNumFrames) const
+{
+	std::vector<std::uint32_t> kept;
+	for (std::size_t k = 0; k < freeFrames.size(); k++)
+	{
+		if (freeFrames[k] < newNumFrames)
+			kept.push_back(freeFrames[k]);
+	}
+	for (std::uint32_t i = newNumFrames; i > numFrames; i--)
+		kept.push_back(i - 1);
+	freeFrames.swap(kept);
+}
+
+//----------------------------------------
+// FrameList
+//----------------------------------------
+
+const std::uint32_t FrameList::NONE;
+
+FrameList::FrameList(const std::uint32_t numFrames)
+	: prevLink(numFrames, NONE), nextLink(numFrames, NONE), linked(numFrames, false),
+		head(NONE), tail(NONE), count(0)
+{
+}
+
+void FrameList::pushBack(const std::uint32_t i)
+{
+	assert(!linked[i]);
+	prevLink[i] = tail;
+	nextLink[i] = NONE;
+	if (tail != NONE)
+		nextLink[tail] = i;
+	else
+		head = i;
+	tail = i;
+	linked[i] = true;
+	count++;
+}
+
+void FrameList::remove(const std::uint32_t i)
+{
+	assert(linked[i]);
+	if (prevLink[i] != NONE)
+		nextLink[prevLink[i]] = nextLink[i];
+	else
+		head = nextLink[i];
+	if (nextLink[i] != NONE)
+		prevLink[nextLink[i]] = prevLink[i];
+	else
+		tail = prevLink[i];
+	linked[i] = false;
+	count--;
+}
+
+void FrameList::resize(const std::uint32_t numFrames)
+{
+	for (std::uint32_t i = numFrames; i < linked.size(); i++)
+	{
+		if (linked[i])
+			remove(i);
+	}
+	prevLink.resize(numFrames, NONE);
+	nextLink.resize(numFrames, NONE);
+	linked.resize(numFrames, false);
+}
+
+//----------------------------------------
+// GhostList
+//----------------------------------------
+
+void GhostList::pushBack(const PageKey& key)
+{
+	if (contains(key))
+		return;
+	keys.push_back(key);
+	index[key] = --keys.end();
+}
+
+bool GhostList::remove(const PageKey& key)
+{
+	std::unordered_map<PageKey, std::list<PageKey>::iterator, PageKeyHash>::iterator it = index.find(key);
+	if (it == index.end())
+		return false;
+	keys.erase(it->second);
+	index.erase(it);
+	return true;
+}
+
+void GhostList::popFront()
+{
+	if (keys.empty())
+		return;
+	index.erase(keys.front());
+	keys.pop_front();
+}
+
+//----------------------------------------
+// ClockPolicy
+//----------------------------------------
+
+ClockPolicy::ClockPolicy(const FrameId first, const std::uint32_t stride, const std::uint32_t numFrames)
+	: ReplacementPolicy(first, stride, numFrames), clockHand(numFrames - 1)
+{
+}
+
+void ClockPolicy::pageLoaded(const std::uint32_t i, const File* file, const PageId pageNo)
+{
+}
+
+void ClockPolicy::pageAccessed(const std::uint32_t i)
+{
+}
+
+void ClockPolicy::frameFreed(const std::uint32_t i)
+{
+	freeFrames.push_back(i);
+}
+
+void ClockPolicy::frameReused(const std::uint32_t i)
+{
+}
+
+void ClockPolicy::resize(const std::uint32_t newNumFrames)
+{
+	resizeFreeFrames(freeFrames, newNumFrames);
+	if (clockHand >= newNumFrames)
+		clockHand = newNumFrames - 1;
+	numFrames = newNumFrames;
+}
+
+bool ClockPolicy::pickVictim(BufDesc* table, const File* file, const PageId pageNo, std::uint32_t& i)
+{
+	// reuse frames emptied behind the hand first, unless the hand has filled them since
+	examined = 0;
+	while (!freeFrames.empty())
+	{
+		std::uint32_t j = freeFrames.back();
+		freeFrames.pop_back();
+		examined++;
+		if (isFree(desc(table, j)))
+		{
+			i = j;
+			return true;
+		}
+	}
+
+	std::uint32_t numScanned = 0;
+
+	while (numScanned < 2*numFrames)	//Need to scan twice
+	{
+		// advance the clock
+		clockHand = (clockHand + 1) % numFrames;
+		numScanned++;
+		examined++;
+		BufDesc& candidate = desc(table, clockHand);
+
+		// if invalid, use frame
+		if (isFree(candidate))
+		{
+			i = clockHand;
+			return true;
+		}
+
+		// is valid, check referenced bit
+		if (!refbit(candidate))
+		{
+			// hasn't been referenced and is not pinned, use it
+			if (isEvictable(candidate))
+			{
+				i = clockHand;
+				return true;
+			}
+		}
+		else
+		{
+			// has been referenced, clear the bit
+			refbit(candidate) = false;
+		}
+	}
+
+	return false;
+}
+
+void ClockPolicy::victimKept(const std::uint32_t i, const File* file, const PageId pageNo)
+{
+	// the sweep never unlinks a frame, it will simply come by again
+}
+
+void ClockPolicy::upcomingVictims(BufDesc* table, const std::uint32_t max, std::vector<std::uint32_t>& out) const
+{
+	// frames just ahead of the hand which won't get a second chance
+	std::uint32_t hand = clockHand;
+	for (std::uint32_t scanned = 0, listed = 0; scanned < numFrames && listed < max; scanned++)
+	{
+		hand = (hand + 1) % numFrames;
+		if (!refbit(desc(table, hand)))
+		{
+			out.push_back(hand);
+			listed++;
+		}
+	}
+}
+
+//----------------------------------------
+// LRUKPolicy
+//----------------------------------------
+
+LRUKPolicy::LRUKPolicy(const FrameId first, const std::uint32_t stride, const std::uint32_t numFrames)
+	: ReplacementPolicy(first, stride, numFrames), now(0), history(numFrames)
+{
+	for (std::uint32_t i = numFrames; i > 0; i--)
+		freeFrames.push_back(i - 1);
+}
+
+LRUKPolicy::RankKey LRUKPolicy::rankOf(const std::uint32_t i) const
+{
+	// frames with a single access have an infinite backward 2-distance and sort
+	// first (previous == 0), by recency of their only access
+	return RankKey(std::make_pair(history[i].previous, history[i].last), i);
+}
+
+void LRUKPolicy::touch(const std::uint32_t i)
+{
+	history[i].previous = history[i].last;
+	history[i].last = ++now;
+}
+
+void LRUKPolicy::pageLoaded(const std::uint32_t i, const File* file, const PageId pageNo)
+{
+	history[i] = incoming;
+	touch(i);
+	ranking.insert(rankOf(i));
+}
+
+void LRUKPolicy::pageAccessed(const std::uint32_t i)
+{
+	ranking.erase(rankOf(i));
+	touch(i);
+	ranking.insert(rankOf(i));
+}
+
+void LRUKPolicy::frameFreed(const std::uint32_t i)
+{
+	ranking.erase(rankOf(i));
+	freeFrames.push_back(i);
+}
+
+void LRUKPolicy::frameReused(const std::uint32_t i)
+{
+	ranking.erase(rankOf(i));
+	incoming.last = incoming.previous = 0;
+}
+
+void LRUKPolicy::resize(const std::uint32_t newNumFrames)
+{
+	for (std::uint32_t i = newNumFrames; i < numFrames; i++)
+		ranking.erase(rankOf(i));
+	resizeFreeFrames(freeFrames, newNumFrames);
+	history.resize(newNumFrames, History());
+	numFrames = newNumFrames;
+}
+
+bool LRUKPolicy::pickVictim(BufDesc* table, const File* file, const PageId pageNo, std::uint32_t& i)
+{
+	// recover the history of the incoming page if it was evicted recently
+	PageKey key = {file, pageNo};
+	std::unordered_map<PageKey, History, PageKeyHash>::iterator found = retained.find(key);
+	if (found != retained.end())
+	{
+		incoming = found->second;
+		retained.erase(found);
+	}
+	else
+	{
+		incoming.last = incoming.previous = 0;
+	}
+
+	examined = 1;
+	if (!freeFrames.empty())
+	{
+		i = freeFrames.back();
+		freeFrames.pop_back();
+		return true;
+	}
+
+	examined = 0;
+	for (std::set<RankKey>::iterator it = ranking.begin(); it != ranking.end(); ++it)
+	{
+		examined++;
+		if (isEvictable(desc(table, it->second)))
+		{
+			i = it->second;
+			ranking.erase(it);
+
+			// remember the victim's history, forgetting the oldest once as many
+			// pages are retained as there are frames
+			retained[keyOf(desc(table, i))] = history[i];
+			retainedOrder.push_back(keyOf(desc(table, i)));
+			while (retainedOrder.size() > numFrames)
+			{
+				retained.erase(retainedOrder.front());
+				retainedOrder.pop_front();
+			}
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void LRUKPolicy::victimKept(const std::uint32_t i, const File* file, const PageId pageNo)
+{
+	// the frame's history is still the page's, only its retained copy has to go
+	PageKey key = {file, pageNo};
+	retained.erase(key);
+	retainedOrder.remove(key);
+	ranking.insert(rankOf(i));
+}
+
+void LRUKPolicy::upcomingVictims(BufDesc* table, const std::uint32_t max, std::vector<std::uint32_t>& out) const
+{
+	std::uint32_t listed = 0;
+	for (std::set<RankKey>::const_iterator it = ranking.begin(); it != ranking.end() && listed < max; ++it, listed++)
+		out.push_back(it->second);
+}
+
+//----------------------------------------
+// TwoQPolicy
+//----------------------------------------
+
+TwoQPolicy::TwoQPolicy(const FrameId first, const std::uint32_t stride, const std::uint32_t numFrames)
+	: ReplacementPolicy(first, stride, numFrames), a1in(numFrames), am(numFrames),
+		kin(numFrames / 4 > 0 ? numFrames / 4 : 1), kout(numFrames / 2 > 0 ? numFrames / 2 : 1),
+		incomingHot(false)
+{
+	for (std::uint32_t i = numFrames; i > 0; i--)
+		freeFrames.push_back(i - 1);
+}
+
+void TwoQPolicy::pageLoaded(const std::uint32_t i, const File* file, const PageId pageNo)
+{
+	if (incomingHot)
+		am.pushBack(i);
+	else
+		a1in.pushBack(i);
+}
+
+void TwoQPolicy::pageAccessed(const std::uint32_t i)
+{
+	// pages on probation stay where they are, pages in Am move to its MRU end
+	if (am.contains(i))
+	{
+		am.remove(i);
+		am.pushBack(i);
+	}
+}
+
+void TwoQPolicy::frameFreed(const std::uint32_t i)
+{
+	if (am.contains(i))
+		am.remove(i);
+	else if (a1in.contains(i))
+		a1in.remove(i);
+	freeFrames.push_back(i);
+}
+
+void TwoQPolicy::frameReused(const std::uint32_t i)
+{
+	if (am.contains(i))
+		am.remove(i);
+	else if (a1in.contains(i))
+		a1in.remove(i);
+	incomingHot = false;
+}
+
+void TwoQPolicy::resize(const std::uint32_t newNumFrames)
+{
+	a1in.resize(newNumFrames);
+	am.resize(newNumFrames);
+	resizeFreeFrames(freeFrames, newNumFrames);
+	numFrames = newNumFrames;
+
+	kin = numFrames / 4 > 0 ? numFrames / 4 : 1;
+	kout = numFrames / 2 > 0 ? numFrames / 2 : 1;
+	while (a1out.size() > kout)
+		a1out.popFront();
+}
+
+bool TwoQPolicy::evictFrom(FrameList& queue, BufDesc* table, const bool remember, std::uint32_t& i)
+{
+	for (std::uint32_t j = queue.front(); j != FrameList::NONE; j = queue.next(j))
+	{
+		examined++;
+		if (isEvictable(desc(table, j)))
+		{
+			queue.remove(j);
+			if (remember)
+			{
+				a1out.pushBack(keyOf(desc(table, j)));
+				if (a1out.size() > kout)
+					a1out.popFront();
+			}
+			i = j;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool TwoQPolicy::pickVictim(BufDesc* table, const File* file, const PageId pageNo, std::uint32_t& i)
+{
+	PageKey key = {file, pageNo};
+	incomingHot = a1out.remove(key);
+
+	examined = 1;
+	if (!freeFrames.empty())
+	{
+		i = freeFrames.back();
+		freeFrames.pop_back();
+		return true;
+	}
+
+	examined = 0;
+
+	// reclaim from probation while it is over its share, otherwise from the
+	// LRU end of Am; fall back to the other queue if everything is pinned
+	if (a1in.size() > kin)
+		return evictFrom(a1in, table, true, i) || evictFrom(am, table, false, i);
+	return evictFrom(am, table, false, i) || evictFrom(a1in, table, true, i);
+}
+
+void TwoQPolicy::victimKept(const std::uint32_t i, const File* file, const PageId pageNo)
+{
+	// only victims taken from probation are remembered in A1out
+	PageKey key = {file, pageNo};
+	if (a1out.remove(key))
+		a1in.pushBack(i);
+	else
+		am.pushBack(i);
+}
+
+void TwoQPolicy::upcomingVictims(BufDesc* table, const std::uint32_t max, std::vector<std::uint32_t>& out) const
+{
+	if (a1in.size() > kin)
+		listFrames(a1in, max, out);
+	else
+		listFrames(am, max, out);
+}
+
+//----------------------------------------
+// ARCPolicy
+//----------------------------------------
+
+ARCPolicy::ARCPolicy(const FrameId first, const std::uint32_t stride, const std::uint32_t numFrames)
+	: ReplacementPolicy(first, stride, numFrames), t1(numFrames), t2(numFrames), p(0), incomingHot(false)
+{
+	for (std::uint32_t i = numFrames; i > 0; i--)
+		freeFrames.push_back(i - 1);
+}
+
+void ARCPolicy::pageLoaded(const std::uint32_t i, const File* file, const PageId pageNo)
+{
+	if (incomingHot)
+		t2.pushBack(i);
+	else
+		t1.pushBack(i);
+}
+
+void ARCPolicy::pageAccessed(const std::uint32_t i)
+{
+	// any hit makes the page frequent
+	if (t1.contains(i))
+		t1.remove(i);
+	else
+		t2.remove(i);
+	t2.pushBack(i);
+}
+
+void ARCPolicy::frameFreed(const std::uint32_t i)
+{
+	if (t1.contains(i))
+		t1.remove(i);
+	else if (t2.contains(i))
+		t2.remove(i);
+	freeFrames.push_back(i);
+}
+
+void ARCPolicy::frameReused(const std::uint32_t i)
+{
+	if (t1.contains(i))
+		t1.remove(i);
+	else if (t2.contains(i))
+		t2.remove(i);
+	incomingHot = false;
+}
+
+void ARCPolicy::resize(const std::uint32_t newNumFrames)
+{
+	t1.resize(newNumFrames);
+	t2.resize(newNumFrames);
+	resizeFreeFrames(freeFrames, newNumFrames);
+	numFrames = newNumFrames;
+
+	// keep the directory within its bounds for the new size
+	if (p > numFrames)
+		p = numFrames;
+	while (t1.size() + b1.size() > numFrames && b1.size() > 0)
+		b1.popFront();
+	while (t1.size() + t2.size() + b1.size() + b2.size() > 2 * numFrames && b2.size() > 0)
+		b2.popFront();
+}
+
+bool ARCPolicy::evictFrom(FrameList& list, GhostList& ghost, BufDesc* table, std::uint32_t& i)
+{
+	for (std::uint32_t j = list.front(); j != FrameList::NONE; j = list.next(j))
+	{
+		examined++;
+		if (isEvictable(desc(table, j)))
+		{
+			list.remove(j);
+			ghost.pushBack(keyOf(desc(table, j)));
+			i = j;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ARCPolicy::pickVictim(BufDesc* table, const File* file, const PageId pageNo, std::uint32_t& i)
+{
+	PageKey key = {file, pageNo};
+	const std::uint32_t c = numFrames;
+	bool inB2 = false;
+
+	// adapt the target size of T1 on a ghost hit
+	if (b1.contains(key))
+	{
+		std::uint32_t delta = b2.size() > b1.size() ? b2.size() / b1.size() : 1;
+		p = p + delta < c ? p + delta : c;
+		b1.remove(key);
+		incomingHot = true;
+	}
+	else if (b2.contains(key))
+	{
+		std::uint32_t delta = b1.size() > b2.size() ? b1.size() / b2.size() : 1;
+		p = p > delta ? p - delta : 0;
+		b2.remove(key);
+		incomingHot = true;
+		inB2 = true;
+	}
+	else
+	{
+		incomingHot = false;
+
+		// keep the directory within 2c pages, and the recency side within c
+		if (t1.size() + b1.size() >= c && b1.size() > 0)
+			b1.popFront();
+		else if (t1.size() + t2.size() + b1.size() + b2.size() >= 2 * c && b2.size() > 0)
+			b2.popFront();
+	}
+
+	examined = 1;
+	if (!freeFrames.empty())
+	{
+		i = freeFrames.back();
+		freeFrames.pop_back();
+		return true;
+	}
+
+	examined = 0;
+
+	// REPLACE: take from T1 while it is over target, otherwise from T2
+	if (t1.size() > 0 && (t1.size() > p || (inB2 && t1.size() == p)))
+		return evictFrom(t1, b1, table, i) || evictFrom(t2, b2, table, i);
+	return evictFrom(t2, b2, table, i) || evictFrom(t1, b1, table, i);
+}
+
+void ARCPolicy::victimKept(const std::uint32_t i, const File* file, const PageId pageNo)
+{
+	// the ghost entry tells which list the frame was taken from
+	PageKey key = {file, pageNo};
+	if (b2.remove(key))
+		t2.pushBack(i);
+	else
+	{
+		b1.remove(key);
+		t1.pushBack(i);
+	}
+}
+
+void ARCPolicy::upcomingVictims(BufDesc* table, const std::uint32_t max, std::vector<std::uint32_t>& out) const
+{
+	if (t1.size() > 0 && t1.size() > p)
+		listFrames(t1, max, out);
+	else
+		listFrames(t2, max, out);
+}
+
+}
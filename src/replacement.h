@@ -0,0 +1,503 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+namespace badgerdb {
+
+class File;
+class BufDesc;
+class FrameList;
+
+/**
+ * @brief Page replacement policies the buffer manager can be constructed with.
+ */
+enum ReplacementPolicyType
+{
+	CLOCK = 0,	/* Single reference bit clock sweep */
+	LRU_K = 1,	/* Evict the page whose K-th most recent access is oldest (K = 2) */
+	TWO_Q = 2,	/* Simplified 2Q: FIFO probation queue, LRU main queue, ghost queue of evicted pages */
+	ARC = 3			/* Adaptive Replacement Cache */
+};
+
+/**
+ * @brief Identifies a page of a file, used by policies that remember pages which are no longer resident.
+ */
+struct PageKey {
+	/**
+	 * File the page belongs to
+	 */
+	const File* file;
+
+	/**
+	 * Page number within the file
+	 */
+	PageId pageNo;
+
+	bool operator==(const PageKey& rhs) const {
+		return file == rhs.file && pageNo == rhs.pageNo;
+	}
+};
+
+/**
+ * @brief Hash function for PageKey.
+ */
+struct PageKeyHash {
+	std::size_t operator()(const PageKey& key) const {
+		std::uint64_t h = (std::uint64_t) key.file ^ ((std::uint64_t) key.pageNo * 0x9E3779B97F4A7C15ULL);
+		h ^= h >> 31;
+		return (std::size_t) h;
+	}
+};
+
+/**
+ * @brief Interface of a page replacement policy.
+ *
+ * A policy manages the frames of one buffer pool shard, which it refers to by their index i within the shard
+ * (0 <= i < numFrames); the frame number in the pool is first + i * stride.  All calls are made by BufMgr while
+ * it holds the shard latch.  Each policy keeps its per-frame metadata in arrays parallel to the shard's BufDesc
+ * entries.
+ */
+class ReplacementPolicy
+{
+ public:
+	/**
+	 * Creates a policy of the given type for the frames of one shard.
+	 *
+	 * @param type				Policy to create
+	 * @param first				Frame number of the shard's first frame
+	 * @param stride			Distance between frame numbers of consecutive frames of the shard
+	 * @param numFrames		Number of frames of the shard
+	 * @return  					Newly allocated policy, owned by the caller
+	 */
+	static ReplacementPolicy* create(const ReplacementPolicyType type, const FrameId first,
+																	 const std::uint32_t stride, const std::uint32_t numFrames);
+
+	virtual ~ReplacementPolicy() {}
+
+	/**
+	 * Called when a page has been read or allocated into a frame previously returned by pickVictim().
+	 *
+	 * @param i				Index of the frame in the shard
+	 * @param file		File the page belongs to
+	 * @param pageNo	Page number within the file
+	 */
+	virtual void pageLoaded(const std::uint32_t i, const File* file, const PageId pageNo) = 0;
+
+	/**
+	 * Called when a page already in the buffer pool is requested again.
+	 *
+	 * @param i				Index of the frame in the shard
+	 */
+	virtual void pageAccessed(const std::uint32_t i) = 0;
+
+	/**
+	 * Called when a frame is emptied without going through pickVictim(), e.g. when its file is flushed or its
+	 * page disposed.
+	 *
+	 * @param i				Index of the frame in the shard
+	 */
+	virtual void frameFreed(const std::uint32_t i) = 0;
+
+	/**
+	 * Called when a frame is handed to another page without going through pickVictim(), e.g. when a scan
+	 * recycles a frame of its ring.  The policy forgets the page the frame held; pageLoaded() follows, and the
+	 * page loaded is treated as one that was never seen before.
+	 *
+	 * @param i				Index of the frame in the shard
+	 */
+	virtual void frameReused(const std::uint32_t i) = 0;
+
+	/**
+	 * Changes the number of frames of the shard.  New frames are empty.  Frames dropped by shrinking are
+	 * forgotten, whatever they hold; BufMgr empties them itself.
+	 *
+	 * @param numFrames	New number of frames of the shard, at least 1
+	 */
+	virtual void resize(const std::uint32_t numFrames) = 0;
+
+	/**
+	 * Chooses a frame to hold a new page: an empty frame if there is one, otherwise the unpinned frame whose page
+	 * the policy considers least valuable.  The chosen frame's descriptor still describes the page to evict.
+	 *
+	 * @param table		The buffer pool's descriptor table
+	 * @param file		File of the page that will be loaded into the frame
+	 * @param pageNo	Page number of the page that will be loaded into the frame
+	 * @param i				Index of the chosen frame in the shard, returned via this reference
+	 * @return  			False if every frame of the shard is pinned
+	 */
+	virtual bool pickVictim(BufDesc* table, const File* file, const PageId pageNo, std::uint32_t& i) = 0;
+
+	/**
+	 * Called when a frame returned by pickVictim() keeps the page it held after all, because the page could not
+	 * be written out.  The policy takes the frame back as if it had never been chosen and forgets what it
+	 * remembered of the page as evicted.
+	 *
+	 * @param i				Index of the frame in the shard
+	 * @param file		File of the page the frame still holds
+	 * @param pageNo	Page number of the page the frame still holds
+	 */
+	virtual void victimKept(const std::uint32_t i, const File* file, const PageId pageNo) = 0;
+
+	/**
+	 * Lists the frames the policy expects to evict next, most imminent first, without changing any state.
+	 * Used by the background writer to clean frames before they are needed.
+	 *
+	 * @param table		The buffer pool's descriptor table
+	 * @param max			Maximum number of frames to list
+	 * @param out			Frame indexes are appended to this vector
+	 */
+	virtual void upcomingVictims(BufDesc* table, const std::uint32_t max, std::vector<std::uint32_t>& out) const = 0;
+
+	/**
+	 * Returns the number of frames the last call to pickVictim() looked at, the one chosen included.
+	 */
+	std::uint32_t lastExamined() const
+	{
+		return examined;
+	}
+
+ protected:
+	/**
+	 * Constructor of ReplacementPolicy class
+	 */
+	ReplacementPolicy(const FrameId first, const std::uint32_t stride, const std::uint32_t numFrames)
+		: first(first), stride(stride), numFrames(numFrames), examined(0)
+	{
+	}
+
+	/**
+	 * Returns the descriptor of the i-th frame of the shard.
+	 */
+	BufDesc& desc(BufDesc* table, const std::uint32_t i) const;
+
+	/**
+	 * Returns true if the frame holds no page.
+	 */
+	static bool isFree(const BufDesc& desc);
+
+	/**
+	 * Returns true if the frame holds a page and nobody has it pinned.
+	 */
+	static bool isEvictable(const BufDesc& desc);
+
+	/**
+	 * Returns the key of the page held by the frame.
+	 */
+	static PageKey keyOf(const BufDesc& desc);
+
+	/**
+	 * Reference bit of the frame, for use by the clock policy.
+	 */
+	static bool& refbit(BufDesc& desc);
+
+	/**
+	 * Appends up to max frames of a FrameList, from its head, to out.
+	 */
+	static void listFrames(const FrameList& list, const std::uint32_t max, std::vector<std::uint32_t>& out);
+
+	/**
+	 * Adjusts a list of empty frames to a new number of frames: drops frames past the end, and adds new frames
+	 * so that the lowest is handed out first.
+	 */
+	void resizeFreeFrames(std::vector<std::uint32_t>& freeFrames, const std::uint32_t newNumFrames) const;
+
+	/**
+	 * Frame number of the shard's first frame
+	 */
+	FrameId first;
+
+	/**
+	 * Distance between frame numbers of consecutive frames of the shard
+	 */
+	std::uint32_t stride;
+
+	/**
+	 * Number of frames of the shard
+	 */
+	std::uint32_t numFrames;
+
+	/**
+	 * Number of frames the last call to pickVictim() looked at, counted by each policy
+	 */
+	std::uint32_t examined;
+};
+
+/**
+ * @brief Doubly linked list of frame indexes threaded through arrays, one link pair per frame.
+ *
+ * A frame is on at most one FrameList at a time.  The head is the least recently inserted or moved frame.
+ */
+class FrameList
+{
+ public:
+	/**
+	 * Index marking the end of a list
+	 */
+	static const std::uint32_t NONE = 0xFFFFFFFF;
+
+	/**
+	 * Constructor of FrameList class
+	 *
+	 * @param numFrames	Number of frames that may be linked into the list
+	 */
+	FrameList(const std::uint32_t numFrames);
+
+	/**
+	 * Appends a frame at the tail (most recent end) of the list.
+	 */
+	void pushBack(const std::uint32_t i);
+
+	/**
+	 * Unlinks a frame from the list.
+	 */
+	void remove(const std::uint32_t i);
+
+	/**
+	 * Changes the number of frames that may be linked into the list, unlinking frames past the new end.
+	 */
+	void resize(const std::uint32_t numFrames);
+
+	/**
+	 * Returns true if the frame is linked into this list.
+	 */
+	bool contains(const std::uint32_t i) const { return linked[i]; }
+
+	std::uint32_t front() const { return head; }
+	std::uint32_t next(const std::uint32_t i) const { return nextLink[i]; }
+	std::uint32_t size() const { return count; }
+
+ private:
+	std::vector<std::uint32_t> prevLink;
+	std::vector<std::uint32_t> nextLink;
+	std::vector<bool> linked;
+	std::uint32_t head;
+	std::uint32_t tail;
+	std::uint32_t count;
+};
+
+/**
+ * @brief Bounded FIFO of keys of pages that have been evicted ("ghost" entries).
+ */
+class GhostList
+{
+ public:
+	/**
+	 * Adds a key at the most recent end of the list.
+	 */
+	void pushBack(const PageKey& key);
+
+	/**
+	 * Removes a key if present.
+	 *
+	 * @return  True if the key was in the list.
+	 */
+	bool remove(const PageKey& key);
+
+	/**
+	 * Drops the oldest key.
+	 */
+	void popFront();
+
+	bool contains(const PageKey& key) const { return index.find(key) != index.end(); }
+	std::uint32_t size() const { return (std::uint32_t) keys.size(); }
+
+ private:
+	std::list<PageKey> keys;
+	std::unordered_map<PageKey, std::list<PageKey>::iterator, PageKeyHash> index;
+};
+
+/**
+ * @brief Clock replacement: frames are swept in order, and a frame referenced since the last sweep gets a
+ * second chance.  The reference bit is the one BufMgr sets in BufDesc on every access.
+ */
+class ClockPolicy : public ReplacementPolicy
+{
+ public:
+	ClockPolicy(const FrameId first, const std::uint32_t stride, const std::uint32_t numFrames);
+	void pageLoaded(const std::uint32_t i, const File* file, const PageId pageNo);
+	void pageAccessed(const std::uint32_t i);
+	void frameFreed(const std::uint32_t i);
+	void frameReused(const std::uint32_t i);
+	void resize(const std::uint32_t numFrames);
+	bool pickVictim(BufDesc* table, const File* file, const PageId pageNo, std::uint32_t& i);
+	void victimKept(const std::uint32_t i, const File* file, const PageId pageNo);
+	void upcomingVictims(BufDesc* table, const std::uint32_t max, std::vector<std::uint32_t>& out) const;
+
+ private:
+	/**
+	 * Current position of the clock hand, as a frame index
+	 */
+	std::uint32_t clockHand;
+
+	/**
+	 * Frames emptied by frameFreed(), which may have been refilled since
+	 */
+	std::vector<std::uint32_t> freeFrames;
+};
+
+/**
+ * @brief LRU-K replacement with K = 2: evicts the frame whose second most recent access is the oldest, frames
+ * accessed only once going first (in LRU order).  Access history of evicted pages is retained for a while so a
+ * page that comes back is not treated as new.
+ */
+class LRUKPolicy : public ReplacementPolicy
+{
+ public:
+	LRUKPolicy(const FrameId first, const std::uint32_t stride, const std::uint32_t numFrames);
+	void pageLoaded(const std::uint32_t i, const File* file, const PageId pageNo);
+	void pageAccessed(const std::uint32_t i);
+	void frameFreed(const std::uint32_t i);
+	void frameReused(const std::uint32_t i);
+	void resize(const std::uint32_t numFrames);
+	bool pickVictim(BufDesc* table, const File* file, const PageId pageNo, std::uint32_t& i);
+	void victimKept(const std::uint32_t i, const File* file, const PageId pageNo);
+	void upcomingVictims(BufDesc* table, const std::uint32_t max, std::vector<std::uint32_t>& out) const;
+
+ private:
+	/**
+	 * Times of the last and second to last access of a page; 0 if there was none
+	 */
+	struct History {
+		std::uint64_t last;
+		std::uint64_t previous;
+	};
+
+	typedef std::pair<std::pair<std::uint64_t, std::uint64_t>, std::uint32_t> RankKey;
+
+	/**
+	 * Position of a resident frame in the eviction order
+	 */
+	RankKey rankOf(const std::uint32_t i) const;
+
+	/**
+	 * Records an access to a resident frame.
+	 */
+	void touch(const std::uint32_t i);
+
+	/**
+	 * Logical clock, advanced on every access
+	 */
+	std::uint64_t now;
+
+	/**
+	 * Access history of each frame's page
+	 */
+	std::vector<History> history;
+
+	/**
+	 * Resident frames, ordered from best to worst eviction candidate
+	 */
+	std::set<RankKey> ranking;
+
+	/**
+	 * Empty frames
+	 */
+	std::vector<std::uint32_t> freeFrames;
+
+	/**
+	 * Retained history of evicted pages, and the order in which to forget it
+	 */
+	std::unordered_map<PageKey, History, PageKeyHash> retained;
+	std::list<PageKey> retainedOrder;
+
+	/**
+	 * Access history of the page about to be loaded, looked up by pickVictim()
+	 */
+	History incoming;
+};
+
+/**
+ * @brief 2Q replacement: pages enter a FIFO probation queue (A1in) and only move to the LRU main queue (Am) if
+ * they are requested again after having been evicted from probation, which is remembered in the ghost queue
+ * A1out.  A one-time scan therefore only cycles through A1in.
+ */
+class TwoQPolicy : public ReplacementPolicy
+{
+ public:
+	TwoQPolicy(const FrameId first, const std::uint32_t stride, const std::uint32_t numFrames);
+	void pageLoaded(const std::uint32_t i, const File* file, const PageId pageNo);
+	void pageAccessed(const std::uint32_t i);
+	void frameFreed(const std::uint32_t i);
+	void frameReused(const std::uint32_t i);
+	void resize(const std::uint32_t numFrames);
+	bool pickVictim(BufDesc* table, const File* file, const PageId pageNo, std::uint32_t& i);
+	void victimKept(const std::uint32_t i, const File* file, const PageId pageNo);
+	void upcomingVictims(BufDesc* table, const std::uint32_t max, std::vector<std::uint32_t>& out) const;
+
+ private:
+	/**
+	 * Evicts the first unpinned frame of a queue, remembering its page in A1out if asked to.
+	 */
+	bool evictFrom(FrameList& queue, BufDesc* table, const bool remember, std::uint32_t& i);
+
+	FrameList a1in;
+	FrameList am;
+	GhostList a1out;
+	std::vector<std::uint32_t> freeFrames;
+
+	/**
+	 * Target size of A1in and maximum size of A1out
+	 */
+	std::uint32_t kin;
+	std::uint32_t kout;
+
+	/**
+	 * True if the page about to be loaded was found in A1out by pickVictim()
+	 */
+	bool incomingHot;
+};
+
+/**
+ * @brief Adaptive Replacement Cache: balances a recency list T1 and a frequency list T2, steering the split
+ * between them with ghost lists B1 and B2 of recently evicted pages.
+ */
+class ARCPolicy : public ReplacementPolicy
+{
+ public:
+	ARCPolicy(const FrameId first, const std::uint32_t stride, const std::uint32_t numFrames);
+	void pageLoaded(const std::uint32_t i, const File* file, const PageId pageNo);
+	void pageAccessed(const std::uint32_t i);
+	void frameFreed(const std::uint32_t i);
+	void frameReused(const std::uint32_t i);
+	void resize(const std::uint32_t numFrames);
+	bool pickVictim(BufDesc* table, const File* file, const PageId pageNo, std::uint32_t& i);
+	void victimKept(const std::uint32_t i, const File* file, const PageId pageNo);
+	void upcomingVictims(BufDesc* table, const std::uint32_t max, std::vector<std::uint32_t>& out) const;
+
+ private:
+	/**
+	 * Evicts the first unpinned frame of a list into a ghost list.
+	 */
+	bool evictFrom(FrameList& list, GhostList& ghost, BufDesc* table, std::uint32_t& i);
+
+	FrameList t1;
+	FrameList t2;
+	GhostList b1;
+	GhostList b2;
+	std::vector<std::uint32_t> freeFrames;
+
+	/**
+	 * Target size of T1
+	 */
+	std::uint32_t p;
+
+	/**
+	 * True if the page about to be loaded was found in a ghost list by pickVictim()
+	 */
+	bool incomingHot;
+};
+
+}
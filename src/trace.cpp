@@ -0,0 +1,283 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "trace.h"
+#include "buffer.h"
+#include "file.h"
+
+namespace badgerdb {
+
+const char TraceWriter::TRACE_MAGIC[8] = {'B', 'D', 'B', 'T', 'R', 'A', 'C', 'E'};
+const std::uint32_t TraceWriter::TRACE_VERSION;
+
+// the header takes the room of one record
+static_assert(sizeof(TraceRecord) == 16, "trace records are 16 bytes on disk");
+
+//----------------------------------------
+// TraceWriter
+//----------------------------------------
+
+TraceWriter::TraceWriter(const std::string & path)
+	: out(path.c_str(), std::ios::binary | std::ios::trunc), start(std::chrono::steady_clock::now())
+{
+	const std::uint32_t header[2] = {TRACE_VERSION, sizeof(TraceRecord)};
+	out.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+	out.write(reinterpret_cast<const char*>(header), sizeof(header));
+}
+
+TraceWriter::~TraceWriter()
+{
+	out.flush();
+}
+
+std::uint32_t TraceWriter::fileId(const File* file)
+{
+	const std::string name = file->filename();
+
+	std::lock_guard<std::mutex> guard(latch);
+	std::unordered_map<std::string, std::uint32_t>::iterator found = fileIds.find(name);
+	if (found != fileIds.end())
+		return found->second;
+
+	const std::uint32_t id = fileIds.size();
+	fileIds[name] = id;
+
+	// the name follows its record, padded to a whole number of records
+	const TraceRecord r = record(TRACE_FILE, id, name.size());
+	std::string padded(name);
+	padded.resize((name.size() + sizeof(TraceRecord) - 1) / sizeof(TraceRecord) * sizeof(TraceRecord), '\0');
+	out.write(reinterpret_cast<const char*>(&r), sizeof(r));
+	out.write(padded.data(), padded.size());
+	return id;
+}
+
+void TraceWriter::write(const TraceRecord* records, const std::size_t count)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	out.write(reinterpret_cast<const char*>(records), count * sizeof(TraceRecord));
+}
+
+bool readTrace(const std::string & path, std::vector<TraceRecord> & records, std::vector<std::string> & fileNames)
+{
+	records.clear();
+	fileNames.clear();
+
+	std::ifstream in(path.c_str(), std::ios::binary);
+	char magic[sizeof(TraceWriter::TRACE_MAGIC)];
+	std::uint32_t header[2];
+	if (!in.read(magic, sizeof(magic)) || !in.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+	    std::memcmp(magic, TraceWriter::TRACE_MAGIC, sizeof(magic)) != 0 ||
+	    header[0] != TraceWriter::TRACE_VERSION || header[1] != sizeof(TraceRecord))
+		return false;
+
+	// a record cut short by a crash ends the trace
+	TraceRecord r;
+	while (in.read(reinterpret_cast<char*>(&r), sizeof(r)))
+	{
+		if (r.op() != TRACE_FILE)
+		{
+			records.push_back(r);
+			continue;
+		}
+
+		std::string name((r.pageNo + sizeof(TraceRecord) - 1) / sizeof(TraceRecord) * sizeof(TraceRecord), '\0');
+		if (!in.read(&name[0], name.size()))
+			break;
+		name.resize(r.pageNo);
+		if (fileNames.size() <= r.fileId)
+			fileNames.resize(r.fileId + 1);
+		fileNames[r.fileId] = name;
+	}
+
+	// shards write their records in blocks, each block in time order
+	std::stable_sort(records.begin(), records.end(),
+	                 [](const TraceRecord & a, const TraceRecord & b) { return a.time() < b.time(); });
+	return true;
+}
+
+//----------------------------------------
+// MrcSampler
+//----------------------------------------
+
+MrcSampler::MrcSampler(const double rate)
+	: rate(rate <= 0 ? 1.0 / (1 << 24) : (rate > 1 ? 1 : rate)), nextTick(0), coldAccesses(0)
+{
+	threshold = (std::uint64_t) (this->rate * (1 << 24));
+	if (threshold == 0)
+		threshold = 1;
+}
+
+void MrcSampler::access(const File* file, const PageId pageNo)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	if (nextTick + 1 >= ticks.size())
+		compactTicks();
+
+	PageKey key = {file, pageNo};
+	std::unordered_map<PageKey, std::uint32_t, PageKeyHash>::iterator found = lastAccess.find(key);
+	if (found != lastAccess.end())
+	{
+		// every page last accessed after this one was accessed in between
+		const std::uint32_t distance = lastAccess.size() - countTicks(found->second);
+		if (distance >= distances.size())
+			distances.resize(distance + 1, 0);
+		distances[distance]++;
+		addTick(found->second, -1);
+		found->second = nextTick;
+	}
+	else
+	{
+		coldAccesses++;
+		lastAccess[key] = nextTick;
+	}
+	addTick(nextTick++, 1);
+}
+
+void MrcSampler::forget(const File* file, const PageId pageNo)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	PageKey key = {file, pageNo};
+	std::unordered_map<PageKey, std::uint32_t, PageKeyHash>::iterator found = lastAccess.find(key);
+	if (found != lastAccess.end())
+	{
+		addTick(found->second, -1);
+		lastAccess.erase(found);
+	}
+}
+
+void MrcSampler::clearCounts()
+{
+	std::lock_guard<std::mutex> guard(latch);
+	distances.clear();
+	coldAccesses = 0;
+}
+
+void MrcSampler::missRatios(const std::uint64_t accesses, const std::vector<std::uint32_t> & frames,
+                            std::vector<MissRatioPoint> & curve)
+{
+	std::lock_guard<std::mutex> guard(latch);
+
+	double sampled = coldAccesses;
+	for (std::size_t d = 0; d < distances.size(); d++)
+		sampled += distances[d];
+
+	// a sample of pages rarely gets exactly its share of the accesses; the difference is put down to the
+	// shortest reuse distance, which is where the pages accessed most, and so most often over or under
+	// sampled, fall (SHARDS-adj)
+	const double expected = accesses > 0 ? accesses * rate : sampled;
+	const double correction = expected - sampled;
+
+	for (std::size_t n = 0; n < frames.size(); n++)
+	{
+		// an access hits a pool at least one larger than its reuse distance, scaled up to all pages
+		const double limit = frames[n] * rate;
+		double hits = correction;
+		for (std::size_t d = 0; d < distances.size() && d < limit; d++)
+			hits += distances[d];
+
+		MissRatioPoint point = {frames[n], expected > 0 ? 1 - hits / expected : 0};
+		point.missRatio = std::min(1.0, std::max(0.0, point.missRatio));
+		curve.push_back(point);
+	}
+}
+
+void MrcSampler::addTick(std::uint32_t tick, const int delta)
+{
+	for (tick++; tick < ticks.size(); tick += tick & -tick)
+		ticks[tick] += delta;
+}
+
+std::uint32_t MrcSampler::countTicks(std::uint32_t tick) const
+{
+	std::uint32_t count = 0;
+	for (tick++; tick > 0; tick -= tick & -tick)
+		count += ticks[tick];
+	return count;
+}
+
+void MrcSampler::compactTicks()
+{
+	std::vector<std::pair<std::uint32_t, PageKey> > live;
+	live.reserve(lastAccess.size());
+	for (std::unordered_map<PageKey, std::uint32_t, PageKeyHash>::const_iterator it = lastAccess.begin();
+	     it != lastAccess.end(); ++it)
+		live.push_back(std::make_pair(it->second, it->first));
+	std::sort(live.begin(), live.end(),
+	          [](const std::pair<std::uint32_t, PageKey> & a, const std::pair<std::uint32_t, PageKey> & b)
+	          { return a.first < b.first; });
+
+	ticks.assign(std::max<std::size_t>(1024, 4 * live.size()) + 1, 0);
+	for (nextTick = 0; nextTick < live.size(); nextTick++)
+	{
+		lastAccess[live[nextTick].second] = nextTick;
+		addTick(nextTick, 1);
+	}
+}
+
+//----------------------------------------
+// PoolSimulator
+//----------------------------------------
+
+PoolSimulator::PoolSimulator(const ReplacementPolicyType type, const std::uint32_t frames)
+	: table(new BufDesc[frames]), policy(ReplacementPolicy::create(type, 0, 1, frames)), accesses(0), misses(0)
+{
+	for (FrameId i = 0; i < frames; i++)
+		table[i].frameNo = i;
+}
+
+PoolSimulator::~PoolSimulator()
+{
+	delete policy;
+	delete [] table;
+}
+
+void PoolSimulator::replay(const TraceRecord & record)
+{
+	// policies only ever compare files, so file ids stand in for them
+	File* file = reinterpret_cast<File*>((std::uintptr_t) record.fileId + 1);
+	PageKey key = {file, record.pageNo};
+	std::unordered_map<PageKey, std::uint32_t, PageKeyHash>::iterator found = resident.find(key);
+
+	if (record.op() == TRACE_DISPOSE)
+	{
+		if (found != resident.end())
+		{
+			table[found->second].Clear();
+			policy->frameFreed(found->second);
+			resident.erase(found);
+		}
+		return;
+	}
+
+	accesses++;
+	if (found != resident.end())
+	{
+		table[found->second].refbit = true;
+		policy->pageAccessed(found->second);
+		return;
+	}
+
+	// like BufStats::diskreads, pages allocated count as misses
+	misses++;
+
+	// nothing is ever pinned, so there always is a victim
+	std::uint32_t i;
+	policy->pickVictim(table, file, record.pageNo, i);
+	if (table[i].valid)
+	{
+		PageKey evicted = {table[i].file, table[i].pageNo};
+		resident.erase(evicted);
+	}
+	table[i].Set(file, record.pageNo);
+	table[i].pinCnt = 0;
+	policy->pageLoaded(i, file, record.pageNo);
+	resident[key] = i;
+}
+
+}
@@ -0,0 +1,379 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+#include "replacement.h"
+
+namespace badgerdb {
+
+class File;
+class BufDesc;
+
+/**
+ * @brief Kinds of records in an access trace.
+ */
+enum TraceOp
+{
+	TRACE_READ = 0,			/* Page pinned through readPage() and its variants */
+	TRACE_ALLOC = 1,		/* Page allocated through allocPage() */
+	TRACE_DISPOSE = 2,	/* Page deleted through disposePage() */
+	TRACE_FILE = 3			/* Names the file an id stands for; the name follows the record */
+};
+
+/**
+ * @brief One page access in a trace, as written to disk.
+ *
+ * A TRACE_FILE record gives the id of a file and, in pageNo, the length of its name, which follows the record
+ * padded with zeroes to a whole number of records.  It comes before any access to the file.
+ */
+struct TraceRecord
+{
+	/**
+	 * Nanoseconds since the trace was started, shifted left by two, with the TraceOp in the low two bits
+	 */
+	std::uint64_t stamp;
+
+	/**
+	 * Id of the file of the page, numbered from 0 in the order files are first seen
+	 */
+	std::uint32_t fileId;
+
+	/**
+	 * Page number within the file
+	 */
+	PageId pageNo;
+
+	/**
+	 * Returns the kind of record
+	 */
+	TraceOp op() const
+	{
+		return (TraceOp) (stamp & 3);
+	}
+
+	/**
+	 * Returns the nanoseconds since the trace was started
+	 */
+	std::uint64_t time() const
+	{
+		return stamp >> 2;
+	}
+};
+
+/**
+ * @brief Writes a trace of page accesses to a file.
+ *
+ * The file starts with TRACE_MAGIC and the format version, followed by TraceRecords.  Records are written in
+ * blocks by the buffer manager shards, each in time order, so the records of a trace as a whole are not; see
+ * readTrace().  Safe to use from several threads at once.
+ */
+class TraceWriter
+{
+ public:
+	/**
+	 * Identifies a trace file
+	 */
+	static const char TRACE_MAGIC[8];
+
+	/**
+	 * Version of the trace format written
+	 */
+	static const std::uint32_t TRACE_VERSION = 1;
+
+	/**
+	 * Creates a trace file, replacing any file of the same name.  See good() for whether that succeeded.
+	 *
+	 * @param path		Name of the trace file
+	 */
+	TraceWriter(const std::string & path);
+
+	/**
+	 * Flushes the trace file and closes it
+	 */
+	~TraceWriter();
+
+	/**
+	 * Returns the id standing for a file in the trace, writing a TRACE_FILE record the first time the file is
+	 * seen.  Files are told apart by name.
+	 */
+	std::uint32_t fileId(const File* file);
+
+	/**
+	 * Returns false if the trace file could not be created or a write to it failed
+	 */
+	bool good()
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		return out.good();
+	}
+
+	/**
+	 * Appends records to the trace file.
+	 */
+	void write(const TraceRecord* records, const std::size_t count);
+
+	/**
+	 * Returns a record of an access made now.
+	 */
+	TraceRecord record(const TraceOp op, const std::uint32_t fileId, const PageId pageNo) const
+	{
+		const std::uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
+		TraceRecord r = { (ns << 2) | op, fileId, pageNo };
+		return r;
+	}
+
+ private:
+	/**
+	 * Serializes writes to the trace file and updates of fileIds
+	 */
+	std::mutex latch;
+
+	/**
+	 * Trace file
+	 */
+	std::ofstream out;
+
+	/**
+	 * Ids given to the files seen so far, by name
+	 */
+	std::unordered_map<std::string, std::uint32_t> fileIds;
+
+	/**
+	 * Time the trace was started
+	 */
+	std::chrono::steady_clock::time_point start;
+
+	TraceWriter(const TraceWriter &);
+	TraceWriter & operator=(const TraceWriter &);
+};
+
+/**
+ * Reads a trace written by a TraceWriter, putting its accesses in time order.
+ *
+ * @param path				Name of the trace file
+ * @param records			Accesses of the trace, without the TRACE_FILE records, returned via this vector
+ * @param fileNames		Names of the files of the trace, by file id, returned via this vector
+ * @return  					False if the file cannot be read or is not a trace
+ */
+bool readTrace(const std::string & path, std::vector<TraceRecord> & records, std::vector<std::string> & fileNames);
+
+/**
+ * @brief A point of a miss ratio curve: the fraction of accesses that would miss with a pool of a given size.
+ */
+struct MissRatioPoint
+{
+	/**
+	 * Number of frames of the pool
+	 */
+	std::uint32_t frames;
+
+	/**
+	 * Fraction of accesses that miss, between 0 and 1
+	 */
+	double missRatio;
+};
+
+/**
+ * @brief Estimates the LRU miss ratio curve of a stream of page accesses from a sample of its pages (SHARDS).
+ *
+ * Pages are sampled by hashing them, so that every access to a sampled page is seen and the reuse distance of
+ * each, the number of other sampled pages accessed since the page was last accessed, can be counted.  Scaled
+ * up by the sampling rate, the reuse distances give how large an LRU pool would have had to be for each access
+ * to hit.  Sampling at a rate of 1 gives the exact curve.
+ *
+ * The estimate is only as good as the sample is large: at a rate of 0.01, the curve of a pool holding a few
+ * thousand pages rests on a few dozen sampled pages.
+ */
+class MrcSampler
+{
+ public:
+	/**
+	 * Constructor of MrcSampler class
+	 *
+	 * @param rate		Fraction of pages to sample, between 0 and 1
+	 */
+	MrcSampler(const double rate);
+
+	/**
+	 * Returns true if accesses to the page are sampled; the caller then passes them to access().
+	 * Cheap, and safe to call without any latch.
+	 */
+	bool samples(const File* file, const PageId pageNo) const
+	{
+		PageKey key = {file, pageNo};
+		std::uint64_t h = PageKeyHash()(key) * 0xBF58476D1CE4E5B9ULL;
+		return (h >> 40) < threshold;
+	}
+
+	/**
+	 * Records an access to a sampled page.
+	 */
+	void access(const File* file, const PageId pageNo);
+
+	/**
+	 * Forgets a sampled page that was deleted, so that a later page of the same number counts as new.
+	 */
+	void forget(const File* file, const PageId pageNo);
+
+	/**
+	 * Forgets the reuse distances counted so far, but not when sampled pages were last accessed.
+	 */
+	void clearCounts();
+
+	/**
+	 * Estimates the fraction of accesses that miss with pools of the given sizes.
+	 *
+	 * @param accesses		Number of accesses, sampled or not, made while the reuse distances were counted;
+	 *                    used to correct for sampling more or fewer accesses than the rate would have it
+	 * @param frames			Pool sizes to estimate the miss ratio of
+	 * @param curve				Miss ratios, in the order of frames, appended to this vector
+	 */
+	void missRatios(const std::uint64_t accesses, const std::vector<std::uint32_t> & frames,
+	                std::vector<MissRatioPoint> & curve);
+
+ private:
+	/**
+	 * Hash values, on 24 bits, below which a page is sampled
+	 */
+	std::uint64_t threshold;
+
+	/**
+	 * Fraction of pages sampled
+	 */
+	double rate;
+
+	/**
+	 * Serializes updates
+	 */
+	std::mutex latch;
+
+	/**
+	 * Tick of the last access to each sampled page
+	 */
+	std::unordered_map<PageKey, std::uint32_t, PageKeyHash> lastAccess;
+
+	/**
+	 * Fenwick tree over ticks, holding a 1 at the tick of the last access to each sampled page, so that the
+	 * pages accessed since a given tick can be counted in logarithmic time
+	 */
+	std::vector<std::uint32_t> ticks;
+
+	/**
+	 * Tick of the next access
+	 */
+	std::uint32_t nextTick;
+
+	/**
+	 * Number of accesses by reuse distance, in sampled pages
+	 */
+	std::vector<std::uint64_t> distances;
+
+	/**
+	 * Number of accesses to sampled pages not accessed before
+	 */
+	std::uint64_t coldAccesses;
+
+	/**
+	 * Adds delta at a tick of the Fenwick tree.
+	 */
+	void addTick(std::uint32_t tick, const int delta);
+
+	/**
+	 * Returns the number of last accesses at ticks up to and including the given one.
+	 */
+	std::uint32_t countTicks(std::uint32_t tick) const;
+
+	/**
+	 * Renumbers the last accesses from tick 0 once the Fenwick tree is full, growing it if half of it is live.
+	 */
+	void compactTicks();
+
+	MrcSampler(const MrcSampler &);
+	MrcSampler & operator=(const MrcSampler &);
+};
+
+/**
+ * @brief Replays page accesses against a replacement policy and a pool of a given size, counting misses.
+ *
+ * Pages are never pinned, and the pool is a single shard.  Allocating a page that is not in the pool counts as a
+ * miss, as it does in BufStats::diskreads.
+ */
+class PoolSimulator
+{
+ public:
+	/**
+	 * Constructor of PoolSimulator class
+	 *
+	 * @param type				Replacement policy to simulate
+	 * @param frames			Number of frames of the pool
+	 */
+	PoolSimulator(const ReplacementPolicyType type, const std::uint32_t frames);
+
+	/**
+	 * Destructor of PoolSimulator class
+	 */
+	~PoolSimulator();
+
+	/**
+	 * Replays one access of a trace.
+	 */
+	void replay(const TraceRecord & record);
+
+	/**
+	 * Returns the number of accesses replayed, not counting pages deleted
+	 */
+	std::uint64_t getAccesses() const
+	{
+		return accesses;
+	}
+
+	/**
+	 * Returns the number of accesses that missed
+	 */
+	std::uint64_t getMisses() const
+	{
+		return misses;
+	}
+
+ private:
+	/**
+	 * Descriptors of the simulated frames, of which only the page held and the reference bit matter
+	 */
+	BufDesc* table;
+
+	/**
+	 * Policy choosing the frames to evict
+	 */
+	ReplacementPolicy* policy;
+
+	/**
+	 * Frame holding each resident page
+	 */
+	std::unordered_map<PageKey, std::uint32_t, PageKeyHash> resident;
+
+	/**
+	 * Number of accesses and misses replayed
+	 */
+	std::uint64_t accesses;
+	std::uint64_t misses;
+
+	PoolSimulator(const PoolSimulator &);
+	PoolSimulator & operator=(const PoolSimulator &);
+};
+
+}